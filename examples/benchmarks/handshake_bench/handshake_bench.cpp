@@ -0,0 +1,110 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+// Web socket upgrade handshakes per second, from the received bytes to
+// the 101 response buffers, without any socket.
+// Compares the request_parser + request_handler path with upgrade_reply.
+//
+// usage: handshake_bench [iterations]
+
+#include <splice/web_socket/rfc6455_engine.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/lexical_cast.hpp>
+
+using namespace std;
+
+namespace
+{
+  // A Chrome like upgrade request, the key changes at each iteration
+  string mk_request(unsigned i)
+  {
+    string key=boost::lexical_cast<string>(1000000+i%1000000)+"dGhlIHNhbXA=";
+    return "GET /echo HTTP/1.1\r\n"
+      "Host: localhost:7777\r\n"
+      "Connection: Upgrade\r\n"
+      "Pragma: no-cache\r\n"
+      "Cache-Control: no-cache\r\n"
+      "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36\r\n"
+      "Upgrade: websocket\r\n"
+      "Origin: http://localhost:7777\r\n"
+      "Sec-WebSocket-Version: 13\r\n"
+      "Accept-Encoding: gzip, deflate, br\r\n"
+      "Accept-Language: en-US,en;q=0.9\r\n"
+      "Sec-WebSocket-Key: "+key+"\r\n"
+      "Sec-WebSocket-Extensions: permessage-deflate; client_max_window_bits\r\n"
+      "\r\n";
+  }
+
+  template<typename func_t>
+  void run(const char* name,unsigned iterations,func_t f)
+  {
+    using namespace boost::posix_time;
+
+    // requests are built before timing, only the handshake is measured
+    vector<string> requests;
+    for(unsigned i=0; i<1024; i++)
+      requests.push_back(mk_request(i));
+
+    size_t bytes=0;
+    const ptime start=microsec_clock::universal_time();
+    for(unsigned i=0; i<iterations; i++)
+      bytes+=f(requests[i%requests.size()]);
+    const double seconds=
+      (microsec_clock::universal_time()-start).total_microseconds()/1e6;
+
+    cout<<name<<": "<<static_cast<unsigned long>(iterations/seconds)
+      <<" handshakes/s ("<<bytes/iterations<<" bytes reply)"<<endl;
+  }
+
+  size_t legacy(const string& req,const splice::deflate_options& options)
+  {
+    splice::http_request_t hs_req;
+    boost::tribool result;
+    boost::tie(result,boost::tuples::ignore)=splice::request_parser().parse(
+      hs_req,req.data(),req.data()+req.size());
+    if(!result)
+      return 0;
+
+    splice::deflate_params params;
+    const splice::http_reply_t reply(
+      splice::request_handler::handle_request(hs_req,options,params));
+    return boost::asio::buffer_size(reply.to_buffers());
+  }
+
+  size_t fixed_buffer(const string& req,const splice::deflate_options& options)
+  {
+    splice::deflate_params params;
+    splice::upgrade_reply_t reply;
+    if(!reply.build(req.data(),req.data()+req.size(),options,params))
+      return 0;
+    return boost::asio::buffer_size(reply.to_buffer());
+  }
+}
+
+int main(int argc,char* argv[])
+{
+  const unsigned iterations=argc>1?atoi(argv[1]):1000000;
+
+  splice::deflate_options plain;
+  splice::deflate_options deflate;
+  deflate.enabled_=true;
+
+  run("request_parser, no deflate",iterations,
+    [&](const string& r) { return legacy(r,plain); });
+  run("upgrade_reply, no deflate ",iterations,
+    [&](const string& r) { return fixed_buffer(r,plain); });
+  run("request_parser, deflate   ",iterations,
+    [&](const string& r) { return legacy(r,deflate); });
+  run("upgrade_reply, deflate    ",iterations,
+    [&](const string& r) { return fixed_buffer(r,deflate); });
+
+  return 0;
+}
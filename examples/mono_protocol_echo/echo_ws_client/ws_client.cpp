@@ -0,0 +1,75 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+// Load generator for the echo_ws_server, every client sends a message
+// and sends it again as soon as it is echoed. Round trips per second
+// are printed every second, clients reconnect when the server restarts.
+//
+// usage: ws_client [host] [port] [clients]
+
+#include <iostream>
+
+#include <splice/web_socket/ws_client_session.hpp>
+
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+
+using namespace std;
+
+namespace
+{
+  boost::atomic<unsigned long> round_trips(0);
+}
+
+class my_client: public splice::ws_client_session<my_client>
+{
+public:
+  using base_t=splice::ws_client_session<my_client>;
+
+  my_client(boost::asio::io_service& io_service)
+    :base_t(io_service)
+  {
+  }
+
+  void on_open()
+  {
+    async_write("hello splice");
+  }
+
+  void on_read(const string& msg)
+  {
+    round_trips++;
+    async_write(msg);
+  }
+};
+
+int main(int argc,char* argv[])
+{
+  const string host=argc>1?argv[1]:"localhost";
+  const string port=argc>2?argv[2]:"7777";
+  const unsigned count=argc>3?atoi(argv[3]):100;
+
+  boost::asio::io_service io_service;
+  vector<boost::shared_ptr<my_client>> clients;
+  for(unsigned i=0; i<count; i++)
+  {
+    clients.push_back(boost::make_shared<my_client>(io_service));
+    clients.back()->async_connect(host,port,"/echo");
+  }
+
+  boost::thread_group threads;
+  for(unsigned i=0; i<boost::thread::hardware_concurrency(); i++)
+    threads.create_thread(boost::bind(&boost::asio::io_service::run,&io_service));
+
+  cout<<count<<" clients to "<<host<<":"<<port<<endl;
+  for(;;)
+  {
+    boost::this_thread::sleep_for(boost::chrono::seconds(1));
+    cout<<round_trips.exchange(0)<<" round trips/s"<<endl;
+  }
+
+  return 0;
+}
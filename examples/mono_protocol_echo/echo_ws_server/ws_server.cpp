@@ -65,16 +65,32 @@ class my_session: public splice::ws_session<my_session,my_logger>
 public:
   using base_t=splice::ws_session<my_session,my_logger>;
 
-  my_session(boost::asio::io_service& io_service)
+  my_session(boost::asio::io_service& io_service,splice::ws_heartbeat& hb)
     :base_t(io_service)
+    ,heartbeat_(hb)
   {
   }
 
+  // ping every client, see ws_heartbeat
+  splice::ws_heartbeat* heartbeat()
+  {
+    return &heartbeat_;
+  }
+
   void on_read(const string&  df)
   {
     cout<<"echo "<<df<<endl;
     async_write(df);
   }
+
+  void on_read_binary(std::vector<boost::uint8_t>& payload)
+  {
+    cout<<"echo "<<payload.size()<<" bytes"<<endl;
+    async_write_binary(payload.data(),payload.size());
+  }
+
+private:
+  splice::ws_heartbeat& heartbeat_;
 };
 
 
@@ -86,14 +102,18 @@ public:
 
   my_server(const string& address,const string& port)
     :base_t(address,port)
+    ,heartbeat_(get_io_service(),boost::chrono::seconds(10),3)
   {
     start_accept<my_session>();
   }
 
   session_ptr construct_session()
   {
-    return boost::make_shared<my_session>(get_io_service());
+    return boost::make_shared<my_session>(get_io_service(),heartbeat_);
   }
+
+private:
+  splice::ws_heartbeat heartbeat_;
 };
 
 int main(int argc,char* argv[])
@@ -21,12 +21,14 @@
 using boost::asio::ip::tcp;
 
 class my_session: public
-  splice::serialization_session<my_session,client_server_protocol>
+  splice::serialization_session<my_session,client_server_protocol
+  ,splice::no_log,splice::portable_binary_archive>
 {
   enum { max_length=1024 };
 
 public:
-  using base_t=splice::serialization_session<my_session,client_server_protocol>;
+  using base_t=splice::serialization_session<my_session,client_server_protocol
+    ,splice::no_log,splice::portable_binary_archive>;
   using msg_ptr=boost::shared_ptr<client_server_protocol>;
 
   my_session(splice::socket_t& socket)
@@ -7,11 +7,11 @@
 
 #include <boost/shared_ptr.hpp>
 #include <boost/make_shared.hpp>
-#include <boost/archive/text_iarchive.hpp>
-#include <boost/archive/text_oarchive.hpp>
+#include <splice/portable_binary_archive.hpp>
 
 #include "echo_message.hpp"
 
+// the archives are registered before the export of the messages
 #include <boost/serialization/export.hpp>
 BOOST_CLASS_EXPORT_GUID(client_echo_timed_t,"1")
 BOOST_CLASS_EXPORT_GUID(server_echo_timed_t,"2")
@@ -29,7 +29,7 @@ void serialization_test()
     {
       std::ostringstream archive_stream;
       {
-        boost::archive::text_oarchive archive(archive_stream);
+        splice::portable_binary_oarchive archive(archive_stream);
         archive<<msg_w;
       }
       persist=archive_stream.str();
@@ -40,7 +40,7 @@ void serialization_test()
     boost::shared_ptr<client_server_protocol> msg_r;
     {
       std::istringstream archive_stream(persist);
-      boost::archive::text_iarchive archive(archive_stream);
+      splice::portable_binary_iarchive archive(archive_stream);
       archive>>msg_r;
     }
 
@@ -10,18 +10,22 @@
 #endif
 
 #include <splice/server.hpp>
+#include <splice/event_history.hpp>
+#include <splice/pubsub_hub.hpp>
 #include <splice/web_socket/ws_session.hpp>
 #include <splice/serialization_session.hpp>
-#include <splice/http/http_session.hpp>
+#include <splice/http/sse_session.hpp>
+#include <splice/http/h2_session.hpp>
 
 #include <boost/numeric/conversion/cast.hpp>
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/property_tree/exceptions.hpp>
 
 #include "echo_message.hpp"
+#include "my_csv_export.hpp"
+#include "my_h2_session.hpp"
 #include "my_http_session.hpp"
 #include "my_serialization_session.hpp"
-#include "my_log_session.hpp"
 #include "my_ws_session.hpp"
 #include "my_tcp_session.hpp"
 
@@ -44,6 +48,11 @@ public:
     :base_t(address,port)
     ,request_handler_(doc_root)
   {
+    // a health check, a streamed export, files for any other path
+    router_.add("GET","/health",&my_server::on_health);
+    router_.add("GET","/export.csv",&my_server::on_export);
+    router_.add("GET","/*",http::server::router::files(request_handler_));
+
     // bind logger to my own member function
     my_logger::signal_=boost::bind(&my_server::on_logger,this,_1);
 
@@ -53,16 +62,35 @@ public:
 private:
   friend class base_t;
   friend class base_t::base_t;
-  using sp_log_session=boost::shared_ptr<my_log_session>;
 
   void on_logger(const std::string& msg)
   {
-    log_session_.broadcast(msg);
+    history_.publish(hub_,"log",msg+"<br>");
+  }
+
+  static void on_health(const http::server::request&
+    ,const http::server::route_params&
+    ,http::server::reply& rep)
+  {
+    rep.status=http::server::reply::ok;
+    rep.content="ok";
+    rep.headers.resize(1);
+    rep.headers[0].name="Content-Type";
+    rep.headers[0].value="text/plain";
   }
 
-  void on_connect(const sp_log_session& obj,bool connect)
+  static void on_export(const http::server::request&
+    ,const http::server::route_params&
+    ,http::server::reply& rep)
   {
-    log_session_.insert(obj,connect);
+    rep.status=http::server::reply::ok;
+    rep.headers.resize(1);
+    rep.headers[0].name="Content-Type";
+    rep.headers[0].value="text/csv";
+    rep.stream=[](const http::server::chunk_writer_ptr& writer)
+    {
+      boost::make_shared<my_csv_export>(writer)->next();
+    };
   }
 
   boost::shared_ptr<my_ws_session> construct_session()
@@ -97,14 +125,13 @@ private:
         handshake(handshake_fail_handler,incoming_data);
       break;
     case 2:
-    {
-      auto obj=boost::make_shared<my_log_session>(socket);
-      obj->on_connect_sig(boost::bind(&my_server::on_connect,this,_1,_2));
-      obj->handshake(handshake_fail_handler,incoming_data);
-    }
-    break;
+      boost::make_shared<my_http_session>(socket,router_,hub_,&history_)->
+        handshake(handshake_fail_handler,incoming_data);
+      break;
     case 3:
-      boost::make_shared<my_http_session>(socket,request_handler_)->
+      // tried before my_http_session, which would take the HTTP/2
+      // preface for a request
+      boost::make_shared<my_h2_session>(socket,router_)->
         handshake(handshake_fail_handler,incoming_data);
       break;
     default:
@@ -114,38 +141,11 @@ private:
 
 private:
   http::server::request_handler request_handler_;
-  struct
-  {
-    void clear()
-    {
-      boost::lock_guard<boost::mutex> lck(log_session_set_mtx_);
-      log_session_set_.clear();
-    }
-
-    void insert(const sp_log_session& obj,bool insert)
-    {
-      boost::lock_guard<boost::mutex> lck(log_session_set_mtx_);
-      if(insert)
-        log_session_set_.insert(obj);
-      else // remove
-      {
-        auto it=log_session_set_.find(obj);
-        if(it!=log_session_set_.end())
-          log_session_set_.erase(it);
-      }
-    }
-
-    void broadcast(const std::string& msg)
-    {
-      boost::lock_guard<boost::mutex> lck(log_session_set_mtx_);
-      for(auto it:log_session_set_)
-        it->get_io_service().post(boost::bind(&my_log_session::send,it,msg));
-    }
-
-  private:
-    std::set<boost::shared_ptr<my_log_session>> log_session_set_;
-    boost::mutex log_session_set_mtx_;
-  }log_session_;
+  http::server::router router_;
+  // log messages are published on the "log" topic, the last ones
+  // being kept for event streams to resume
+  splice::pubsub_hub hub_;
+  splice::event_history history_;
 };
 
 int main(int argc,char* argv[])
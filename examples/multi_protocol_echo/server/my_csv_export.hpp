@@ -0,0 +1,47 @@
+#include <splice/http/chunk_writer.hpp>
+
+#include <string>
+
+#include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/lexical_cast.hpp>
+
+// streams rows of numbers as CSV, a batch of rows being generated once
+// the previous one is written
+class my_csv_export:public boost::enable_shared_from_this<my_csv_export>
+{
+public:
+  explicit my_csv_export(const http::server::chunk_writer_ptr& writer)
+    :writer_(writer)
+    ,row_(0)
+  {
+  }
+
+  void next(const boost::system::error_code& ec=boost::system::error_code())
+  {
+    if(ec||row_==row_count)
+    {
+      writer_->close();
+      return;
+    }
+
+    batch_.clear();
+    for(const unsigned end=row_+batch_size; row_<end; ++row_)
+    {
+      batch_+=boost::lexical_cast<std::string>(row_);
+      batch_+=',';
+      batch_+=boost::lexical_cast<std::string>(row_*row_);
+      batch_+='\n';
+    }
+    writer_->async_write(boost::asio::buffer(batch_)
+      ,boost::bind(&my_csv_export::next,shared_from_this(),_1));
+  }
+
+private:
+  static const unsigned row_count=100000;
+  static const unsigned batch_size=1000;
+
+  http::server::chunk_writer_ptr writer_;
+  unsigned row_;
+  std::string batch_;
+};
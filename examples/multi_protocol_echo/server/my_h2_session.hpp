@@ -0,0 +1,20 @@
+#include <splice/http/h2_session.hpp>
+
+#include "my_logger.hpp"
+
+// serves the same routes as my_http_session, over cleartext HTTP/2
+class my_h2_session:public splice::h2_session<my_h2_session,my_logger>
+{
+public:
+  using base_t=splice::h2_session<my_h2_session,my_logger>;
+
+  my_h2_session(splice::socket_t& socket
+    ,http::server::router& router)
+    :base_t(socket,router)
+  {
+  }
+
+protected:
+  friend class my_server;
+  friend base_t;
+};
@@ -1,4 +1,4 @@
-#include <splice/http/http_session.hpp>
+#include <splice/http/sse_session.hpp>
 
 #include <utility>
 #include <set>
@@ -8,11 +8,11 @@
 
 #include "my_logger.hpp"
 
-// serves index.html
-class my_http_session:public splice::http_session<my_http_session,my_logger>
+// serves index.html, and the server log as an event stream
+class my_http_session:public splice::sse_session<my_http_session,my_logger>
 {
 public:
-  using base_t=splice::http_session<my_http_session,my_logger>;
+  using base_t=splice::sse_session<my_http_session,my_logger>;
 
   // Copy required files from src folder to dest.
   // Setup host name and port number for html files
@@ -91,13 +91,26 @@ public:
   }
 
   my_http_session(splice::socket_t& socket
-    ,http::server::request_handler& request_handler)
-    :base_t(socket,request_handler)
+    ,http::server::router& router
+    ,splice::pubsub_hub& hub
+    ,splice::event_history* history)
+    :base_t(socket,router,hub,history)
   {
   }
 
 protected:
   friend class my_server;
   friend base_t;
+  friend base_t::base_t;
+
+  // GET /log streams the "log" topic
+  bool event_stream_topic(const http::server::request& req
+    ,std::string& topic)
+  {
+    if(req.uri!="/log")
+      return false;
+    topic="log";
+    return true;
+  }
 };
 
@@ -1,13 +1,16 @@
 #include <splice/serialization_session.hpp>
 
 
-// communicates with mpt_serialize_client console application
+// communicates with mpt_serialize_client console application,
+// both using the portable binary archive
 class my_serialization_session:public splice::serialization_session
-  <my_serialization_session,client_server_protocol,my_logger>
+  <my_serialization_session,client_server_protocol,my_logger
+  ,splice::portable_binary_archive>
 {
 public:
   using base_t=splice::serialization_session
-    <my_serialization_session,client_server_protocol,my_logger>;
+    <my_serialization_session,client_server_protocol,my_logger
+    ,splice::portable_binary_archive>;
 
   my_serialization_session(splice::socket_t& socket)
     :base_t(socket)
@@ -41,5 +41,19 @@
 # endif // !defined(SPLICE_SEPARATE_COMPILATION)
 #endif // !defined(SPLICE_HEADER_ONLY)
 
+// Features requiring zlib, as web socket permessage-deflate, are only
+// available when SPLICE_HAS_ZLIB is defined in the project/compiler settings.
+
+// Static files are also compressed with brotli, and not only gzip,
+// when SPLICE_HAS_BROTLI is defined, link with brotlienc.
+
+// SSE2 code paths, as web socket UTF-8 validation or request parsing, are
+// used when the compiler targets SSE2, define SPLICE_NO_SSE2 to use portable
+// code only.
+#if !defined(SPLICE_NO_SSE2) && (defined(__SSE2__) || defined(_M_X64) \
+  || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2))
+# define SPLICE_HAS_SSE2
+#endif
+
 #endif // #ifndef SPLICE_CONFIG_HPP
 
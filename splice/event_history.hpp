@@ -0,0 +1,111 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef EVENT_HISTORY_HPP
+#define EVENT_HISTORY_HPP
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "detail/config.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+#include "http/event_stream.hpp"
+#include "pubsub_hub.hpp"
+
+namespace splice
+{
+
+  // Encoder of a publication as an event of a text/event-stream body,
+  // formatted once for the history and every sse_session subscriber.
+  struct sse_event
+  {
+    typedef http::server::event_ptr type;
+
+    static type encode(const publication& pub)
+    {
+      boost::shared_ptr<std::string> event(boost::make_shared<std::string>());
+      http::server::append_event(pub.id(),pub.message(),*event);
+      return event;
+    }
+  };
+
+  // The last events published through it, numbered from 1, kept in a ring
+  // buffer so that an event stream reconnecting with a Last-Event-ID gets
+  // the ones it missed, as long as they are still kept.
+  // Publishing goes through a lock, so that every subscriber receives the
+  // events in the order of their ids.
+  class event_history
+    : private boost::noncopyable
+  {
+  public:
+    explicit event_history(std::size_t capacity=1024)
+      :ring_(capacity?capacity:1)
+      ,last_id_(0)
+    {
+    }
+
+    // Number message, keep it, then publish it on the hub, returns its id
+    boost::uint64_t publish(pubsub_hub& hub,const std::string& topic,
+      const std::string& message)
+    {
+      boost::lock_guard<boost::mutex> lock(mutex_);
+      publication pub(topic,message,++last_id_);
+      entry& e=ring_[(last_id_-1)%ring_.size()];
+      e.topic_=topic;
+      e.event_=pub.encoded<sse_event>();
+      hub.publish(pub);
+      return last_id_;
+    }
+
+    // Append the events kept of the ones published after last_id on topic,
+    // a topic ending with '*' matching as for pubsub_hub. Returns the id
+    // of the last event published so far.
+    boost::uint64_t replay(boost::uint64_t last_id,const std::string& topic,
+      std::vector<http::server::event_ptr>& events) const
+    {
+      const bool prefix=!topic.empty()&&topic[topic.size()-1]=='*';
+      const std::size_t size=prefix?topic.size()-1:topic.size();
+
+      boost::lock_guard<boost::mutex> lock(mutex_);
+      const boost::uint64_t oldest=last_id_<ring_.size()?1
+        :last_id_-ring_.size()+1;
+      for(boost::uint64_t id=(std::max)(last_id+1,oldest); id<=last_id_; id++)
+      {
+        const entry& e=ring_[(id-1)%ring_.size()];
+        if(prefix?e.topic_.compare(0,size,topic,0,size)==0:e.topic_==topic)
+          events.push_back(e.event_);
+      }
+      return last_id_;
+    }
+
+  private:
+    struct entry
+    {
+      std::string topic_;
+      http::server::event_ptr event_;
+    };
+
+    mutable boost::mutex mutex_;
+    std::vector<entry> ring_;
+    boost::uint64_t last_id_;
+  };
+
+} // namespace splice {
+
+#endif // #ifndef EVENT_HISTORY_HPP
@@ -0,0 +1,541 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef HTTP_BASIC_REQUEST_PARSER_HPP
+#define HTTP_BASIC_REQUEST_PARSER_HPP
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/logic/tribool.hpp>
+#include <boost/tuple/tuple.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#if defined(SPLICE_HAS_SSE2)
+# include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+# include <intrin.h>
+#endif
+
+namespace http {
+namespace server {
+
+/// Parser for incoming requests, of http::server::request as of the web
+/// socket handshake request, both having method, uri, version and headers
+/// of name and value, or of a request_view referring to the input.
+/// Input may be split anywhere, parsing resumes on the next call, with a
+/// request_view the input must remain in place, in one buffer. Runs of
+/// method, uri, header name and value characters are appended at once:
+/// tokens are checked with a lookup table, uri and values are scanned 16
+/// bytes at a time with SSE2 for the space or control character ending
+/// them.
+template <typename Request>
+class basic_request_parser
+{
+public:
+  /// Construct ready to parse the request method.
+  basic_request_parser()
+    : state_(method_start)
+  {
+  }
+
+  /// Reset to initial parser state.
+  void reset()
+  {
+    state_ = method_start;
+  }
+
+  /// Parse some data. The tribool return value is true when a complete request
+  /// has been parsed, false if the data is invalid, indeterminate when more
+  /// data is required. The pointer return value indicates how much of the
+  /// input has been consumed.
+  boost::tuple<boost::tribool, const char*> parse(Request& req,
+      const char* begin, const char* end)
+  {
+    while (begin != end)
+    {
+      const char* run = begin;
+      bool extended = true;
+      switch (state_)
+      {
+      case method:
+        run = scan_token(begin, end);
+        extended = extend(req.method, begin, run);
+        break;
+      case uri:
+        run = scan_text(begin, end, uri_char);
+        extended = extend(req.uri, begin, run);
+        break;
+      case http_version_h:
+        // nearly always, checked at once
+        if (end - begin >= 10 && std::memcmp(begin, "HTTP/1.1\r\n", 10) == 0)
+        {
+          req.http_version_major = 1;
+          req.http_version_minor = 1;
+          state_ = header_line_start;
+          begin += 10;
+          continue;
+        }
+        break;
+      case header_name:
+        run = scan_token(begin, end);
+        if (!extend(req.headers.back().name, begin, run))
+          return boost::make_tuple(boost::tribool(false), run);
+        // ": " at once
+        if (end - run >= 2 && run[0] == ':' && run[1] == ' ')
+        {
+          state_ = space_before_header_value;
+          begin = run + 2;
+          continue;
+        }
+        break;
+      case header_value:
+        run = scan_text(begin, end, text_char);
+        if (!extend(req.headers.back().value, begin, run))
+          return boost::make_tuple(boost::tribool(false), run);
+        // CRLF at once
+        if (end - run >= 2 && run[0] == '\r' && run[1] == '\n')
+        {
+          trim(req.headers.back().value);
+          state_ = header_line_start;
+          begin = run + 2;
+          continue;
+        }
+        break;
+      default:
+        break;
+      }
+      if (!extended)
+        return boost::make_tuple(boost::tribool(false), begin);
+      begin = run;
+      if (begin == end)
+        break;
+
+      boost::tribool result = consume(req, begin++);
+      if (result || !result)
+        return boost::make_tuple(result, begin);
+    }
+    boost::tribool result = boost::indeterminate;
+    return boost::make_tuple(result, begin);
+  }
+
+  boost::tuple<boost::tribool, const char*> parse(Request& req,
+      char* begin, char* end)
+  {
+    return parse(req, const_cast<const char*>(begin),
+        const_cast<const char*>(end));
+  }
+
+private:
+  /// The states of the parser.
+  enum state
+  {
+    method_start,
+    method,
+    uri,
+    http_version_h,
+    http_version_t_1,
+    http_version_t_2,
+    http_version_p,
+    http_version_slash,
+    http_version_major_start,
+    http_version_major,
+    http_version_minor_start,
+    http_version_minor,
+    expecting_newline_1,
+    header_line_start,
+    header_lws,
+    header_name,
+    space_before_header_value,
+    header_value,
+    expecting_newline_2,
+    expecting_newline_3
+  };
+
+  /// Character classes, of char_classes.
+  enum
+  {
+    token_char = 1, // neither a control nor a separator
+    text_char = 2, // not a control, header values
+    uri_char = 4 // neither a control nor a space
+  };
+
+  /// Classes of the characters, by unsigned value.
+  static const boost::uint8_t* char_classes()
+  {
+    static const boost::uint8_t classes[256] =
+    {
+      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+      2, 7, 6, 7, 7, 7, 7, 7, 6, 6, 7, 7, 6, 7, 7, 6,
+      7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 6, 6, 6, 6, 6, 6,
+      6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+      7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 6, 6, 6, 7, 7,
+      7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+      7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 6, 7, 6, 7, 0,
+      6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+      6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+      6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+      6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+      6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+      6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+      6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+      6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6
+    };
+    return classes;
+  }
+
+  static bool is(char c, int char_class)
+  {
+    return (char_classes()[static_cast<unsigned char>(c)] & char_class) != 0;
+  }
+
+  /// Append [begin, end) to a field, in place for a view, which fails
+  /// when the field isn't contiguous, i.e. a folded header value.
+  static bool extend(std::string& s, const char* begin, const char* end)
+  {
+    s.append(begin, end);
+    return true;
+  }
+
+  static bool extend(boost::string_ref& s, const char* begin, const char* end)
+  {
+    if (s.empty())
+      s = boost::string_ref(begin, end - begin);
+    else if (s.data() + s.size() == begin)
+      s = boost::string_ref(s.data(), s.size() + (end - begin));
+    else
+      return false;
+    return true;
+  }
+
+  /// Remove the trailing white space of a header value.
+  static void trim(std::string& s)
+  {
+    while (!s.empty() && s[s.size() - 1] == ' ')
+      s.erase(s.size() - 1);
+  }
+
+  static void trim(boost::string_ref& s)
+  {
+    while (!s.empty() && s[s.size() - 1] == ' ')
+      s.remove_suffix(1);
+  }
+
+  template <typename Field>
+  static boost::tribool push_back(Field& field, const char* p)
+  {
+    if (!extend(field, p, p + 1))
+      return false;
+    return boost::indeterminate;
+  }
+
+  /// Start a new header, the headers of a view have a fixed capacity.
+  template <typename Header>
+  static bool add_header(std::vector<Header>& headers)
+  {
+    headers.resize(headers.size() + 1);
+    return true;
+  }
+
+  template <typename Headers>
+  static bool add_header(Headers& headers)
+  {
+    return headers.extend();
+  }
+
+  /// The end of the token starting at begin.
+  static const char* scan_token(const char* p, const char* end)
+  {
+    while (end - p >= 4 && is(p[0], token_char) && is(p[1], token_char)
+        && is(p[2], token_char) && is(p[3], token_char))
+      p += 4;
+    while (p != end && is(*p, token_char))
+      ++p;
+    return p;
+  }
+
+  /// The end of the uri_char or text_char run starting at begin.
+  static const char* scan_text(const char* p, const char* end, int char_class)
+  {
+#if defined(SPLICE_HAS_SSE2)
+    // a byte below the space, or DEL, or the space itself in a uri
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i del = _mm_set1_epi8(0x7f);
+    while (end - p >= 16)
+    {
+      const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      const __m128i above_space = _mm_cmpeq_epi8(_mm_max_epu8(x, space), x);
+      unsigned stops = ~_mm_movemask_epi8(above_space) & 0xffff;
+      stops |= _mm_movemask_epi8(_mm_cmpeq_epi8(x, del));
+      if (char_class == uri_char)
+        stops |= _mm_movemask_epi8(_mm_cmpeq_epi8(x, space));
+      if (stops)
+        return p + first_set(stops);
+      p += 16;
+    }
+#endif
+    while (p != end && is(*p, char_class))
+      ++p;
+    return p;
+  }
+
+#if defined(SPLICE_HAS_SSE2)
+  /// Index of the lowest bit set of a non zero mask.
+  static unsigned first_set(unsigned mask)
+  {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+  }
+#endif
+
+  /// Handle the next character of input.
+  boost::tribool consume(Request& req, const char* p)
+  {
+    const char input = *p;
+    switch (state_)
+    {
+    case method_start:
+      if (!is(input, token_char))
+      {
+        return false;
+      }
+      else
+      {
+        state_ = method;
+        return push_back(req.method, p);
+      }
+    case method:
+      if (input == ' ')
+      {
+        state_ = uri;
+        return boost::indeterminate;
+      }
+      else if (!is(input, token_char))
+      {
+        return false;
+      }
+      else
+      {
+        return push_back(req.method, p);
+      }
+    case uri:
+      if (input == ' ')
+      {
+        state_ = http_version_h;
+        return boost::indeterminate;
+      }
+      else if (!is(input, text_char))
+      {
+        return false;
+      }
+      else
+      {
+        return push_back(req.uri, p);
+      }
+    case http_version_h:
+      return expect(input, 'H', http_version_t_1);
+    case http_version_t_1:
+      return expect(input, 'T', http_version_t_2);
+    case http_version_t_2:
+      return expect(input, 'T', http_version_p);
+    case http_version_p:
+      return expect(input, 'P', http_version_slash);
+    case http_version_slash:
+      req.http_version_major = 0;
+      req.http_version_minor = 0;
+      return expect(input, '/', http_version_major_start);
+    case http_version_major_start:
+      if (is_digit(input))
+      {
+        req.http_version_major = req.http_version_major * 10 + input - '0';
+        state_ = http_version_major;
+        return boost::indeterminate;
+      }
+      else
+      {
+        return false;
+      }
+    case http_version_major:
+      if (input == '.')
+      {
+        state_ = http_version_minor_start;
+        return boost::indeterminate;
+      }
+      else if (is_digit(input))
+      {
+        req.http_version_major = req.http_version_major * 10 + input - '0';
+        return boost::indeterminate;
+      }
+      else
+      {
+        return false;
+      }
+    case http_version_minor_start:
+      if (is_digit(input))
+      {
+        req.http_version_minor = req.http_version_minor * 10 + input - '0';
+        state_ = http_version_minor;
+        return boost::indeterminate;
+      }
+      else
+      {
+        return false;
+      }
+    case http_version_minor:
+      if (input == '\r')
+      {
+        state_ = expecting_newline_1;
+        return boost::indeterminate;
+      }
+      else if (is_digit(input))
+      {
+        req.http_version_minor = req.http_version_minor * 10 + input - '0';
+        return boost::indeterminate;
+      }
+      else
+      {
+        return false;
+      }
+    case expecting_newline_1:
+      return expect(input, '\n', header_line_start);
+    case header_line_start:
+      if (input == '\r')
+      {
+        state_ = expecting_newline_3;
+        return boost::indeterminate;
+      }
+      else if (!req.headers.empty() && (input == ' ' || input == '\t'))
+      {
+        state_ = header_lws;
+        return boost::indeterminate;
+      }
+      else if (!is(input, token_char))
+      {
+        return false;
+      }
+      else
+      {
+        if (!add_header(req.headers))
+          return false;
+        state_ = header_name;
+        return push_back(req.headers.back().name, p);
+      }
+    case header_lws:
+      if (input == '\r')
+      {
+        state_ = expecting_newline_2;
+        return boost::indeterminate;
+      }
+      else if (input == ' ' || input == '\t')
+      {
+        return boost::indeterminate;
+      }
+      else if (!is(input, text_char))
+      {
+        return false;
+      }
+      else
+      {
+        state_ = header_value;
+        return push_back(req.headers.back().value, p);
+      }
+    case header_name:
+      if (input == ':')
+      {
+        state_ = space_before_header_value;
+        return boost::indeterminate;
+      }
+      else if (!is(input, token_char))
+      {
+        return false;
+      }
+      else
+      {
+        return push_back(req.headers.back().name, p);
+      }
+    case space_before_header_value:
+      // optional white space, "Host:example.com" is valid
+      if (input == ' ' || input == '\t')
+      {
+        return boost::indeterminate;
+      }
+      else if (input == '\r')
+      {
+        state_ = expecting_newline_2;
+        return boost::indeterminate;
+      }
+      else if (!is(input, text_char))
+      {
+        return false;
+      }
+      else
+      {
+        state_ = header_value;
+        return push_back(req.headers.back().value, p);
+      }
+    case header_value:
+      if (input == '\r')
+      {
+        trim(req.headers.back().value);
+        state_ = expecting_newline_2;
+        return boost::indeterminate;
+      }
+      else if (!is(input, text_char))
+      {
+        return false;
+      }
+      else
+      {
+        return push_back(req.headers.back().value, p);
+      }
+    case expecting_newline_2:
+      return expect(input, '\n', header_line_start);
+    case expecting_newline_3:
+      return (input == '\n');
+    default:
+      return false;
+    }
+  }
+
+  /// Go to next state on the expected character.
+  boost::tribool expect(char input, char expected, state next)
+  {
+    if (input != expected)
+      return false;
+    state_ = next;
+    return boost::indeterminate;
+  }
+
+  /// Check if a byte is a digit.
+  static bool is_digit(int c)
+  {
+    return c >= '0' && c <= '9';
+  }
+
+  /// The current state of the parser.
+  state state_;
+};
+
+} // namespace server
+} // namespace http
+
+#endif // HTTP_BASIC_REQUEST_PARSER_HPP
@@ -0,0 +1,139 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef HTTP_BODY_PARSER_HPP
+#define HTTP_BODY_PARSER_HPP
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <boost/cstdint.hpp>
+#include <boost/logic/tribool.hpp>
+#include <boost/tuple/tuple.hpp>
+
+namespace http {
+namespace server {
+
+struct request;
+
+/// Parser for the body of a request, framed by its Content-Length or as
+/// Transfer-Encoding: chunked. The content is handed out in place, as
+/// runs of the input, nothing is copied; input may be split anywhere,
+/// parsing resumes on the next call.
+class body_parser
+{
+public:
+  /// Construct with no body started.
+  body_parser();
+
+  /// Reset to no body started.
+  void reset();
+
+  /// Start the body of a request whose headers are parsed, of at most
+  /// max_size bytes of content. Returns false when the framing is invalid,
+  /// or when the Content-Length is beyond max_size, see too_large.
+  bool start(const request& req, boost::uint64_t max_size);
+
+  /// Whether a body is started and not complete yet.
+  bool started() const
+  {
+    return state_ != idle && state_ != done;
+  }
+
+  /// Whether the body is complete, or the request has none.
+  bool complete() const
+  {
+    return state_ == done;
+  }
+
+  /// Whether parsing failed on a body larger than max_size.
+  bool too_large() const
+  {
+    return too_large_;
+  }
+
+  /// Parse some data, handler(data, size) being called with each run of
+  /// content. The tribool return value is true when the body is complete,
+  /// false if the data is invalid, indeterminate when more data is
+  /// required, all of the input being consumed. The pointer return value
+  /// indicates how much of the input has been consumed.
+  template <typename Handler>
+  boost::tuple<boost::tribool, const char*> parse(const char* begin,
+      const char* end, Handler handler)
+  {
+    while (state_ != done && begin != end)
+    {
+      if (state_ == content)
+      {
+        // as much content as received, at once
+        const std::size_t size = static_cast<std::size_t>((std::min)(
+            remaining_, static_cast<boost::uint64_t>(end - begin)));
+        handler(begin, size);
+        begin += size;
+        remaining_ -= size;
+        if (!remaining_)
+          state_ = chunked_ ? chunk_data_cr : done;
+        continue;
+      }
+
+      boost::tribool result = consume(*begin++);
+      if (!result)
+        return boost::make_tuple(result, begin);
+    }
+    boost::tribool result = boost::indeterminate;
+    if (state_ == done)
+      result = true;
+    return boost::make_tuple(result, begin);
+  }
+
+private:
+  /// Handle the next character of the chunked framing. False when it is
+  /// invalid.
+  boost::tribool consume(char c);
+
+  /// The current state of the parser.
+  enum state
+  {
+    idle,
+    content,
+    chunk_size_start,
+    chunk_size,
+    chunk_extension,
+    chunk_size_lf,
+    chunk_data_cr,
+    chunk_data_lf,
+    trailer_start,
+    trailer_line,
+    trailer_lf,
+    final_lf,
+    done
+  } state_;
+
+  bool chunked_;
+  bool too_large_;
+
+  /// Content bytes left in the body or the chunk, content bytes so far
+  /// and at most.
+  boost::uint64_t remaining_;
+  boost::uint64_t size_;
+  boost::uint64_t max_size_;
+};
+
+} // namespace server
+} // namespace http
+
+#if defined(SPLICE_HEADER_ONLY)
+# include "body_parser.hxx"
+#endif
+
+#endif // HTTP_BODY_PARSER_HPP
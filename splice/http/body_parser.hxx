@@ -0,0 +1,198 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include "body_parser.hpp"
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include "request.hpp"
+
+namespace http {
+namespace server {
+
+body_parser::body_parser()
+  : state_(idle)
+  , chunked_(false)
+  , too_large_(false)
+  , remaining_(0)
+  , size_(0)
+  , max_size_(0)
+{
+}
+
+void body_parser::reset()
+{
+  state_ = idle;
+  chunked_ = false;
+  too_large_ = false;
+  remaining_ = 0;
+  size_ = 0;
+  max_size_ = 0;
+}
+
+bool body_parser::start(const request& req, boost::uint64_t max_size)
+{
+  reset();
+  max_size_ = max_size;
+
+  // a Content-Length along with a Transfer-Encoding, or two different
+  // ones, leave the end of the body ambiguous
+  bool has_length = false;
+  boost::uint64_t length = 0;
+  bool has_coding = false;
+  for (std::size_t i = 0; i < req.headers.size(); ++i)
+  {
+    const std::string& name = req.headers[i].name;
+    if (boost::algorithm::iequals(name, "Transfer-Encoding"))
+    {
+      // chunked is the only coding understood
+      if (has_coding || !boost::algorithm::iequals(
+          boost::algorithm::trim_copy(req.headers[i].value), "chunked"))
+        return false;
+      has_coding = true;
+    }
+    else if (boost::algorithm::iequals(name, "Content-Length"))
+    {
+      const std::string& value = req.headers[i].value;
+      boost::uint64_t n = 0;
+      if (value.empty() || value.size() > 19)
+        return false;
+      for (std::size_t j = 0; j < value.size(); ++j)
+      {
+        if (value[j] < '0' || value[j] > '9')
+          return false;
+        n = n * 10 + (value[j] - '0');
+      }
+      if (has_length && n != length)
+        return false;
+      has_length = true;
+      length = n;
+    }
+  }
+  if (has_coding && has_length)
+    return false;
+
+  if (has_coding)
+  {
+    chunked_ = true;
+    state_ = chunk_size_start;
+  }
+  else if (length > max_size_)
+  {
+    too_large_ = true;
+    return false;
+  }
+  else if (length)
+  {
+    remaining_ = length;
+    size_ = length;
+    state_ = content;
+  }
+  else
+    state_ = done;
+  return true;
+}
+
+boost::tribool body_parser::consume(char c)
+{
+  switch (state_)
+  {
+  case chunk_size_start:
+  case chunk_size:
+  {
+    int digit = -1;
+    if (c >= '0' && c <= '9')
+      digit = c - '0';
+    else if (c >= 'a' && c <= 'f')
+      digit = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      digit = c - 'A' + 10;
+
+    if (digit >= 0)
+    {
+      if (remaining_ >> 60)
+        return false;
+      remaining_ = remaining_ * 16 + digit;
+      state_ = chunk_size;
+      return boost::indeterminate;
+    }
+    if (state_ == chunk_size_start)
+      return false;
+    if (c == '\r')
+    {
+      state_ = chunk_size_lf;
+      return boost::indeterminate;
+    }
+    if (c == ';' || c == ' ' || c == '\t')
+    {
+      state_ = chunk_extension;
+      return boost::indeterminate;
+    }
+    return false;
+  }
+  case chunk_extension:
+    // extensions are ignored
+    if (c == '\r')
+      state_ = chunk_size_lf;
+    return boost::indeterminate;
+  case chunk_size_lf:
+    if (c != '\n')
+      return false;
+    if (!remaining_)
+    { // the last chunk
+      state_ = trailer_start;
+      return boost::indeterminate;
+    }
+    if (remaining_ > max_size_ - size_)
+    {
+      too_large_ = true;
+      return false;
+    }
+    size_ += remaining_;
+    state_ = content;
+    return boost::indeterminate;
+  case chunk_data_cr:
+    if (c != '\r')
+      return false;
+    state_ = chunk_data_lf;
+    return boost::indeterminate;
+  case chunk_data_lf:
+    if (c != '\n')
+      return false;
+    state_ = chunk_size_start;
+    return boost::indeterminate;
+  case trailer_start:
+    // trailer fields are ignored
+    state_ = c == '\r' ? final_lf : trailer_line;
+    return boost::indeterminate;
+  case trailer_line:
+    if (c == '\r')
+      state_ = trailer_lf;
+    return boost::indeterminate;
+  case trailer_lf:
+    if (c != '\n')
+      return false;
+    state_ = trailer_start;
+    return boost::indeterminate;
+  case final_lf:
+    if (c != '\n')
+      return false;
+    state_ = done;
+    return true;
+  default:
+    return false;
+  }
+}
+
+} // namespace server
+} // namespace http
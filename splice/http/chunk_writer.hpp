@@ -0,0 +1,59 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef HTTP_CHUNK_WRITER_HPP
+#define HTTP_CHUNK_WRITER_HPP
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include <boost/asio/buffer.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/system/error_code.hpp>
+
+namespace http {
+namespace server {
+
+/// Writes the body of a streamed reply, see reply::stream, as chunks of
+/// Transfer-Encoding: chunked, or as is to an HTTP/1.0 client, the
+/// connection being closed at the end of the body.
+/// One chunk is written at a time: the next one is given once the handler
+/// of the previous one is called, so that a producer never runs ahead of
+/// the client. A writer may be used from any thread, not concurrently.
+class chunk_writer
+  : private boost::noncopyable
+{
+public:
+  typedef boost::function<void (const boost::system::error_code&)>
+    handler_type;
+
+  virtual ~chunk_writer()
+  {
+  }
+
+  /// Write a chunk, data being kept valid until handler is called. An
+  /// error means the connection is lost, the body is to be given up.
+  virtual void async_write(const boost::asio::const_buffer& data,
+      const handler_type& handler) = 0;
+
+  /// End the body once the chunk being written, if any, is written. The
+  /// body also ends when the last copy of the writer is released.
+  virtual void close() = 0;
+};
+
+typedef boost::shared_ptr<chunk_writer> chunk_writer_ptr;
+
+} // namespace server
+} // namespace http
+
+#endif // HTTP_CHUNK_WRITER_HPP
@@ -0,0 +1,55 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef HTTP_DATE_CACHE_HPP
+#define HTTP_DATE_CACHE_HPP
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include <ctime>
+#include <string>
+#include <boost/atomic.hpp>
+
+namespace http {
+namespace server {
+
+/// The Date header line of every reply, formatted once a second and
+/// shared by every thread. Readers copy the line without any lock, the
+/// thread noticing a new second formats it again while the others, if
+/// any, format their own copy meanwhile.
+class date_cache
+{
+public:
+  /// Bytes of the line, "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n".
+  static const std::size_t line_size = 37;
+
+  /// Append the line of the current second.
+  static void append(std::string& out);
+
+private:
+  /// Format the line of a second into line_size bytes.
+  static void format(std::time_t second, char* out);
+
+  /// Odd while line_ is being formatted.
+  static boost::atomic<unsigned> sequence_;
+  static boost::atomic<boost::int64_t> second_;
+  static char line_[line_size];
+};
+
+} // namespace server
+} // namespace http
+
+#if defined(SPLICE_HEADER_ONLY)
+# include "date_cache.hxx"
+#endif
+
+#endif // HTTP_DATE_CACHE_HPP
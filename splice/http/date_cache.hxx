@@ -0,0 +1,62 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include "date_cache.hpp"
+#include <cstring>
+#include "validators.hpp"
+
+namespace http {
+namespace server {
+
+boost::atomic<unsigned> date_cache::sequence_(0);
+boost::atomic<boost::int64_t> date_cache::second_(-1);
+char date_cache::line_[date_cache::line_size];
+
+void date_cache::append(std::string& out)
+{
+  const std::time_t now = std::time(0);
+  const std::size_t size = out.size();
+  out.resize(size + line_size);
+  char* const line = &out[size];
+
+  const unsigned sequence = sequence_.load(boost::memory_order_acquire);
+  if (!(sequence & 1)
+      && second_.load(boost::memory_order_relaxed) == now)
+  {
+    // valid unless formatted again meanwhile
+    std::memcpy(line, line_, line_size);
+    boost::atomic_thread_fence(boost::memory_order_acquire);
+    if (sequence_.load(boost::memory_order_relaxed) == sequence)
+      return;
+  }
+
+  format(now, line);
+  unsigned expected = sequence & ~1u;
+  if (sequence_.compare_exchange_strong(expected, expected + 1,
+      boost::memory_order_acquire))
+  {
+    second_.store(now, boost::memory_order_relaxed);
+    std::memcpy(line_, line, line_size);
+    sequence_.store(expected + 2, boost::memory_order_release);
+  }
+}
+
+void date_cache::format(std::time_t second, char* out)
+{
+  const std::string date = "Date: " + validators::http_date(second) + "\r\n";
+  std::memcpy(out, date.data(), line_size);
+}
+
+} // namespace server
+} // namespace http
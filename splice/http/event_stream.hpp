@@ -0,0 +1,71 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef HTTP_EVENT_STREAM_HPP
+#define HTTP_EVENT_STREAM_HPP
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include <cstddef>
+#include <string>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace http {
+namespace server {
+
+/// An event of a text/event-stream body, formatted once and shared by
+/// every session streaming it.
+typedef boost::shared_ptr<const std::string> event_ptr;
+
+/// Append an event of a text/event-stream body: its id unless 0, then a
+/// "data:" field per line of data, the client joining them back with LF.
+inline void append_event(boost::uint64_t id, const std::string& data,
+    std::string& out)
+{
+  if (id)
+  {
+    char digits[20];
+    std::size_t n = 0;
+    do
+    {
+      digits[n++] = static_cast<char>('0' + id % 10);
+      id /= 10;
+    }
+    while (id);
+
+    out += "id: ";
+    while (n)
+      out += digits[--n];
+    out += '\n';
+  }
+
+  // CRLF, CR and LF all end a line of the stream
+  std::size_t begin = 0;
+  for (;;)
+  {
+    const std::size_t end = data.find_first_of("\r\n", begin);
+    out += "data: ";
+    out.append(data, begin, end == std::string::npos ? end : end - begin);
+    out += '\n';
+    if (end == std::string::npos)
+      break;
+    begin = end + (data[end] == '\r' && end + 1 < data.size()
+      && data[end + 1] == '\n' ? 2 : 1);
+  }
+  out += '\n';
+}
+
+} // namespace server
+} // namespace http
+
+#endif // HTTP_EVENT_STREAM_HPP
@@ -0,0 +1,158 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef HTTP_FILE_BODY_HPP
+#define HTTP_FILE_BODY_HPP
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <boost/cstdint.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#if defined(__linux__)
+# define SPLICE_HAS_SENDFILE
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+namespace http {
+namespace server {
+
+/// An open file sent as the body of a reply, straight from disk. With
+/// sendfile the bytes go from the page cache to the socket, elsewhere
+/// they are read chunk by chunk, the file is never held in memory.
+class file_body
+  : private boost::noncopyable
+{
+public:
+  /// Open a regular file, null when it can't be read.
+  static boost::shared_ptr<file_body> open(const std::string& path)
+  {
+    boost::shared_ptr<file_body> body = boost::make_shared<file_body>();
+#if defined(SPLICE_HAS_SENDFILE)
+    body->fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (body->fd_ < 0 || ::fstat(body->fd_, &st) != 0 || !S_ISREG(st.st_mode))
+      return boost::shared_ptr<file_body>();
+    body->size_ = static_cast<boost::uint64_t>(st.st_size);
+    body->modified_ = st.st_mtime;
+#else
+    body->file_ = std::fopen(path.c_str(), "rb");
+    if (!body->file_ || seek(body->file_, 0, SEEK_END) != 0)
+      return boost::shared_ptr<file_body>();
+    const boost::int64_t size = tell(body->file_);
+    if (size < 0)
+      return boost::shared_ptr<file_body>();
+    body->size_ = static_cast<boost::uint64_t>(size);
+    struct stat st;
+    body->modified_ = ::stat(path.c_str(), &st) == 0 ? st.st_mtime : 0;
+#endif
+    return body;
+  }
+
+  file_body()
+#if defined(SPLICE_HAS_SENDFILE)
+    : fd_(-1)
+#else
+    : file_(0)
+#endif
+    , size_(0)
+    , modified_(0)
+  {
+  }
+
+  ~file_body()
+  {
+#if defined(SPLICE_HAS_SENDFILE)
+    if (fd_ >= 0)
+      ::close(fd_);
+#else
+    if (file_)
+      std::fclose(file_);
+#endif
+  }
+
+  boost::uint64_t size() const
+  {
+    return size_;
+  }
+
+  /// Modification time when opened.
+  std::time_t modified() const
+  {
+    return modified_;
+  }
+
+#if defined(SPLICE_HAS_SENDFILE)
+  /// Descriptor given to sendfile.
+  int native_handle() const
+  {
+    return fd_;
+  }
+#endif
+
+  /// Read up to size bytes at offset, returns the bytes read,
+  /// 0 on error or at the end of the file.
+  std::size_t read(boost::uint64_t offset, char* data, std::size_t size)
+  {
+#if defined(SPLICE_HAS_SENDFILE)
+    const ssize_t n = ::pread(fd_, data, size, static_cast<off_t>(offset));
+    return n > 0 ? static_cast<std::size_t>(n) : 0;
+#else
+    if (seek(file_, offset, SEEK_SET) != 0)
+      return 0;
+    return std::fread(data, 1, size, file_);
+#endif
+  }
+
+private:
+#if defined(SPLICE_HAS_SENDFILE)
+  int fd_;
+#else
+  // 64 bits offsets, fseek and ftell take a long, 32 bits on MSVC
+  static int seek(std::FILE* file, boost::uint64_t offset, int origin)
+  {
+# if defined(_MSC_VER)
+    return ::_fseeki64(file, static_cast<__int64>(offset), origin);
+# else
+    return ::fseeko(file, static_cast<off_t>(offset), origin);
+# endif
+  }
+
+  static boost::int64_t tell(std::FILE* file)
+  {
+# if defined(_MSC_VER)
+    return ::_ftelli64(file);
+# else
+    return ::ftello(file);
+# endif
+  }
+
+  std::FILE* file_;
+#endif
+  boost::uint64_t size_;
+  std::time_t modified_;
+};
+
+typedef boost::shared_ptr<file_body> file_body_ptr;
+
+} // namespace server
+} // namespace http
+
+#endif // HTTP_FILE_BODY_HPP
@@ -0,0 +1,162 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef HTTP_FILE_CACHE_HPP
+#define HTTP_FILE_CACHE_HPP
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include <string>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include "reply.hpp"
+
+#if defined(__linux__)
+# define SPLICE_HAS_INOTIFY
+#endif
+
+namespace http {
+namespace server {
+
+/// Files served by the request_handler, kept in memory with their header
+/// lines, keyed by decoded request path. A hit takes a shared lock and
+/// makes no filesystem call. The least recently used files are evicted
+/// beyond max_bytes of content, down to an eighth below.
+/// Text files are also held compressed, from their .gz/.br siblings when
+/// present, else compressed once when first read, so that the best coding
+/// the client accepts is served without any compression per request.
+/// On Linux a file is forgotten as soon as inotify reports a change,
+/// elsewhere only through invalidate or clear. A sibling is expected to be
+/// updated along with its file.
+class file_cache
+  : private boost::noncopyable
+{
+public:
+  /// Content codings, accepted by a client as a mask of 1 << coding.
+  enum coding
+  {
+    identity,
+    gzip, // needs SPLICE_HAS_ZLIB unless a .gz sibling exists
+    br, // needs SPLICE_HAS_BROTLI unless a .br sibling exists
+    coding_count
+  };
+
+  /// Hold up to max_bytes of content, files larger than an eighth of it
+  /// are not cached but sent from disk, see file_body.
+  explicit file_cache(std::size_t max_bytes = 32 * 1024 * 1024);
+
+  ~file_cache();
+
+  /// The file of the decoded request path, read from full_path on a miss,
+  /// in the best of the accepted codings, br then gzip then identity.
+  /// Null when the file can't be read or is too large to be cached.
+  shared_content_ptr get(const std::string& path,
+      const std::string& full_path, const std::string& extension,
+      unsigned accepted = 1 << identity);
+
+  /// Forget a request path, the file is read again on next get.
+  void invalidate(const std::string& path);
+
+  /// Forget every file.
+  void clear();
+
+  /// Content bytes held.
+  std::size_t size() const;
+
+private:
+  struct entry
+  {
+    /// The file in each coding, null when not worth it.
+    shared_content_ptr files[coding_count];
+    std::size_t bytes;
+    int watch;
+
+    /// Tick of the last hit, the smallest one is evicted first.
+    boost::atomic<boost::uint64_t> last_use;
+  };
+
+  typedef boost::shared_ptr<entry> entry_ptr;
+
+  /// Read a file of at most max_size bytes in every coding, with
+  /// their header lines. Returns false when the file can't be read.
+  static bool load(entry& e, const std::string& full_path,
+      const std::string& extension, std::size_t max_size);
+
+  /// Read a whole file of at most max_size bytes.
+  static bool read_file(const std::string& full_path, std::size_t max_size,
+      std::string& content);
+
+  /// Compress a content once and for all, at the best level.
+  static bool compress(coding c, const std::string& in, std::string& out);
+
+  /// The best coding of an entry among the accepted ones.
+  static const shared_content_ptr& select(const entry& e, unsigned accepted);
+
+  /// Whether a last hit is older than another, for evict.
+  static bool older(
+      const std::pair<boost::uint64_t,
+        boost::unordered_map<std::string, entry_ptr>::iterator>& a,
+      const std::pair<boost::uint64_t,
+        boost::unordered_map<std::string, entry_ptr>::iterator>& b);
+
+  /// Remove an entry, the lock being held. Returns the next entry.
+  boost::unordered_map<std::string, entry_ptr>::iterator
+  erase(boost::unordered_map<std::string, entry_ptr>::iterator it);
+
+  /// Evict the least recently used files once size exceeds max_bytes_,
+  /// the lock being held. The entries are ordered once by their last
+  /// hit, the hits only take the shared lock and can't keep a list.
+  void evict();
+
+#if defined(SPLICE_HAS_INOTIFY)
+  /// Remove a watch no longer used by any file, the lock being held.
+  void release_watch(int watch);
+
+  /// Number of entries of each watch, a watch is shared by the paths
+  /// of a same file.
+  boost::unordered_map<int, std::size_t> watches_;
+
+  /// Forget the files of an inotify watch descriptor.
+  void on_change(int watch);
+
+  /// Watcher thread, reads inotify events until stopping_.
+  void watch_loop();
+
+  int inotify_fd_;
+  boost::atomic<bool> stopping_;
+
+  /// Incremented by every change, a file read meanwhile isn't kept.
+  boost::atomic<boost::uint64_t> changes_;
+  boost::thread watcher_;
+#endif
+
+  const std::size_t max_bytes_;
+  std::size_t bytes_;
+  boost::atomic<boost::uint64_t> clock_;
+
+  boost::unordered_map<std::string, entry_ptr> files_;
+  mutable boost::shared_mutex mutex_;
+};
+
+} // namespace server
+} // namespace http
+
+#if defined(SPLICE_HEADER_ONLY)
+# include "file_cache.hxx"
+#endif
+
+#endif // HTTP_FILE_CACHE_HPP
@@ -0,0 +1,400 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include "file_cache.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread/locks.hpp>
+#include "mime_types.hpp"
+#include "validators.hpp"
+
+#if defined(SPLICE_HAS_ZLIB)
+# include <zlib.h>
+#endif
+#if defined(SPLICE_HAS_BROTLI)
+# include <brotli/encode.h>
+#endif
+
+#if defined(SPLICE_HAS_INOTIFY)
+# include <poll.h>
+# include <unistd.h>
+# include <sys/inotify.h>
+#endif
+
+namespace http {
+namespace server {
+
+file_cache::file_cache(std::size_t max_bytes)
+  : max_bytes_(max_bytes)
+  , bytes_(0)
+  , clock_(0)
+{
+#if defined(SPLICE_HAS_INOTIFY)
+  stopping_ = false;
+  changes_ = 0;
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd_ >= 0)
+    watcher_ = boost::thread(boost::bind(&file_cache::watch_loop, this));
+#endif
+}
+
+file_cache::~file_cache()
+{
+#if defined(SPLICE_HAS_INOTIFY)
+  stopping_ = true;
+  if (watcher_.joinable())
+    watcher_.join();
+  if (inotify_fd_ >= 0)
+    ::close(inotify_fd_);
+#endif
+}
+
+shared_content_ptr file_cache::get(const std::string& path,
+    const std::string& full_path, const std::string& extension,
+    unsigned accepted)
+{
+  {
+    boost::shared_lock<boost::shared_mutex> lock(mutex_);
+    boost::unordered_map<std::string, entry_ptr>::const_iterator it =
+      files_.find(path);
+    if (it != files_.end())
+    {
+      it->second->last_use.store(++clock_, boost::memory_order_relaxed);
+      return select(*it->second, accepted);
+    }
+  }
+
+  // Watched before being read, a change while reading isn't missed.
+  int watch = -1;
+#if defined(SPLICE_HAS_INOTIFY)
+  const boost::uint64_t changes = changes_.load();
+  if (inotify_fd_ >= 0)
+    watch = inotify_add_watch(inotify_fd_, full_path.c_str(),
+        IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF);
+#endif
+
+  entry_ptr loaded = boost::make_shared<entry>();
+  if (!load(*loaded, full_path, extension, max_bytes_ / 8))
+  {
+#if defined(SPLICE_HAS_INOTIFY)
+    if (watch >= 0)
+    {
+      boost::unique_lock<boost::shared_mutex> lock(mutex_);
+      release_watch(watch);
+    }
+#endif
+    return shared_content_ptr();
+  }
+
+  boost::unique_lock<boost::shared_mutex> lock(mutex_);
+#if defined(SPLICE_HAS_INOTIFY)
+  if (changes != changes_.load())
+  { // may be stale already
+    release_watch(watch);
+    return select(*loaded, accepted);
+  }
+#endif
+  entry_ptr& e = files_[path];
+  if (e)
+    return select(*e, accepted); // read by another thread meanwhile
+
+  e = loaded;
+  e->watch = watch;
+#if defined(SPLICE_HAS_INOTIFY)
+  if (watch >= 0)
+    ++watches_[watch];
+#endif
+  e->last_use.store(++clock_, boost::memory_order_relaxed);
+  bytes_ += e->bytes;
+  evict();
+  return select(*loaded, accepted);
+}
+
+void file_cache::invalidate(const std::string& path)
+{
+  boost::unique_lock<boost::shared_mutex> lock(mutex_);
+  boost::unordered_map<std::string, entry_ptr>::iterator it = files_.find(path);
+  if (it != files_.end())
+    erase(it);
+}
+
+void file_cache::clear()
+{
+  boost::unique_lock<boost::shared_mutex> lock(mutex_);
+  while (!files_.empty())
+    erase(files_.begin());
+}
+
+std::size_t file_cache::size() const
+{
+  boost::shared_lock<boost::shared_mutex> lock(mutex_);
+  return bytes_;
+}
+
+bool file_cache::load(entry& e, const std::string& full_path,
+    const std::string& extension, std::size_t max_size)
+{
+  static const char* const names[coding_count] = { "", "gzip", "br" };
+  static const char* const suffixes[coding_count] = { "", ".gz", ".br" };
+
+  std::string contents[coding_count];
+  struct stat st;
+  if (::stat(full_path.c_str(), &st) != 0
+      || !read_file(full_path, max_size, contents[identity]))
+    return false;
+  const std::size_t size = contents[identity].size();
+
+  // a precompressed sibling is taken as is, else text is compressed
+  // here and kept only when smaller
+  const std::string type = mime_types::extension_to_type(extension);
+  const bool compressible = mime_types::is_compressible(type);
+  bool vary = compressible;
+  bool present[coding_count] = { true };
+  for (int c = identity + 1; c < coding_count; ++c)
+  {
+    if (read_file(full_path + suffixes[c], max_size, contents[c]))
+      present[c] = true;
+    else if (compressible
+        && compress(coding(c), contents[identity], contents[c]))
+      present[c] = contents[c].size() < contents[identity].size();
+    vary = vary || present[c];
+  }
+
+  e.bytes = 0;
+  for (int c = identity; c < coding_count; ++c)
+  {
+    if (!present[c])
+      continue;
+    // the validators are also the header lines of a 304
+    const std::string etag = validators::etag(size, st.st_mtime,
+        c != identity ? names[c] : 0);
+    std::string validator_lines = "ETag: " + etag + "\r\n"
+      "Last-Modified: " + validators::http_date(st.st_mtime) + "\r\n";
+    if (vary)
+      validator_lines += "Vary: Accept-Encoding\r\n";
+
+    // whole header blocks, sent as is
+    boost::shared_ptr<shared_content> not_modified =
+      boost::make_shared<shared_content>();
+    not_modified->etag = etag;
+    not_modified->last_modified = st.st_mtime;
+    not_modified->head = reply::status_line(reply::not_modified)
+      + validator_lines;
+
+    boost::shared_ptr<shared_content> file = boost::make_shared<shared_content>();
+    file->content.swap(contents[c]);
+    file->head = reply::status_line(reply::ok)
+      + "Content-Length: " + size_string(file->content.size()) + "\r\n"
+      "Content-Type: " + type + "\r\n";
+    if (c != identity)
+      file->head += std::string("Content-Encoding: ") + names[c] + "\r\n";
+    else
+      file->head += "Accept-Ranges: bytes\r\n";
+    file->head += validator_lines;
+    file->etag = etag;
+    file->last_modified = st.st_mtime;
+    file->not_modified = not_modified;
+    e.bytes += file->content.size();
+    e.files[c] = file;
+  }
+  return true;
+}
+
+bool file_cache::read_file(const std::string& full_path, std::size_t max_size,
+    std::string& content)
+{
+  std::ifstream is(full_path.c_str(), std::ios::in | std::ios::binary);
+  if (!is)
+    return false;
+
+  // read at once, the size being known
+  is.seekg(0, std::ios::end);
+  const std::streamoff size = is.tellg();
+  is.seekg(0, std::ios::beg);
+  if (size < 0 || static_cast<boost::uint64_t>(size) > max_size)
+    return false;
+  content.resize(static_cast<std::size_t>(size));
+  return !size || is.read(&content[0], size);
+}
+
+bool file_cache::compress(coding c, const std::string& in, std::string& out)
+{
+  if (in.empty())
+    return false;
+
+  switch (c)
+  {
+#if defined(SPLICE_HAS_ZLIB)
+  case gzip:
+  {
+    z_stream stream = z_stream();
+    // 16 added to the window bits for a gzip wrapper
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9,
+        Z_DEFAULT_STRATEGY) != Z_OK)
+      return false;
+    out.resize(deflateBound(&stream, static_cast<uLong>(in.size())));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    stream.avail_in = static_cast<uInt>(in.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+    const int result = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return result == Z_STREAM_END;
+  }
+#endif
+#if defined(SPLICE_HAS_BROTLI)
+  case br:
+  {
+    std::size_t size = BrotliEncoderMaxCompressedSize(in.size());
+    if (!size)
+      return false;
+    out.resize(size);
+    if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW,
+        BROTLI_MODE_TEXT, in.size(), reinterpret_cast<const uint8_t*>(in.data()),
+        &size, reinterpret_cast<uint8_t*>(&out[0])))
+      return false;
+    out.resize(size);
+    return true;
+  }
+#endif
+  default:
+    return false;
+  }
+}
+
+const shared_content_ptr& file_cache::select(const entry& e, unsigned accepted)
+{
+  // identity is always there, sent even if refused
+  for (int c = coding_count - 1; c > identity; --c)
+    if ((accepted & (1u << c)) && e.files[c])
+      return e.files[c];
+  return e.files[identity];
+}
+
+bool file_cache::older(
+    const std::pair<boost::uint64_t,
+      boost::unordered_map<std::string, entry_ptr>::iterator>& a,
+    const std::pair<boost::uint64_t,
+      boost::unordered_map<std::string, entry_ptr>::iterator>& b)
+{
+  return a.first < b.first;
+}
+
+boost::unordered_map<std::string, file_cache::entry_ptr>::iterator
+file_cache::erase(boost::unordered_map<std::string, entry_ptr>::iterator it)
+{
+  const int watch = it->second->watch;
+  bytes_ -= it->second->bytes;
+  it = files_.erase(it);
+
+#if defined(SPLICE_HAS_INOTIFY)
+  if (watch >= 0)
+    --watches_[watch];
+  release_watch(watch);
+#endif
+  return it;
+}
+
+void file_cache::evict()
+{
+  if (bytes_ <= max_bytes_)
+    return;
+
+  // erasing an entry leaves the iterators of the others valid
+  typedef boost::unordered_map<std::string, entry_ptr>::iterator iterator;
+  std::vector<std::pair<boost::uint64_t, iterator> > by_use;
+  by_use.reserve(files_.size());
+  for (iterator it = files_.begin(); it != files_.end(); ++it)
+    by_use.push_back(std::make_pair(
+        it->second->last_use.load(boost::memory_order_relaxed), it));
+  std::sort(by_use.begin(), by_use.end(), older);
+
+  // down an eighth below the limit, a pass is made every so many loads
+  // rather than on each one
+  const std::size_t low = max_bytes_ - max_bytes_ / 8;
+  for (std::size_t i = 0; i < by_use.size() && bytes_ > low; ++i)
+    erase(by_use[i].second);
+}
+
+#if defined(SPLICE_HAS_INOTIFY)
+
+void file_cache::release_watch(int watch)
+{
+  // a watch is shared by the paths of a same file
+  if (watch < 0)
+    return;
+  boost::unordered_map<int, std::size_t>::iterator it = watches_.find(watch);
+  if (it != watches_.end())
+  {
+    if (it->second)
+      return;
+    watches_.erase(it);
+  }
+  inotify_rm_watch(inotify_fd_, watch);
+}
+
+void file_cache::on_change(int watch)
+{
+  boost::unique_lock<boost::shared_mutex> lock(mutex_);
+  ++changes_;
+  // no file left, as on the IN_IGNORED of a released watch
+  boost::unordered_map<int, std::size_t>::const_iterator used =
+    watches_.find(watch);
+  if (used == watches_.end() || !used->second)
+    return;
+  for (boost::unordered_map<std::string, entry_ptr>::iterator it = files_.begin();
+      it != files_.end();)
+  {
+    if (it->second->watch == watch)
+      it = erase(it);
+    else
+      ++it;
+  }
+}
+
+void file_cache::watch_loop()
+{
+  // aligned as inotify_event, events are read in batches
+  union
+  {
+    inotify_event event;
+    char bytes[4096];
+  } buffer;
+
+  while (!stopping_)
+  {
+    pollfd fd = { inotify_fd_, POLLIN, 0 };
+    if (::poll(&fd, 1, 200) <= 0)
+      continue;
+
+    const ssize_t size = ::read(inotify_fd_, buffer.bytes, sizeof(buffer.bytes));
+    for (ssize_t i = 0; i + ssize_t(sizeof(inotify_event)) <= size;)
+    {
+      const inotify_event* event =
+        reinterpret_cast<const inotify_event*>(buffer.bytes + i);
+      on_change(event->wd);
+      i += sizeof(inotify_event) + event->len;
+    }
+  }
+}
+
+#endif // defined(SPLICE_HAS_INOTIFY)
+
+} // namespace server
+} // namespace http
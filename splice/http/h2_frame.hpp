@@ -0,0 +1,158 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef HTTP_H2_FRAME_HPP
+#define HTTP_H2_FRAME_HPP
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include <cstddef>
+#include <string>
+#include <boost/cstdint.hpp>
+
+namespace http {
+namespace server {
+namespace h2 {
+
+/// The client connection preface, sent before its first frame.
+const char preface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+const std::size_t preface_size = sizeof(preface) - 1;
+
+/// Bytes of a frame header.
+const std::size_t frame_header_size = 9;
+
+/// Default, and smallest, SETTINGS_MAX_FRAME_SIZE, the one of this server.
+const std::size_t default_frame_size = 16384;
+
+/// Bytes of header fields a request may have, SETTINGS_MAX_HEADER_LIST_SIZE
+/// of this server, also the most a header block may take.
+const std::size_t header_list_limit = 65536;
+
+/// Default SETTINGS_INITIAL_WINDOW_SIZE, and largest window.
+const boost::int64_t default_window_size = 65535;
+const boost::int64_t max_window_size = 0x7fffffff;
+
+enum frame_type
+{
+  data = 0x0,
+  headers = 0x1,
+  priority = 0x2,
+  rst_stream = 0x3,
+  settings = 0x4,
+  push_promise = 0x5,
+  ping = 0x6,
+  goaway = 0x7,
+  window_update = 0x8,
+  continuation = 0x9
+};
+
+enum frame_flag
+{
+  ack = 0x1,
+  end_stream = 0x1,
+  end_headers = 0x4,
+  padded = 0x8,
+  priority_flag = 0x20
+};
+
+enum settings_id
+{
+  header_table_size = 0x1,
+  enable_push = 0x2,
+  max_concurrent_streams = 0x3,
+  initial_window_size = 0x4,
+  max_frame_size = 0x5,
+  max_header_list_size = 0x6
+};
+
+enum error_code
+{
+  no_error = 0x0,
+  protocol_error = 0x1,
+  internal_error = 0x2,
+  flow_control_error = 0x3,
+  settings_timeout = 0x4,
+  stream_closed = 0x5,
+  frame_size_error = 0x6,
+  refused_stream = 0x7,
+  cancel = 0x8,
+  compression_error = 0x9,
+  connect_error = 0xa,
+  enhance_your_calm = 0xb,
+  inadequate_security = 0xc,
+  http_1_1_required = 0xd
+};
+
+/// The header of a frame, its payload following.
+struct frame_header
+{
+  boost::uint32_t length;
+  boost::uint8_t type;
+  boost::uint8_t flags;
+  boost::uint32_t stream_id;
+};
+
+inline boost::uint32_t read_uint32(const char* p)
+{
+  const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+  return (boost::uint32_t(u[0]) << 24) | (boost::uint32_t(u[1]) << 16)
+    | (boost::uint32_t(u[2]) << 8) | u[3];
+}
+
+inline void append_uint32(boost::uint32_t value, std::string& out)
+{
+  out += static_cast<char>(value >> 24);
+  out += static_cast<char>(value >> 16);
+  out += static_cast<char>(value >> 8);
+  out += static_cast<char>(value);
+}
+
+/// Parse the frame_header_size bytes at p.
+inline frame_header read_frame_header(const char* p)
+{
+  const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+  frame_header h;
+  h.length = (boost::uint32_t(u[0]) << 16) | (boost::uint32_t(u[1]) << 8)
+    | u[2];
+  h.type = u[3];
+  h.flags = u[4];
+  // the reserved bit is ignored
+  h.stream_id = read_uint32(p + 5) & 0x7fffffff;
+  return h;
+}
+
+/// Append the header of a frame, its payload to follow.
+inline void append_frame_header(std::size_t length, frame_type type,
+    boost::uint8_t flags, boost::uint32_t stream_id, std::string& out)
+{
+  out += static_cast<char>(length >> 16);
+  out += static_cast<char>(length >> 8);
+  out += static_cast<char>(length);
+  out += static_cast<char>(type);
+  out += static_cast<char>(flags);
+  append_uint32(stream_id, out);
+}
+
+/// Append a parameter of a SETTINGS frame.
+inline void append_setting(settings_id id, boost::uint32_t value,
+    std::string& out)
+{
+  out += static_cast<char>(id >> 8);
+  out += static_cast<char>(id);
+  append_uint32(value, out);
+}
+
+} // namespace h2
+} // namespace server
+} // namespace http
+
+#endif // HTTP_H2_FRAME_HPP
@@ -0,0 +1,361 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef HTTP_H2_SESSION_HPP
+#define HTTP_H2_SESSION_HPP
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "h2_frame.hpp"
+#include "hpack.hpp"
+#include "reply.hpp"
+#include "request.hpp"
+#include "request_handler.hpp"
+#include "request_parser.hpp"
+#include "router.hpp"
+
+#include "../tcp_session.hpp"
+
+namespace splice
+{
+
+  /// A cleartext HTTP/2 connection, h2c, answering the requests of its
+  /// streams as an http_session does, through a request_handler or a
+  /// router. A client either knows the server speaks HTTP/2 and starts
+  /// with the connection preface, or upgrades an HTTP/1.1 request with
+  /// "Upgrade: h2c", the request being then answered on stream 1.
+  /// In a multi protocol server it is tried before the http_session,
+  /// which would take the preface for a request.
+  /// Replies are sent as DATA frames, a frame of each stream in turn,
+  /// within the flow control windows of the client; one write is in
+  /// flight at a time, gathering the frames ready meanwhile.
+  /// File bodies are read a chunk at a time with a blocking read posted
+  /// to the io_service, off the strand: other streams go on meanwhile,
+  /// but the read holds an io_service thread, without the sendfile of
+  /// an http_session. Files held by the file_cache are sent from memory.
+  template <typename up_t,typename log_t=no_log>
+  class h2_session
+    :public tcp_session<up_t,log_t>
+  {
+  public:
+    using base_t=tcp_session<up_t,log_t>;
+
+    explicit h2_session(socket_t& socket
+      ,http::server::request_handler& handler);
+
+    h2_session(socket_t& socket
+      ,http::server::router& router);
+
+  protected:
+
+    template<typename _t>
+    void handshake(
+      _t handshake_fail,
+      hand_shake_data_t& incoming);
+
+    // Start the first asynchronous operation for a multi protocol server
+    template< typename _t>
+    void on_first_read(
+      _t handshake_fail,
+      incoming_data_ptr incoming_data,
+      std::size_t bytes_transferred,
+      const boost::system::error_code& ec);
+
+    // CRTP virtual function, how long a connection may stay without any
+    // stream before being closed.
+    boost::posix_time::time_duration keep_alive_timeout();
+
+    // CRTP virtual function, streams a client may have open at once,
+    // SETTINGS_MAX_CONCURRENT_STREAMS.
+    unsigned max_concurrent_streams();
+
+    // CRTP virtual function, bytes of content a request may have, beyond
+    // them it is answered with a 413.
+    boost::uint64_t max_body_size();
+
+    // CRTP virtual function, a run of the content of req, in place in the
+    // receive buffer, valid during the call only. The default gathers the
+    // content in req.body.
+    void on_body_chunk(const http::server::request& req
+      ,const char* data
+      ,std::size_t size);
+
+    // CRTP virtual function, bytes of DATA frames gathered in a write
+    // before giving way to other sessions.
+    std::size_t data_batch_size();
+
+    friend class base_t;
+
+  private:
+    struct stream;
+    typedef boost::shared_ptr<stream> stream_ptr;
+
+    // The chunk_writer of a streamed reply, keeps the session alive
+    class stream_writer;
+
+    // Queue the SETTINGS of the server
+    void send_settings();
+
+    // Handle the bytes of the first read left in [begin,end), then read
+    // frames
+    void start(incoming_data_ptr incoming_data
+      ,const char* begin
+      ,const char* end);
+
+    void async_read(incoming_data_ptr incoming_data);
+
+    void handle_read(incoming_data_ptr incoming_data
+      ,const boost::system::error_code& e
+      ,std::size_t bytes_transferred);
+
+    // Handle the frames of [begin,end), returns the end of the last
+    // complete one
+    const char* on_bytes(const char* begin,const char* end);
+
+    void on_frame(const http::server::h2::frame_header& h
+      ,const char* payload);
+
+    void on_data(const http::server::h2::frame_header& h
+      ,const char* payload);
+
+    void on_headers(const http::server::h2::frame_header& h
+      ,const char* payload);
+
+    // The header block of a stream is complete
+    void on_header_block(boost::uint32_t stream_id,bool end_stream);
+
+    // Apply SETTINGS of the client, false on a connection error
+    bool on_settings(const char* payload,std::size_t size);
+
+    void on_window_update(const http::server::h2::frame_header& h
+      ,const char* payload);
+
+    // The payload of a frame without its padding, false when the padding
+    // is longer than the payload
+    static bool unpad(const http::server::h2::frame_header& h
+      ,const char*& payload
+      ,std::size_t& size);
+
+    // A request fully received, answer it
+    void respond(const stream_ptr& s);
+
+    // Answer a request with a stock reply before it is fully received,
+    // the stream being reset once the reply is sent
+    void refuse(const stream_ptr& s
+      ,http::server::reply::status_type status);
+
+    // Send the reply of a stream, its header block first
+    void send_reply(const stream_ptr& s);
+
+    // Add a field of a reply to block_, unless it is specific to HTTP/1
+    void encode_field(const char* name
+      ,std::size_t name_size
+      ,const std::string& value);
+
+    // Queue the header block of a stream, split to the frame size of the
+    // client
+    void send_header_block(boost::uint32_t stream_id
+      ,const std::string& block
+      ,bool end_stream);
+
+    // Streamed reply of a stream, a chunk of its body, and its end
+    void write_chunk(const stream_ptr& s
+      ,boost::asio::const_buffer data
+      ,http::server::chunk_writer::handler_type handler);
+
+    void end_chunks(const stream_ptr& s);
+
+    // A stream having DATA to send gets its turn
+    void schedule(const stream_ptr& s);
+
+    // Read the next chunk of the front file segment of a stream, off the
+    // strand, the stream is scheduled again once it is read
+    void read_file(const stream_ptr& s);
+
+    void do_read_file(const stream_ptr& s
+      ,http::server::file_body_ptr file
+      ,boost::uint64_t offset);
+
+    void on_file_read(const stream_ptr& s,std::size_t size);
+
+    // The stream is over, either way
+    void close_stream(const stream_ptr& s
+      ,const boost::system::error_code& ec);
+
+    void reset_stream(boost::uint32_t stream_id
+      ,http::server::h2::error_code code);
+
+    // Send a GOAWAY then close the connection
+    void connection_error(http::server::h2::error_code code);
+
+    void send_window_update(boost::uint32_t stream_id
+      ,boost::uint32_t increment);
+
+    // Write the control frames then DATA frames of the streams in turn,
+    // unless a write is in flight
+    void flush();
+
+    // Add size bytes at data, or at offset in out_, to the next write
+    void add_piece(const char* data
+      ,std::size_t offset
+      ,std::size_t size);
+
+    // Call the handler of a chunk once the write in flight, if any, is
+    // done with it
+    void defer(const http::server::chunk_writer::handler_type& handler
+      ,const boost::system::error_code& ec);
+
+    void handle_write(const boost::system::error_code& e);
+
+    void on_idle_timeout(const boost::system::error_code& e);
+
+    // Close the socket, streamed replies are told so
+    void close(const boost::system::error_code& ec);
+
+    // The bytes of the HTTP2-Settings header of an upgrade request
+    static bool decode_base64url(const std::string& in,std::string& out);
+
+    // Whether req asks for an upgrade to h2c
+    static bool wants_h2c(const http::server::request& req);
+
+    /// A part of a body to send, memory owned by the reply of the stream,
+    /// or a range of its file, and the handler of a streamed chunk.
+    struct segment
+    {
+      const char* data;
+      http::server::file_body_ptr file;
+      boost::uint64_t offset;
+      std::size_t size;
+      http::server::chunk_writer::handler_type handler;
+    };
+
+    struct stream
+    {
+      boost::uint32_t id;
+      http::server::request request;
+      http::server::reply reply;
+
+      /// Content received, and whether the request is complete.
+      boost::uint64_t body_size;
+      bool end_remote;
+
+      /// Bytes received not given back by a WINDOW_UPDATE yet, and the
+      /// window of the client.
+      boost::uint32_t unacked;
+      boost::int64_t window;
+
+      /// The body left to send, its end once out is sent, the last frame
+      /// being followed by a RST_STREAM when the request is cut short.
+      std::deque<segment> out;
+      bool end_local;
+      bool reset_after;
+
+      /// Whether the reply is being sent, the stream is in ready_, and
+      /// the stream is over.
+      bool responding;
+      bool queued;
+      bool closed;
+
+      /// The chunk of the front file segment read, the bytes before
+      /// file_at being sent, and whether a read is in progress.
+      std::vector<char> file_chunk;
+      std::size_t file_at;
+      bool file_reading;
+    };
+
+    /// The handler used to process the incoming requests, or the router
+    /// dispatching them, one of them being null.
+    http::server::request_handler* request_handler_;
+    http::server::router* router_;
+
+    /// Header compression, each way.
+    http::server::hpack_decoder decoder_;
+    http::server::hpack_encoder encoder_;
+
+    /// Bytes of the connection preface to receive yet.
+    std::size_t preface_left_;
+
+    /// Bytes received but not parsed yet, part of a frame.
+    std::vector<char> pending_;
+
+    /// A header block split among CONTINUATION frames, its stream and
+    /// whether the stream ends with it.
+    std::string header_block_;
+    boost::uint32_t header_stream_;
+    bool header_end_stream_;
+    std::vector<http::server::header> fields_;
+
+    /// The open streams, the ones with DATA to send in turn, and the
+    /// highest stream the client opened.
+    std::map<boost::uint32_t,stream_ptr> streams_;
+    std::deque<stream_ptr> ready_;
+    boost::uint32_t last_stream_id_;
+
+    /// Settings of the client, the window of the connection, and the
+    /// bytes received on it not given back yet.
+    boost::int64_t initial_window_;
+    std::size_t max_frame_size_;
+    boost::int64_t window_;
+    boost::uint32_t unacked_;
+
+    /// Frames other than DATA, sent first in the next write.
+    std::string control_;
+
+    /// The write in flight: its frame headers and copied payloads, the
+    /// buffers, the streams whose memory they point to, and the handlers
+    /// of the chunks they complete.
+    struct piece
+    {
+      const char* data;
+      std::size_t offset;
+      std::size_t size;
+    };
+    std::string out_;
+    std::vector<piece> pieces_;
+    std::vector<boost::asio::const_buffer> buffers_;
+    std::vector<stream_ptr> in_flight_;
+    std::vector<std::pair<http::server::chunk_writer::handler_type
+      ,boost::system::error_code> > written_;
+    bool writing_;
+
+    /// A GOAWAY is sent, or received, the connection closes once the
+    /// frames queued, or the streams left, are sent.
+    bool going_away_;
+    bool peer_going_away_;
+    bool closed_;
+
+    /// Closes a connection without any stream for too long.
+    boost::asio::deadline_timer idle_timer_;
+
+    /// Reused by send_reply.
+    std::string block_;
+    std::string name_;
+    std::string value_;
+    std::string date_;
+  };
+
+} // namespace splice
+
+#if defined(SPLICE_HEADER_ONLY)
+# include "h2_session.hxx"
+#endif // defined(SPLICE_HEADER_ONLY)
+
+#endif // HTTP_H2_SESSION_HPP
@@ -0,0 +1,1458 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include "h2_session.hpp"
+#include <algorithm>
+#include <cstring>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/asio/placeholders.hpp>
+#include "date_cache.hpp"
+
+namespace splice
+{
+
+  template <typename up_t,typename log_t>
+  h2_session<up_t,log_t>::h2_session
+    (socket_t& socket
+    ,http::server::request_handler& handler)
+    :base_t(socket)
+    ,request_handler_(&handler)
+    ,router_(0)
+    ,preface_left_(http::server::h2::preface_size)
+    ,header_stream_(0)
+    ,header_end_stream_(false)
+    ,last_stream_id_(0)
+    ,initial_window_(http::server::h2::default_window_size)
+    ,max_frame_size_(http::server::h2::default_frame_size)
+    ,window_(http::server::h2::default_window_size)
+    ,unacked_(0)
+    ,writing_(false)
+    ,going_away_(false)
+    ,peer_going_away_(false)
+    ,closed_(false)
+    ,idle_timer_(get_io_service())
+  {
+    // writes are gathered by flush, Nagle would hold the tail of a
+    // write while the next chunk of a file is read
+    boost::system::error_code ignored_ec;
+    get_socket().set_option(boost::asio::ip::tcp::no_delay(true),ignored_ec);
+  }
+
+  template <typename up_t,typename log_t>
+  h2_session<up_t,log_t>::h2_session
+    (socket_t& socket
+    ,http::server::router& router)
+    :base_t(socket)
+    ,request_handler_(0)
+    ,router_(&router)
+    ,preface_left_(http::server::h2::preface_size)
+    ,header_stream_(0)
+    ,header_end_stream_(false)
+    ,last_stream_id_(0)
+    ,initial_window_(http::server::h2::default_window_size)
+    ,max_frame_size_(http::server::h2::default_frame_size)
+    ,window_(http::server::h2::default_window_size)
+    ,unacked_(0)
+    ,writing_(false)
+    ,going_away_(false)
+    ,peer_going_away_(false)
+    ,closed_(false)
+    ,idle_timer_(get_io_service())
+  {
+    // writes are gathered by flush, Nagle would hold the tail of a
+    // write while the next chunk of a file is read
+    boost::system::error_code ignored_ec;
+    get_socket().set_option(boost::asio::ip::tcp::no_delay(true),ignored_ec);
+  }
+
+  template <typename up_t,typename log_t>
+  template<typename _t>
+  void h2_session<up_t,log_t>::handshake(
+    _t handshake_fail,
+    hand_shake_data_t& incoming)
+  {
+    log_info_t(EZ_FLFT,
+      "incoming= ",incoming.data(),incoming.size());
+
+    if(incoming.tag_!=hand_shake_t::http)
+    {
+      handshake_fail(incoming,move_socket());
+      return;
+    }
+
+    const boost::system::error_code ec;
+    on_first_read(
+      handshake_fail,
+      incoming.data_,
+      incoming.size(),
+      ec);
+  }
+
+  template <typename up_t,typename log_t>
+  template< typename _t>
+  void h2_session<up_t,log_t>::on_first_read(
+    _t handshake_fail,
+    incoming_data_ptr incoming_data,
+    std::size_t bytes_transferred,
+    const boost::system::error_code& ec)
+  {
+    namespace h2=http::server::h2;
+    using namespace http::server;
+
+    log_trace(EZ_FLFT,"");
+    if(ec)
+    {
+      if(ec!=boost::asio::error::operation_aborted)
+        cast_up()->on_error_code(EZ_FLF,ec);
+      return;
+    }
+
+    const char* const begin=incoming_data->data();
+    const char* const end=begin+bytes_transferred;
+
+    // prior knowledge, the preface at least up to the end of its request
+    // line, "PRI * HTTP/2.0"
+    const std::size_t n=(std::min)(bytes_transferred,h2::preface_size);
+    if(n>=16&&std::memcmp(begin,h2::preface,n)==0)
+    {
+      log_info(EZ_FLFT,"HTTP/2 connection preface");
+      send_settings();
+      start(incoming_data,begin,end);
+      return;
+    }
+
+    // an HTTP/1.1 request asking for an upgrade, answered on stream 1
+    request_parser parser;
+    stream_ptr s=boost::make_shared<stream>();
+    boost::tribool result;
+    const char* next;
+    boost::tie(result,next)=parser.parse(s->request,begin,end);
+
+    std::string settings;
+    bool upgrade=false;
+    if(result)
+      upgrade=wants_h2c(s->request);
+    for(auto& h:s->request.headers)
+      if(upgrade&&boost::algorithm::iequals(h.name,"HTTP2-Settings"))
+        upgrade=decode_base64url(h.value,settings)&&settings.size()%6==0;
+
+    if(!upgrade)
+    {
+      hand_shake_data_t incoming(incoming_data,bytes_transferred,hand_shake_t::http);
+      handshake_fail(incoming,cast_up()->move_socket());
+      return;
+    }
+
+    log_info(EZ_FLFT,"upgrade to h2c");
+    control_="HTTP/1.1 101 Switching Protocols\r\n"
+      "Connection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+    send_settings();
+    if(!on_settings(settings.data(),settings.size()))
+    {
+      start(incoming_data,end,end);
+      return;
+    }
+
+    s->id=1;
+    s->body_size=0;
+    s->end_remote=true;
+    s->unacked=0;
+    s->window=initial_window_;
+    s->end_local=false;
+    s->reset_after=false;
+    s->responding=false;
+    s->queued=false;
+    s->closed=false;
+    s->file_at=0;
+    s->file_reading=false;
+    streams_[1]=s;
+    last_stream_id_=1;
+    respond(s);
+
+    start(incoming_data,next,end);
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::send_settings()
+  {
+    namespace h2=http::server::h2;
+
+    h2::append_frame_header(12,h2::settings,0,0,control_);
+    h2::append_setting(h2::max_concurrent_streams,
+      cast_up()->max_concurrent_streams(),control_);
+    h2::append_setting(h2::max_header_list_size,
+      static_cast<boost::uint32_t>(h2::header_list_limit),control_);
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::start(
+    incoming_data_ptr incoming_data,
+    const char* begin,
+    const char* end)
+  {
+    const char* const next=on_bytes(begin,end);
+    pending_.assign(next,end);
+    flush();
+    if(!closed_&&!going_away_)
+      async_read(incoming_data);
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::async_read(incoming_data_ptr incoming_data)
+  {
+    idle_timer_.expires_from_now(cast_up()->keep_alive_timeout());
+    idle_timer_.async_wait(get_strand().wrap(
+      boost::bind(&h2_session::on_idle_timeout,shared_from_this(),
+      boost::asio::placeholders::error)));
+
+    get_socket().async_read_some(boost::asio::buffer(*incoming_data),
+      get_strand().wrap(
+      boost::bind(&h2_session::handle_read,shared_from_this(),
+      incoming_data,
+      boost::asio::placeholders::error,
+      boost::asio::placeholders::bytes_transferred)));
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::handle_read(
+    incoming_data_ptr buffer,
+    const boost::system::error_code& e,
+    std::size_t bytes_transferred)
+  {
+    if(closed_)
+      return;
+    if(e)
+    {
+      log_trace(EZ_FLFT,e.message());
+      close(e);
+      return;
+    }
+
+    boost::system::error_code ignored_ec;
+    idle_timer_.cancel(ignored_ec);
+
+    // frames are parsed in place, only the start of the last one, if
+    // incomplete, is kept for the next read
+    const char* const begin=buffer->data();
+    const char* const end=begin+bytes_transferred;
+    if(pending_.empty())
+    {
+      const char* const next=on_bytes(begin,end);
+      pending_.assign(next,end);
+    }
+    else
+    {
+      pending_.insert(pending_.end(),begin,end);
+      const char* const data=&pending_[0];
+      const char* const next=on_bytes(data,data+pending_.size());
+      pending_.erase(pending_.begin(),pending_.begin()+(next-data));
+    }
+
+    flush();
+    if(!closed_&&!going_away_)
+      async_read(buffer);
+  }
+
+  template <typename up_t,typename log_t>
+  const char* h2_session<up_t,log_t>::on_bytes(
+    const char* begin,
+    const char* end)
+  {
+    namespace h2=http::server::h2;
+
+    if(preface_left_)
+    {
+      const std::size_t n=(std::min)(preface_left_,
+        static_cast<std::size_t>(end-begin));
+      if(std::memcmp(begin,h2::preface+h2::preface_size-preface_left_,n))
+      {
+        connection_error(h2::protocol_error);
+        return end;
+      }
+      preface_left_-=n;
+      begin+=n;
+    }
+
+    while(!closed_&&!going_away_
+      &&static_cast<std::size_t>(end-begin)>=h2::frame_header_size)
+    {
+      const h2::frame_header h=h2::read_frame_header(begin);
+      if(h.length>h2::default_frame_size)
+      {
+        connection_error(h2::frame_size_error);
+        break;
+      }
+      if(static_cast<std::size_t>(end-begin)<h2::frame_header_size+h.length)
+        break;
+
+      on_frame(h,begin+h2::frame_header_size);
+      begin+=h2::frame_header_size+h.length;
+    }
+    return begin;
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::on_frame(
+    const http::server::h2::frame_header& h,
+    const char* payload)
+  {
+    namespace h2=http::server::h2;
+
+    // a header block is only followed by the rest of it
+    if(header_stream_
+      &&(h.type!=h2::continuation||h.stream_id!=header_stream_))
+    {
+      connection_error(h2::protocol_error);
+      return;
+    }
+
+    switch(h.type)
+    {
+    case h2::data:
+      on_data(h,payload);
+      break;
+    case h2::headers:
+      on_headers(h,payload);
+      break;
+    case h2::priority:
+      // streams are served in turn, priorities are ignored
+      if(!h.stream_id)
+        connection_error(h2::protocol_error);
+      else if(h.length!=5)
+        reset_stream(h.stream_id,h2::frame_size_error);
+      break;
+    case h2::rst_stream:
+    {
+      if(!h.stream_id||h.stream_id>last_stream_id_)
+      {
+        connection_error(h2::protocol_error);
+        break;
+      }
+      if(h.length!=4)
+      {
+        connection_error(h2::frame_size_error);
+        break;
+      }
+      auto it=streams_.find(h.stream_id);
+      if(it!=streams_.end())
+        close_stream(it->second,boost::asio::error::connection_reset);
+      break;
+    }
+    case h2::settings:
+      if(h.stream_id)
+        connection_error(h2::protocol_error);
+      else if(h.flags&h2::ack?h.length!=0:h.length%6!=0)
+        connection_error(h2::frame_size_error);
+      else if(!(h.flags&h2::ack)&&on_settings(payload,h.length))
+        h2::append_frame_header(0,h2::settings,h2::ack,0,control_);
+      break;
+    case h2::push_promise:
+      connection_error(h2::protocol_error);
+      break;
+    case h2::ping:
+      if(h.stream_id)
+        connection_error(h2::protocol_error);
+      else if(h.length!=8)
+        connection_error(h2::frame_size_error);
+      else if(!(h.flags&h2::ack))
+      {
+        h2::append_frame_header(8,h2::ping,h2::ack,0,control_);
+        control_.append(payload,8);
+      }
+      break;
+    case h2::goaway:
+      if(h.stream_id)
+        connection_error(h2::protocol_error);
+      else // the streams open are answered, then the connection closed
+        peer_going_away_=true;
+      break;
+    case h2::window_update:
+      on_window_update(h,payload);
+      break;
+    case h2::continuation:
+      if(!header_stream_)
+      {
+        connection_error(h2::protocol_error);
+        break;
+      }
+      header_block_.append(payload,h.length);
+      if(header_block_.size()>h2::header_list_limit)
+        connection_error(h2::enhance_your_calm);
+      else if(h.flags&h2::end_headers)
+      {
+        const boost::uint32_t stream_id=header_stream_;
+        header_stream_=0;
+        on_header_block(stream_id,header_end_stream_);
+      }
+      break;
+    default:
+      // unknown frames are ignored
+      break;
+    }
+  }
+
+  template <typename up_t,typename log_t>
+  bool h2_session<up_t,log_t>::unpad(
+    const http::server::h2::frame_header& h,
+    const char*& payload,
+    std::size_t& size)
+  {
+    size=h.length;
+    if(!(h.flags&http::server::h2::padded))
+      return true;
+    if(!size)
+      return false;
+    const std::size_t padding=static_cast<unsigned char>(*payload);
+    if(padding>=size)
+      return false;
+    ++payload;
+    size-=1+padding;
+    return true;
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::on_data(
+    const http::server::h2::frame_header& h,
+    const char* payload)
+  {
+    namespace h2=http::server::h2;
+    using namespace http::server;
+
+    std::size_t size;
+    if(!h.stream_id||!unpad(h,payload,size))
+    {
+      connection_error(h2::protocol_error);
+      return;
+    }
+
+    // the window of the connection is given back whatever the stream,
+    // the padding included, once half of it is used
+    unacked_+=h.length;
+    if(unacked_>=h2::default_window_size/2)
+    {
+      send_window_update(0,unacked_);
+      unacked_=0;
+    }
+
+    auto it=streams_.find(h.stream_id);
+    if(it==streams_.end())
+    { // a stream reset meanwhile
+      if(h.stream_id>last_stream_id_)
+        connection_error(h2::protocol_error);
+      return;
+    }
+    const stream_ptr s=it->second;
+    if(s->end_remote)
+    {
+      reset_stream(s->id,h2::stream_closed);
+      close_stream(s,boost::asio::error::connection_reset);
+      return;
+    }
+
+    // the content of a request already answered is dropped
+    if(!s->responding)
+    {
+      s->body_size+=size;
+      if(s->body_size>cast_up()->max_body_size())
+        refuse(s,reply::payload_too_large);
+      else if(size)
+        cast_up()->on_body_chunk(s->request,payload,size);
+    }
+
+    if(h.flags&h2::end_stream)
+    {
+      s->end_remote=true;
+      s->reset_after=false;
+      if(!s->responding)
+        respond(s);
+      return;
+    }
+
+    s->unacked+=h.length;
+    if(s->unacked>=h2::default_window_size/2)
+    {
+      send_window_update(s->id,s->unacked);
+      s->unacked=0;
+    }
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::on_headers(
+    const http::server::h2::frame_header& h,
+    const char* payload)
+  {
+    namespace h2=http::server::h2;
+
+    std::size_t size;
+    if(!h.stream_id||!unpad(h,payload,size))
+    {
+      connection_error(h2::protocol_error);
+      return;
+    }
+    if(h.flags&h2::priority_flag)
+    {
+      if(size<5)
+      {
+        connection_error(h2::protocol_error);
+        return;
+      }
+      payload+=5;
+      size-=5;
+    }
+
+    // a new stream, opened by the client, or the trailers of an open one
+    auto it=streams_.find(h.stream_id);
+    if(it==streams_.end())
+    {
+      if(h.stream_id<=last_stream_id_||!(h.stream_id&1))
+      {
+        connection_error(h2::protocol_error);
+        return;
+      }
+      last_stream_id_=h.stream_id;
+    }
+    else if(it->second->end_remote)
+    {
+      connection_error(h2::stream_closed);
+      return;
+    }
+
+    header_block_.assign(payload,size);
+    if(h.flags&h2::end_headers)
+      on_header_block(h.stream_id,(h.flags&h2::end_stream)!=0);
+    else
+    {
+      header_stream_=h.stream_id;
+      header_end_stream_=(h.flags&h2::end_stream)!=0;
+    }
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::on_header_block(
+    boost::uint32_t stream_id,
+    bool end_stream)
+  {
+    namespace h2=http::server::h2;
+    using namespace http::server;
+
+    // decoded whatever becomes of the stream, to keep the table in sync
+    fields_.clear();
+    if(!decoder_.decode(header_block_.data(),
+      header_block_.data()+header_block_.size(),fields_,h2::header_list_limit))
+    {
+      connection_error(h2::compression_error);
+      return;
+    }
+
+    auto it=streams_.find(stream_id);
+    if(it!=streams_.end())
+    { // trailers, ignored, end the request
+      const stream_ptr s=it->second;
+      if(!end_stream)
+      {
+        reset_stream(stream_id,h2::protocol_error);
+        close_stream(s,boost::asio::error::connection_reset);
+        return;
+      }
+      s->end_remote=true;
+      s->reset_after=false;
+      if(!s->responding)
+        respond(s);
+      return;
+    }
+
+    if(streams_.size()>=cast_up()->max_concurrent_streams())
+    {
+      reset_stream(stream_id,h2::refused_stream);
+      return;
+    }
+
+    stream_ptr s=boost::make_shared<stream>();
+    s->id=stream_id;
+    s->body_size=0;
+    s->end_remote=end_stream;
+    s->unacked=0;
+    s->window=initial_window_;
+    s->end_local=false;
+    s->reset_after=false;
+    s->responding=false;
+    s->queued=false;
+    s->closed=false;
+    s->file_at=0;
+    s->file_reading=false;
+
+    // pseudo-header fields first, names in lowercase, nothing specific
+    // to a connection
+    request& req=s->request;
+    req.http_version_major=2;
+    req.http_version_minor=0;
+    std::string authority;
+    bool regular=false;
+    bool malformed=false;
+    for(auto& f:fields_)
+    {
+      if(!f.name.empty()&&f.name[0]==':')
+      {
+        if(regular)
+          malformed=true;
+        else if(f.name==":method")
+          req.method.swap(f.value);
+        else if(f.name==":path")
+          req.uri.swap(f.value);
+        else if(f.name==":authority")
+          authority.swap(f.value);
+        else if(f.name!=":scheme")
+          malformed=true;
+        continue;
+      }
+      regular=true;
+      for(std::size_t i=0;i<f.name.size();++i)
+        if(f.name[i]>='A'&&f.name[i]<='Z')
+          malformed=true;
+      if(f.name=="connection"||f.name=="keep-alive"
+        ||f.name=="proxy-connection"||f.name=="transfer-encoding"
+        ||f.name=="upgrade"||(f.name=="te"&&f.value!="trailers"))
+        malformed=true;
+      req.headers.push_back(header());
+      req.headers.back().name.swap(f.name);
+      req.headers.back().value.swap(f.value);
+    }
+    if(malformed||req.method.empty()||req.uri.empty())
+    {
+      reset_stream(stream_id,h2::protocol_error);
+      return;
+    }
+
+    // handlers written for HTTP/1.1 find the Host header they expect
+    if(!authority.empty())
+    {
+      bool has_host=false;
+      for(auto& h:req.headers)
+        has_host=has_host||h.name=="host";
+      if(!has_host)
+      {
+        req.headers.push_back(header());
+        req.headers.back().name="host";
+        req.headers.back().value.swap(authority);
+      }
+    }
+
+    streams_[stream_id]=s;
+    if(end_stream)
+    {
+      respond(s);
+      return;
+    }
+
+    // a body known to be too large is refused up front
+    for(auto& h:req.headers)
+      if(h.name=="content-length"&&!h.value.empty()&&h.value.size()<20)
+      {
+        boost::uint64_t length=0;
+        bool digits=true;
+        for(std::size_t i=0;i<h.value.size();++i)
+          if(h.value[i]<'0'||h.value[i]>'9')
+            digits=false;
+          else
+            length=length*10+(h.value[i]-'0');
+        if(digits&&length>cast_up()->max_body_size())
+          refuse(s,reply::payload_too_large);
+      }
+  }
+
+  template <typename up_t,typename log_t>
+  bool h2_session<up_t,log_t>::on_settings(
+    const char* payload,
+    std::size_t size)
+  {
+    namespace h2=http::server::h2;
+
+    for(std::size_t i=0;i+6<=size;i+=6)
+    {
+      const unsigned id=(static_cast<unsigned char>(payload[i])<<8)
+        |static_cast<unsigned char>(payload[i+1]);
+      const boost::uint32_t value=h2::read_uint32(payload+i+2);
+      switch(id)
+      {
+      case h2::header_table_size:
+        encoder_.set_max_table_size(value);
+        break;
+      case h2::enable_push:
+        if(value>1)
+        {
+          connection_error(h2::protocol_error);
+          return false;
+        }
+        break;
+      case h2::initial_window_size:
+      {
+        if(value>h2::max_window_size)
+        {
+          connection_error(h2::flow_control_error);
+          return false;
+        }
+        // the windows of the open streams move along
+        const boost::int64_t delta=value-initial_window_;
+        initial_window_=value;
+        for(auto& it:streams_)
+        {
+          const stream_ptr& s=it.second;
+          s->window+=delta;
+          if(s->window>h2::max_window_size)
+          {
+            connection_error(h2::flow_control_error);
+            return false;
+          }
+          if(s->window>0&&!s->out.empty())
+            schedule(s);
+        }
+        break;
+      }
+      case h2::max_frame_size:
+        if(value<h2::default_frame_size||value>0xffffff)
+        {
+          connection_error(h2::protocol_error);
+          return false;
+        }
+        max_frame_size_=value;
+        break;
+      default:
+        // the other settings don't bind a server, unknown ones are
+        // ignored
+        break;
+      }
+    }
+    return true;
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::on_window_update(
+    const http::server::h2::frame_header& h,
+    const char* payload)
+  {
+    namespace h2=http::server::h2;
+
+    if(h.length!=4)
+    {
+      connection_error(h2::frame_size_error);
+      return;
+    }
+    const boost::uint32_t increment=h2::read_uint32(payload)&0x7fffffff;
+
+    if(!h.stream_id)
+    {
+      window_+=increment;
+      if(!increment)
+        connection_error(h2::protocol_error);
+      else if(window_>h2::max_window_size)
+        connection_error(h2::flow_control_error);
+      return;
+    }
+
+    auto it=streams_.find(h.stream_id);
+    if(it==streams_.end())
+    {
+      if(h.stream_id>last_stream_id_)
+        connection_error(h2::protocol_error);
+      return;
+    }
+    const stream_ptr s=it->second;
+    s->window+=increment;
+    if(!increment||s->window>h2::max_window_size)
+    {
+      reset_stream(s->id,increment?h2::flow_control_error:h2::protocol_error);
+      close_stream(s,boost::asio::error::connection_reset);
+      return;
+    }
+    if(s->window>0&&(!s->out.empty()||s->end_local))
+      schedule(s);
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::respond(const stream_ptr& s)
+  {
+    using namespace http::server;
+
+    s->responding=true;
+    if(!router_)
+      request_handler_->handle_request(s->request,s->reply);
+    else if(!router_->route(s->request,s->reply))
+      s->reply=reply::stock_reply(reply::not_found);
+    send_reply(s);
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::refuse(
+    const stream_ptr& s,
+    http::server::reply::status_type status)
+  {
+    s->responding=true;
+    s->reset_after=true;
+    s->reply=http::server::reply::stock_reply(status);
+    send_reply(s);
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::send_reply(const stream_ptr& s)
+  {
+    using namespace http::server;
+
+    reply& rep=s->reply;
+
+    // the status line of a shared header block is the one sent
+    unsigned status=rep.status;
+    if(rep.shared&&rep.shared->head.size()>12)
+      status=(rep.shared->head[9]-'0')*100+(rep.shared->head[10]-'0')*10
+        +(rep.shared->head[11]-'0');
+
+    block_.clear();
+    encoder_.begin_block(block_);
+    name_=":status";
+    encoder_.encode(name_,size_string(status),block_);
+
+    if(rep.shared)
+    { // the header lines of the block, after its status line
+      const std::string& head=rep.shared->head;
+      std::size_t line=head.find("\r\n");
+      while(line!=std::string::npos&&line+2<head.size())
+      {
+        line+=2;
+        const std::size_t line_end=head.find("\r\n",line);
+        const std::size_t colon=head.find(':',line);
+        if(line_end==std::string::npos||colon>line_end)
+          break;
+        std::size_t value=colon+1;
+        while(value<line_end&&head[value]==' ')
+          ++value;
+        value_.assign(head,value,line_end-value);
+        encode_field(head.data()+line,colon-line,value_);
+        line=line_end;
+      }
+    }
+
+    date_.clear();
+    date_cache::append(date_);
+    value_.assign(date_,6,date_.size()-8);
+    encode_field("date",4,value_);
+
+    for(auto& h:rep.headers)
+      encode_field(h.name.data(),h.name.size(),h.value);
+
+    // a segment of the body for each part of it in memory or on disk
+    const bool body=s->request.method!="HEAD"&&status>=200
+      &&status!=reply::no_content&&status!=reply::not_modified;
+    segment seg;
+    seg.offset=0;
+    auto add_memory=[&](const std::string& data)
+    {
+      seg.data=data.data();
+      seg.size=data.size();
+      if(seg.size)
+        s->out.push_back(seg);
+    };
+    auto add_file=[&](boost::uint64_t first,boost::uint64_t size)
+    {
+      seg.data=0;
+      seg.file=rep.file;
+      seg.offset=first;
+      seg.size=static_cast<std::size_t>(size);
+      if(seg.size)
+        s->out.push_back(seg);
+      seg.file.reset();
+      seg.offset=0;
+    };
+    if(!body)
+      ;
+    else if(rep.shared)
+      add_memory(rep.shared->content);
+    else if(rep.file&&rep.ranges.empty())
+      add_file(0,rep.file->size());
+    else if(rep.file)
+    {
+      for(auto& range:rep.ranges)
+      {
+        add_memory(range.head);
+        add_file(range.first,range.size);
+      }
+      add_memory(rep.ranges_tail);
+    }
+    else if(!rep.stream)
+      add_memory(rep.content);
+
+    const bool streamed=body&&rep.stream;
+    const bool end_stream=!streamed&&s->out.empty();
+    send_header_block(s->id,block_,end_stream);
+
+    if(end_stream)
+    {
+      if(s->reset_after)
+        reset_stream(s->id,http::server::h2::no_error);
+      close_stream(s,boost::system::error_code());
+    }
+    else if(streamed)
+      rep.stream(boost::make_shared<stream_writer>(shared_from_this(),s));
+    else
+    {
+      s->end_local=true;
+      schedule(s);
+    }
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::encode_field(
+    const char* name,
+    std::size_t name_size,
+    const std::string& value)
+  {
+    name_.assign(name,name_size);
+    for(std::size_t i=0;i<name_.size();++i)
+      if(name_[i]>='A'&&name_[i]<='Z')
+        name_[i]+='a'-'A';
+
+    if(name_=="connection"||name_=="keep-alive"||name_=="proxy-connection"
+      ||name_=="transfer-encoding"||name_=="upgrade")
+      return;
+    encoder_.encode(name_,value,block_);
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::send_header_block(
+    boost::uint32_t stream_id,
+    const std::string& block,
+    bool end_stream)
+  {
+    namespace h2=http::server::h2;
+
+    // a HEADERS frame, then CONTINUATION ones
+    std::size_t offset=0;
+    do
+    {
+      const std::size_t size=(std::min)(block.size()-offset,max_frame_size_);
+      const bool last=offset+size==block.size();
+      boost::uint8_t flags=last?h2::end_headers:0;
+      if(!offset&&end_stream)
+        flags|=h2::end_stream;
+      h2::append_frame_header(size,offset?h2::continuation:h2::headers,
+        flags,stream_id,control_);
+      control_.append(block,offset,size);
+      offset+=size;
+    }
+    while(offset<block.size());
+  }
+
+  template <typename up_t,typename log_t>
+  class h2_session<up_t,log_t>::stream_writer
+    :public http::server::chunk_writer
+  {
+  public:
+    stream_writer(const boost::shared_ptr<up_t>& session
+      ,const stream_ptr& s)
+      :session_(session)
+      ,stream_(s)
+      ,closed_(false)
+    {
+    }
+
+    ~stream_writer()
+    {
+      close();
+    }
+
+    void async_write(const boost::asio::const_buffer& data
+      ,const handler_type& handler)
+    {
+      if(closed_)
+      {
+        session_->get_strand().post(boost::bind(handler,
+          boost::system::error_code(boost::asio::error::operation_aborted)));
+        return;
+      }
+      session_->get_strand().dispatch(
+        boost::bind(&h2_session::write_chunk,session_,stream_,data,handler));
+    }
+
+    void close()
+    {
+      if(!closed_.exchange(true))
+        session_->get_strand().dispatch(
+          boost::bind(&h2_session::end_chunks,session_,stream_));
+    }
+
+  private:
+    boost::shared_ptr<up_t> session_;
+    stream_ptr stream_;
+    boost::atomic<bool> closed_;
+  };
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::write_chunk(
+    const stream_ptr& s,
+    boost::asio::const_buffer data,
+    http::server::chunk_writer::handler_type handler)
+  {
+    // an empty chunk has nothing to send, a reset stream nowhere to
+    const std::size_t size=boost::asio::buffer_size(data);
+    if(s->closed||!size)
+    {
+      const boost::system::error_code ec=s->closed
+        ?boost::asio::error::operation_aborted:boost::system::error_code();
+      get_strand().post(boost::bind(handler,ec));
+      return;
+    }
+
+    segment seg;
+    seg.data=boost::asio::buffer_cast<const char*>(data);
+    seg.offset=0;
+    seg.size=size;
+    seg.handler=handler;
+    s->out.push_back(seg);
+    schedule(s);
+    flush();
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::end_chunks(const stream_ptr& s)
+  {
+    if(s->closed)
+      return;
+    s->end_local=true;
+    schedule(s);
+    flush();
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::schedule(const stream_ptr& s)
+  {
+    if(s->queued||s->closed)
+      return;
+    s->queued=true;
+    ready_.push_back(s);
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::read_file(const stream_ptr& s)
+  {
+    if(s->file_reading)
+      return;
+    s->file_reading=true;
+
+    const segment& seg=s->out.front();
+    s->file_chunk.resize((std::min)(seg.size,cast_up()->data_batch_size()));
+    s->file_at=0;
+    get_io_service().post(boost::bind(&h2_session::do_read_file,
+      shared_from_this(),s,seg.file,seg.offset));
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::do_read_file(
+    const stream_ptr& s,
+    http::server::file_body_ptr file,
+    boost::uint64_t offset)
+  {
+    // any thread, the strand doesn't touch the chunk until on_file_read
+    const std::size_t size=file->read(offset,&s->file_chunk[0],
+      s->file_chunk.size());
+    get_strand().post(boost::bind(&h2_session::on_file_read,
+      shared_from_this(),s,size));
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::on_file_read(
+    const stream_ptr& s,
+    std::size_t size)
+  {
+    namespace h2=http::server::h2;
+
+    s->file_reading=false;
+    if(s->closed||closed_)
+      return;
+    if(size!=s->file_chunk.size())
+    { // file truncated since opened
+      s->file_chunk.clear();
+      reset_stream(s->id,h2::internal_error);
+      close_stream(s,boost::asio::error::eof);
+    }
+    else
+      schedule(s);
+    flush();
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::close_stream(
+    const stream_ptr& s,
+    const boost::system::error_code& ec)
+  {
+    if(s->closed)
+      return;
+    s->closed=true;
+    streams_.erase(s->id);
+
+    // a streamed body left unsent is given up
+    for(auto& seg:s->out)
+      if(seg.handler)
+        defer(seg.handler,ec?ec:boost::asio::error::operation_aborted);
+    s->out.clear();
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::reset_stream(
+    boost::uint32_t stream_id,
+    http::server::h2::error_code code)
+  {
+    namespace h2=http::server::h2;
+
+    h2::append_frame_header(4,h2::rst_stream,0,stream_id,control_);
+    h2::append_uint32(code,control_);
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::connection_error(
+    http::server::h2::error_code code)
+  {
+    namespace h2=http::server::h2;
+
+    if(going_away_)
+      return;
+    log_trace(EZ_FLFT,"GOAWAY");
+    going_away_=true;
+    h2::append_frame_header(8,h2::goaway,0,0,control_);
+    h2::append_uint32(last_stream_id_,control_);
+    h2::append_uint32(code,control_);
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::send_window_update(
+    boost::uint32_t stream_id,
+    boost::uint32_t increment)
+  {
+    namespace h2=http::server::h2;
+
+    h2::append_frame_header(4,h2::window_update,0,stream_id,control_);
+    h2::append_uint32(increment,control_);
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::flush()
+  {
+    namespace h2=http::server::h2;
+
+    if(writing_||closed_)
+      return;
+
+    // the control frames first, the DATA of the streams after their
+    // HEADERS queued there
+    out_.clear();
+    pieces_.clear();
+    if(!control_.empty())
+    {
+      out_.swap(control_);
+      add_piece(0,0,out_.size());
+    }
+
+    // a frame of each stream in turn, as long as the windows allow; after
+    // a 101 not before the client preface, a client switching protocols
+    // may not expect a whole reply right behind it
+    std::size_t budget=cast_up()->data_batch_size();
+    while(budget&&!ready_.empty()&&!going_away_&&!preface_left_)
+    {
+      const stream_ptr s=ready_.front();
+      if(!s->closed&&!s->out.empty()&&window_<=0)
+        break;
+      ready_.pop_front();
+      s->queued=false;
+      if(s->closed||(!s->out.empty()&&s->window<=0)
+        ||(s->out.empty()&&!s->end_local))
+        continue; // until a WINDOW_UPDATE, or the next chunk
+
+      std::size_t size=0;
+      if(!s->out.empty())
+        size=static_cast<std::size_t>((std::min)((std::min)(window_,s->window),
+          static_cast<boost::int64_t>((std::min)((std::min)(
+          s->out.front().size,max_frame_size_),budget))));
+      if(size&&s->out.front().file)
+      { // only what is read already, the disk isn't read on the strand
+        const std::size_t ready=s->file_chunk.size()-s->file_at;
+        if(!ready)
+        {
+          read_file(s);
+          continue;
+        }
+        size=(std::min)(size,ready);
+      }
+      const bool last=s->end_local&&(s->out.empty()
+        ||(s->out.size()==1&&size==s->out.front().size));
+
+      const std::size_t at=out_.size();
+      h2::append_frame_header(size,h2::data,last?h2::end_stream:0,s->id,out_);
+      if(size)
+      {
+        segment& seg=s->out.front();
+        if(seg.file)
+        { // copied from the chunk read, which is reused
+          out_.append(&s->file_chunk[s->file_at],size);
+          s->file_at+=size;
+          seg.offset+=size;
+          add_piece(0,at,h2::frame_header_size+size);
+        }
+        else
+        {
+          add_piece(0,at,h2::frame_header_size);
+          add_piece(seg.data,0,size);
+          seg.data+=size;
+          if(in_flight_.empty()||in_flight_.back()!=s)
+            in_flight_.push_back(s);
+        }
+
+        seg.size-=size;
+        window_-=size;
+        s->window-=size;
+        budget-=size;
+        if(!seg.size)
+        {
+          if(seg.handler)
+            written_.push_back(std::make_pair(seg.handler,
+              boost::system::error_code()));
+          s->out.pop_front();
+        }
+      }
+      else
+        add_piece(0,at,h2::frame_header_size);
+
+      if(last)
+      {
+        if(s->reset_after)
+        { // the rest of the request isn't wanted
+          const std::size_t rst=out_.size();
+          h2::append_frame_header(4,h2::rst_stream,0,s->id,out_);
+          h2::append_uint32(h2::no_error,out_);
+          add_piece(0,rst,out_.size()-rst);
+        }
+        close_stream(s,boost::system::error_code());
+      }
+      else
+        schedule(s);
+    }
+
+    if(pieces_.empty())
+    {
+      if(going_away_||(peer_going_away_&&streams_.empty()))
+        close(boost::system::error_code());
+      return;
+    }
+
+    buffers_.clear();
+    for(auto& p:pieces_)
+      buffers_.push_back(boost::asio::buffer(
+        p.data?p.data:out_.data()+p.offset,p.size));
+
+    writing_=true;
+    boost::asio::async_write(get_socket(),buffers_,
+      get_strand().wrap(
+      boost::bind(&h2_session::handle_write,shared_from_this(),
+      boost::asio::placeholders::error)));
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::add_piece(
+    const char* data,
+    std::size_t offset,
+    std::size_t size)
+  {
+    // bytes of out_ following one another make a single buffer
+    if(!data&&!pieces_.empty()&&!pieces_.back().data
+      &&pieces_.back().offset+pieces_.back().size==offset)
+    {
+      pieces_.back().size+=size;
+      return;
+    }
+    const piece p={data,offset,size};
+    pieces_.push_back(p);
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::defer(
+    const http::server::chunk_writer::handler_type& handler,
+    const boost::system::error_code& ec)
+  {
+    if(writing_)
+      written_.push_back(std::make_pair(handler,ec));
+    else
+      get_strand().post(boost::bind(handler,ec));
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::handle_write(const boost::system::error_code& e)
+  {
+    writing_=false;
+    in_flight_.clear();
+
+    // the handlers may write the next chunks at once
+    std::vector<std::pair<http::server::chunk_writer::handler_type
+      ,boost::system::error_code> > written;
+    written.swap(written_);
+
+    if(e)
+    {
+      log_trace(EZ_FLFT,e.message());
+      close(e);
+    }
+    for(auto& w:written)
+      w.first(e?e:w.second);
+
+    flush();
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::on_idle_timeout(const boost::system::error_code& e)
+  {
+    // canceled, or expired while the read was completing
+    if(e||closed_
+      ||idle_timer_.expires_at()>boost::asio::deadline_timer::traits_type::now())
+      return;
+
+    if(!streams_.empty())
+    { // replies still being sent
+      idle_timer_.expires_from_now(cast_up()->keep_alive_timeout());
+      idle_timer_.async_wait(get_strand().wrap(
+        boost::bind(&h2_session::on_idle_timeout,shared_from_this(),
+        boost::asio::placeholders::error)));
+      return;
+    }
+
+    log_trace(EZ_FLFT,"idle connection closed");
+    connection_error(http::server::h2::no_error);
+    flush();
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::close(const boost::system::error_code& ec)
+  {
+    if(closed_)
+      return;
+    closed_=true;
+
+    boost::system::error_code ignored_ec;
+    idle_timer_.cancel(ignored_ec);
+
+    const std::map<boost::uint32_t,stream_ptr> streams(streams_);
+    for(auto& it:streams)
+      close_stream(it.second,ec?ec:boost::asio::error::connection_aborted);
+    ready_.clear();
+
+    if(!ec)
+      get_socket().shutdown(boost::asio::ip::tcp::socket::shutdown_both,
+        ignored_ec);
+    get_socket().close(ignored_ec);
+  }
+
+  template <typename up_t,typename log_t>
+  boost::posix_time::time_duration h2_session<up_t,log_t>::keep_alive_timeout()
+  {
+    return boost::posix_time::seconds(60);
+  }
+
+  template <typename up_t,typename log_t>
+  unsigned h2_session<up_t,log_t>::max_concurrent_streams()
+  {
+    return 100;
+  }
+
+  template <typename up_t,typename log_t>
+  boost::uint64_t h2_session<up_t,log_t>::max_body_size()
+  {
+    return 1024*1024;
+  }
+
+  template <typename up_t,typename log_t>
+  void h2_session<up_t,log_t>::on_body_chunk(
+    const http::server::request& req,
+    const char* data,
+    std::size_t size)
+  {
+    // req is the request of one of the streams
+    const_cast<http::server::request&>(req).body.append(data,size);
+  }
+
+  template <typename up_t,typename log_t>
+  std::size_t h2_session<up_t,log_t>::data_batch_size()
+  {
+    return 64*1024;
+  }
+
+  template <typename up_t,typename log_t>
+  bool h2_session<up_t,log_t>::decode_base64url(
+    const std::string& in,
+    std::string& out)
+  {
+    unsigned bits=0;
+    int count=0;
+    for(std::size_t i=0;i<in.size();++i)
+    {
+      const char c=in[i];
+      unsigned value;
+      if(c>='A'&&c<='Z')
+        value=c-'A';
+      else if(c>='a'&&c<='z')
+        value=c-'a'+26;
+      else if(c>='0'&&c<='9')
+        value=c-'0'+52;
+      else if(c=='-')
+        value=62;
+      else if(c=='_')
+        value=63;
+      else if(c=='=')
+        break;
+      else
+        return false;
+
+      bits=(bits<<6)|value;
+      count+=6;
+      if(count>=8)
+      {
+        count-=8;
+        out+=static_cast<char>(bits>>count);
+        bits&=(1u<<count)-1;
+      }
+    }
+    return true;
+  }
+
+  template <typename up_t,typename log_t>
+  bool h2_session<up_t,log_t>::wants_h2c(const http::server::request& req)
+  {
+    using boost::algorithm::iequals;
+    using boost::algorithm::icontains;
+
+    if(req.http_version_major!=1||req.http_version_minor<1)
+      return false;
+
+    // the request is answered once upgraded, it may not have a body
+    bool upgrade=false;
+    bool settings=false;
+    for(auto& h:req.headers)
+      if(iequals(h.name,"Upgrade"))
+        upgrade=icontains(h.value,"h2c");
+      else if(iequals(h.name,"HTTP2-Settings"))
+        settings=true;
+      else if((iequals(h.name,"Content-Length")&&h.value!="0")
+        ||iequals(h.name,"Transfer-Encoding"))
+        return false;
+    return upgrade&&settings;
+  }
+
+} // namespace splice
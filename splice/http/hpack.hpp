@@ -0,0 +1,181 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef HTTP_HPACK_HPP
+#define HTTP_HPACK_HPP
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include "header.hpp"
+
+namespace http {
+namespace server {
+
+/// Default size of an HPACK dynamic table, SETTINGS_HEADER_TABLE_SIZE,
+/// also the most any encoder here uses.
+const std::size_t hpack_table_size = 4096;
+
+/// Decoder of HTTP/2 header blocks, RFC 7541. One per connection, the
+/// dynamic table lasting from block to block.
+class hpack_decoder
+{
+public:
+  /// Construct with a dynamic table of at most max_table_size bytes, the
+  /// SETTINGS_HEADER_TABLE_SIZE advertised to the peer.
+  explicit hpack_decoder(std::size_t max_table_size = hpack_table_size);
+
+  /// Decode a whole header block, appending its fields to headers. Returns
+  /// false on a compression error, the connection is to be closed, or when
+  /// the fields take more than max_list_size bytes, as counted by
+  /// SETTINGS_MAX_HEADER_LIST_SIZE.
+  bool decode(const char* begin, const char* end,
+      std::vector<header>& headers, std::size_t max_list_size);
+
+private:
+  /// Decode an integer whose first byte keeps prefix bits.
+  static bool decode_integer(const unsigned char*& p,
+      const unsigned char* end, int prefix, std::size_t& value);
+
+  /// Decode a string literal, Huffman coded or not.
+  static bool decode_string(const unsigned char*& p,
+      const unsigned char* end, std::string& value);
+
+  /// The name of an entry of the static or the dynamic table, and its
+  /// value unless name_only.
+  bool lookup(std::size_t index, header& h, bool name_only) const;
+
+  /// Add an entry to the dynamic table, evicting the oldest ones.
+  void insert(const header& h);
+
+  /// Evict the oldest entries until the table takes at most size bytes.
+  void evict(std::size_t size);
+
+  /// Entries, newest first, bytes they take as counted by HPACK, and at
+  /// most, lowered by the encoder up to settings_size_.
+  std::deque<header> table_;
+  std::size_t size_;
+  std::size_t max_size_;
+  std::size_t settings_size_;
+};
+
+/// Encoder of HTTP/2 header blocks, RFC 7541. Fields the peer sees again
+/// and again, as the content type of the replies of a polling API, are
+/// indexed and end up taking a byte or two.
+class hpack_encoder
+{
+public:
+  hpack_encoder();
+
+  /// The SETTINGS_HEADER_TABLE_SIZE of the peer, the table being limited
+  /// to hpack_table_size anyway.
+  void set_max_table_size(std::size_t size);
+
+  /// Start a header block, telling the peer about a change of the table
+  /// size, if any.
+  void begin_block(std::string& out);
+
+  /// Append a field, whose name is in lowercase. Credentials are never
+  /// indexed, sizes that change from reply to reply aren't either.
+  void encode(const std::string& name, const std::string& value,
+      std::string& out);
+
+  /// Append an integer whose first byte keeps prefix bits, the others
+  /// being the ones of first.
+  static void encode_integer(std::size_t value, int prefix,
+      unsigned char first, std::string& out);
+
+  /// Append a string literal, Huffman coded when it is shorter so.
+  static void encode_string(const std::string& value, std::string& out);
+
+private:
+  /// Add an entry to the dynamic table, evicting the oldest ones.
+  void insert(const std::string& name, const std::string& value);
+
+  /// Evict the oldest entries until the table takes at most size bytes.
+  void evict(std::size_t size);
+
+  /// Entries, newest first, bytes they take as counted by HPACK, and at
+  /// most.
+  std::deque<header> table_;
+  std::size_t size_;
+  std::size_t max_size_;
+
+  /// A change of max_size_ to tell in the next block, along with the
+  /// smallest size it went through meanwhile.
+  bool update_pending_;
+  std::size_t update_min_;
+};
+
+/// The Huffman code of HPACK, RFC 7541 appendix B.
+class hpack_huffman
+{
+public:
+  /// Bytes value takes once coded.
+  static std::size_t encoded_size(const std::string& value);
+
+  /// Append the code of value.
+  static void encode(const std::string& value, std::string& out);
+
+  /// Append the decoded [begin,end), false when it isn't a valid code.
+  static bool decode(const unsigned char* begin, const unsigned char* end,
+      std::string& out);
+
+private:
+  struct code
+  {
+    boost::uint32_t bits;
+    boost::uint8_t size;
+  };
+
+  /// Code of each byte, and of the end of string.
+  static const code codes_[257];
+
+  /// A decoder state and the 4 bits read from it lead to the next state,
+  /// maybe through a decoded byte. Flags of a transition.
+  enum
+  {
+    emit = 1,
+    fail = 2,
+    accept = 4
+  };
+
+  struct transition
+  {
+    boost::uint8_t state;
+    boost::uint8_t flags;
+    boost::uint8_t symbol;
+  };
+
+  /// The transitions of the 256 states, one per inner node of the code
+  /// tree, built from codes_ at startup.
+  struct decode_table
+  {
+    decode_table();
+    transition next[256][16];
+  };
+
+  static const decode_table decode_table_;
+};
+
+} // namespace server
+} // namespace http
+
+#if defined(SPLICE_HEADER_ONLY)
+# include "hpack.hxx"
+#endif
+
+#endif // HTTP_HPACK_HPP
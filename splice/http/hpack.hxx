@@ -0,0 +1,566 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include "hpack.hpp"
+#include <algorithm>
+#include <vector>
+#include <boost/array.hpp>
+
+namespace http {
+namespace server {
+
+namespace detail {
+
+struct hpack_static_entry
+{
+  const char* name;
+  const char* value;
+};
+
+/// The static table, RFC 7541 appendix A, index 1 first.
+const hpack_static_entry hpack_static_table[] =
+{
+  { ":authority", "" },
+  { ":method", "GET" },
+  { ":method", "POST" },
+  { ":path", "/" },
+  { ":path", "/index.html" },
+  { ":scheme", "http" },
+  { ":scheme", "https" },
+  { ":status", "200" },
+  { ":status", "204" },
+  { ":status", "206" },
+  { ":status", "304" },
+  { ":status", "400" },
+  { ":status", "404" },
+  { ":status", "500" },
+  { "accept-charset", "" },
+  { "accept-encoding", "gzip, deflate" },
+  { "accept-language", "" },
+  { "accept-ranges", "" },
+  { "accept", "" },
+  { "access-control-allow-origin", "" },
+  { "age", "" },
+  { "allow", "" },
+  { "authorization", "" },
+  { "cache-control", "" },
+  { "content-disposition", "" },
+  { "content-encoding", "" },
+  { "content-language", "" },
+  { "content-length", "" },
+  { "content-location", "" },
+  { "content-range", "" },
+  { "content-type", "" },
+  { "cookie", "" },
+  { "date", "" },
+  { "etag", "" },
+  { "expect", "" },
+  { "expires", "" },
+  { "from", "" },
+  { "host", "" },
+  { "if-match", "" },
+  { "if-modified-since", "" },
+  { "if-none-match", "" },
+  { "if-range", "" },
+  { "if-unmodified-since", "" },
+  { "last-modified", "" },
+  { "link", "" },
+  { "location", "" },
+  { "max-forwards", "" },
+  { "proxy-authenticate", "" },
+  { "proxy-authorization", "" },
+  { "range", "" },
+  { "referer", "" },
+  { "refresh", "" },
+  { "retry-after", "" },
+  { "server", "" },
+  { "set-cookie", "" },
+  { "strict-transport-security", "" },
+  { "transfer-encoding", "" },
+  { "user-agent", "" },
+  { "vary", "" },
+  { "via", "" },
+  { "www-authenticate", "" }
+};
+
+const std::size_t hpack_static_size =
+  sizeof(hpack_static_table) / sizeof(hpack_static_table[0]);
+
+/// Bytes an entry takes in a dynamic table.
+inline std::size_t hpack_entry_size(const std::string& name,
+    const std::string& value)
+{
+  return name.size() + value.size() + 32;
+}
+
+} // namespace detail
+
+hpack_decoder::hpack_decoder(std::size_t max_table_size)
+  : size_(0)
+  , max_size_(max_table_size)
+  , settings_size_(max_table_size)
+{
+}
+
+bool hpack_decoder::decode(const char* begin, const char* end,
+    std::vector<header>& headers, std::size_t max_list_size)
+{
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(begin);
+  const unsigned char* const e = reinterpret_cast<const unsigned char*>(end);
+  std::size_t list_size = 0;
+  bool fields = false;
+
+  while (p != e)
+  {
+    const unsigned char c = *p;
+    std::size_t index = 0;
+    header h;
+
+    if (c & 0x80)
+    { // indexed field
+      if (!decode_integer(p, e, 7, index) || !lookup(index, h, false))
+        return false;
+    }
+    else if ((c & 0xe0) == 0x20)
+    { // table size update, only before the first field
+      if (fields || !decode_integer(p, e, 5, index)
+          || index > settings_size_)
+        return false;
+      max_size_ = index;
+      evict(max_size_);
+      continue;
+    }
+    else
+    { // literal field, added to the table, not, or never
+      const bool indexing = (c & 0x40) != 0;
+      if (!decode_integer(p, e, indexing ? 6 : 4, index))
+        return false;
+      if (index ? !lookup(index, h, true) : !decode_string(p, e, h.name))
+        return false;
+      if (!decode_string(p, e, h.value))
+        return false;
+      if (indexing)
+        insert(h);
+    }
+
+    fields = true;
+    list_size += detail::hpack_entry_size(h.name, h.value);
+    if (list_size > max_list_size)
+      return false;
+    headers.push_back(header());
+    headers.back().name.swap(h.name);
+    headers.back().value.swap(h.value);
+  }
+  return true;
+}
+
+bool hpack_decoder::decode_integer(const unsigned char*& p,
+    const unsigned char* end, int prefix, std::size_t& value)
+{
+  const std::size_t mask = (1u << prefix) - 1;
+  value = *p++ & mask;
+  if (value < mask)
+    return true;
+
+  // no field nor table is that large, longer integers are rejected
+  for (int shift = 0; p != end && shift <= 21; shift += 7)
+  {
+    const unsigned char b = *p++;
+    value += static_cast<std::size_t>(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      return true;
+  }
+  return false;
+}
+
+bool hpack_decoder::decode_string(const unsigned char*& p,
+    const unsigned char* end, std::string& value)
+{
+  if (p == end)
+    return false;
+  const bool huffman = (*p & 0x80) != 0;
+  std::size_t size = 0;
+  if (!decode_integer(p, end, 7, size)
+      || size > static_cast<std::size_t>(end - p))
+    return false;
+
+  const unsigned char* const begin = p;
+  p += size;
+  if (huffman)
+    return hpack_huffman::decode(begin, p, value);
+  value.assign(reinterpret_cast<const char*>(begin), size);
+  return true;
+}
+
+bool hpack_decoder::lookup(std::size_t index, header& h,
+    bool name_only) const
+{
+  if (!index)
+    return false;
+  if (index <= detail::hpack_static_size)
+  {
+    const detail::hpack_static_entry& entry =
+      detail::hpack_static_table[index - 1];
+    h.name = entry.name;
+    if (!name_only)
+      h.value = entry.value;
+    return true;
+  }
+
+  index -= detail::hpack_static_size + 1;
+  if (index >= table_.size())
+    return false;
+  h.name = table_[index].name;
+  if (!name_only)
+    h.value = table_[index].value;
+  return true;
+}
+
+void hpack_decoder::insert(const header& h)
+{
+  // an entry larger than the table empties it
+  const std::size_t size = detail::hpack_entry_size(h.name, h.value);
+  evict(size <= max_size_ ? max_size_ - size : 0);
+  if (size > max_size_)
+    return;
+  table_.push_front(h);
+  size_ += size;
+}
+
+void hpack_decoder::evict(std::size_t size)
+{
+  while (size_ > size)
+  {
+    size_ -= detail::hpack_entry_size(table_.back().name,
+        table_.back().value);
+    table_.pop_back();
+  }
+}
+
+hpack_encoder::hpack_encoder()
+  : size_(0)
+  , max_size_(hpack_table_size)
+  , update_pending_(false)
+  , update_min_(hpack_table_size)
+{
+}
+
+void hpack_encoder::set_max_table_size(std::size_t size)
+{
+  size = (std::min)(size, hpack_table_size);
+  if (size == max_size_)
+    return;
+  max_size_ = size;
+  evict(max_size_);
+  update_min_ = update_pending_ ? (std::min)(update_min_, size) : size;
+  update_pending_ = true;
+}
+
+void hpack_encoder::begin_block(std::string& out)
+{
+  if (!update_pending_)
+    return;
+  // the smallest size first, for the decoder to evict what the encoder did
+  if (update_min_ < max_size_)
+    encode_integer(update_min_, 5, 0x20, out);
+  encode_integer(max_size_, 5, 0x20, out);
+  update_pending_ = false;
+}
+
+void hpack_encoder::encode(const std::string& name, const std::string& value,
+    std::string& out)
+{
+  using namespace detail;
+
+  // the first character rules out most of the static table at once
+  std::size_t name_index = 0;
+  const char first = name.empty() ? 0 : name[0];
+  for (std::size_t i = 0; i < hpack_static_size; ++i)
+    if (hpack_static_table[i].name[0] == first
+        && name == hpack_static_table[i].name)
+    {
+      if (value == hpack_static_table[i].value)
+      {
+        encode_integer(i + 1, 7, 0x80, out);
+        return;
+      }
+      if (!name_index)
+        name_index = i + 1;
+    }
+  for (std::size_t i = 0; i < table_.size(); ++i)
+    if (table_[i].name == name)
+    {
+      if (table_[i].value == value)
+      {
+        encode_integer(hpack_static_size + 1 + i, 7, 0x80, out);
+        return;
+      }
+      if (!name_index)
+        name_index = hpack_static_size + 1 + i;
+    }
+
+  const bool never = name == "authorization" || name == "cookie"
+    || name == "set-cookie" || name == "proxy-authorization";
+  const bool indexing = !never && name != "content-length"
+    && name != "content-range"
+    && hpack_entry_size(name, value) <= max_size_;
+
+  if (indexing)
+    encode_integer(name_index, 6, 0x40, out);
+  else
+    encode_integer(name_index, 4, never ? 0x10 : 0x00, out);
+  if (!name_index)
+    encode_string(name, out);
+  encode_string(value, out);
+
+  if (indexing)
+    insert(name, value);
+}
+
+void hpack_encoder::encode_integer(std::size_t value, int prefix,
+    unsigned char first, std::string& out)
+{
+  const std::size_t mask = (1u << prefix) - 1;
+  if (value < mask)
+  {
+    out += static_cast<char>(first | value);
+    return;
+  }
+  out += static_cast<char>(first | mask);
+  value -= mask;
+  while (value >= 0x80)
+  {
+    out += static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char>(value);
+}
+
+void hpack_encoder::encode_string(const std::string& value, std::string& out)
+{
+  const std::size_t size = hpack_huffman::encoded_size(value);
+  if (size < value.size())
+  {
+    encode_integer(size, 7, 0x80, out);
+    hpack_huffman::encode(value, out);
+  }
+  else
+  {
+    encode_integer(value.size(), 7, 0x00, out);
+    out += value;
+  }
+}
+
+void hpack_encoder::insert(const std::string& name, const std::string& value)
+{
+  const std::size_t size = detail::hpack_entry_size(name, value);
+  evict(max_size_ - size);
+  table_.push_front(header());
+  table_.front().name = name;
+  table_.front().value = value;
+  size_ += size;
+}
+
+void hpack_encoder::evict(std::size_t size)
+{
+  while (size_ > size)
+  {
+    size_ -= detail::hpack_entry_size(table_.back().name,
+        table_.back().value);
+    table_.pop_back();
+  }
+}
+
+const hpack_huffman::code hpack_huffman::codes_[257] =
+{
+  { 0x00001ff8, 13 }, { 0x007fffd8, 23 }, { 0x0fffffe2, 28 }, { 0x0fffffe3, 28 },
+  { 0x0fffffe4, 28 }, { 0x0fffffe5, 28 }, { 0x0fffffe6, 28 }, { 0x0fffffe7, 28 },
+  { 0x0fffffe8, 28 }, { 0x00ffffea, 24 }, { 0x3ffffffc, 30 }, { 0x0fffffe9, 28 },
+  { 0x0fffffea, 28 }, { 0x3ffffffd, 30 }, { 0x0fffffeb, 28 }, { 0x0fffffec, 28 },
+  { 0x0fffffed, 28 }, { 0x0fffffee, 28 }, { 0x0fffffef, 28 }, { 0x0ffffff0, 28 },
+  { 0x0ffffff1, 28 }, { 0x0ffffff2, 28 }, { 0x3ffffffe, 30 }, { 0x0ffffff3, 28 },
+  { 0x0ffffff4, 28 }, { 0x0ffffff5, 28 }, { 0x0ffffff6, 28 }, { 0x0ffffff7, 28 },
+  { 0x0ffffff8, 28 }, { 0x0ffffff9, 28 }, { 0x0ffffffa, 28 }, { 0x0ffffffb, 28 },
+  { 0x00000014,  6 }, { 0x000003f8, 10 }, { 0x000003f9, 10 }, { 0x00000ffa, 12 },
+  { 0x00001ff9, 13 }, { 0x00000015,  6 }, { 0x000000f8,  8 }, { 0x000007fa, 11 },
+  { 0x000003fa, 10 }, { 0x000003fb, 10 }, { 0x000000f9,  8 }, { 0x000007fb, 11 },
+  { 0x000000fa,  8 }, { 0x00000016,  6 }, { 0x00000017,  6 }, { 0x00000018,  6 },
+  { 0x00000000,  5 }, { 0x00000001,  5 }, { 0x00000002,  5 }, { 0x00000019,  6 },
+  { 0x0000001a,  6 }, { 0x0000001b,  6 }, { 0x0000001c,  6 }, { 0x0000001d,  6 },
+  { 0x0000001e,  6 }, { 0x0000001f,  6 }, { 0x0000005c,  7 }, { 0x000000fb,  8 },
+  { 0x00007ffc, 15 }, { 0x00000020,  6 }, { 0x00000ffb, 12 }, { 0x000003fc, 10 },
+  { 0x00001ffa, 13 }, { 0x00000021,  6 }, { 0x0000005d,  7 }, { 0x0000005e,  7 },
+  { 0x0000005f,  7 }, { 0x00000060,  7 }, { 0x00000061,  7 }, { 0x00000062,  7 },
+  { 0x00000063,  7 }, { 0x00000064,  7 }, { 0x00000065,  7 }, { 0x00000066,  7 },
+  { 0x00000067,  7 }, { 0x00000068,  7 }, { 0x00000069,  7 }, { 0x0000006a,  7 },
+  { 0x0000006b,  7 }, { 0x0000006c,  7 }, { 0x0000006d,  7 }, { 0x0000006e,  7 },
+  { 0x0000006f,  7 }, { 0x00000070,  7 }, { 0x00000071,  7 }, { 0x00000072,  7 },
+  { 0x000000fc,  8 }, { 0x00000073,  7 }, { 0x000000fd,  8 }, { 0x00001ffb, 13 },
+  { 0x0007fff0, 19 }, { 0x00001ffc, 13 }, { 0x00003ffc, 14 }, { 0x00000022,  6 },
+  { 0x00007ffd, 15 }, { 0x00000003,  5 }, { 0x00000023,  6 }, { 0x00000004,  5 },
+  { 0x00000024,  6 }, { 0x00000005,  5 }, { 0x00000025,  6 }, { 0x00000026,  6 },
+  { 0x00000027,  6 }, { 0x00000006,  5 }, { 0x00000074,  7 }, { 0x00000075,  7 },
+  { 0x00000028,  6 }, { 0x00000029,  6 }, { 0x0000002a,  6 }, { 0x00000007,  5 },
+  { 0x0000002b,  6 }, { 0x00000076,  7 }, { 0x0000002c,  6 }, { 0x00000008,  5 },
+  { 0x00000009,  5 }, { 0x0000002d,  6 }, { 0x00000077,  7 }, { 0x00000078,  7 },
+  { 0x00000079,  7 }, { 0x0000007a,  7 }, { 0x0000007b,  7 }, { 0x00007ffe, 15 },
+  { 0x000007fc, 11 }, { 0x00003ffd, 14 }, { 0x00001ffd, 13 }, { 0x0ffffffc, 28 },
+  { 0x000fffe6, 20 }, { 0x003fffd2, 22 }, { 0x000fffe7, 20 }, { 0x000fffe8, 20 },
+  { 0x003fffd3, 22 }, { 0x003fffd4, 22 }, { 0x003fffd5, 22 }, { 0x007fffd9, 23 },
+  { 0x003fffd6, 22 }, { 0x007fffda, 23 }, { 0x007fffdb, 23 }, { 0x007fffdc, 23 },
+  { 0x007fffdd, 23 }, { 0x007fffde, 23 }, { 0x00ffffeb, 24 }, { 0x007fffdf, 23 },
+  { 0x00ffffec, 24 }, { 0x00ffffed, 24 }, { 0x003fffd7, 22 }, { 0x007fffe0, 23 },
+  { 0x00ffffee, 24 }, { 0x007fffe1, 23 }, { 0x007fffe2, 23 }, { 0x007fffe3, 23 },
+  { 0x007fffe4, 23 }, { 0x001fffdc, 21 }, { 0x003fffd8, 22 }, { 0x007fffe5, 23 },
+  { 0x003fffd9, 22 }, { 0x007fffe6, 23 }, { 0x007fffe7, 23 }, { 0x00ffffef, 24 },
+  { 0x003fffda, 22 }, { 0x001fffdd, 21 }, { 0x000fffe9, 20 }, { 0x003fffdb, 22 },
+  { 0x003fffdc, 22 }, { 0x007fffe8, 23 }, { 0x007fffe9, 23 }, { 0x001fffde, 21 },
+  { 0x007fffea, 23 }, { 0x003fffdd, 22 }, { 0x003fffde, 22 }, { 0x00fffff0, 24 },
+  { 0x001fffdf, 21 }, { 0x003fffdf, 22 }, { 0x007fffeb, 23 }, { 0x007fffec, 23 },
+  { 0x001fffe0, 21 }, { 0x001fffe1, 21 }, { 0x003fffe0, 22 }, { 0x001fffe2, 21 },
+  { 0x007fffed, 23 }, { 0x003fffe1, 22 }, { 0x007fffee, 23 }, { 0x007fffef, 23 },
+  { 0x000fffea, 20 }, { 0x003fffe2, 22 }, { 0x003fffe3, 22 }, { 0x003fffe4, 22 },
+  { 0x007ffff0, 23 }, { 0x003fffe5, 22 }, { 0x003fffe6, 22 }, { 0x007ffff1, 23 },
+  { 0x03ffffe0, 26 }, { 0x03ffffe1, 26 }, { 0x000fffeb, 20 }, { 0x0007fff1, 19 },
+  { 0x003fffe7, 22 }, { 0x007ffff2, 23 }, { 0x003fffe8, 22 }, { 0x01ffffec, 25 },
+  { 0x03ffffe2, 26 }, { 0x03ffffe3, 26 }, { 0x03ffffe4, 26 }, { 0x07ffffde, 27 },
+  { 0x07ffffdf, 27 }, { 0x03ffffe5, 26 }, { 0x00fffff1, 24 }, { 0x01ffffed, 25 },
+  { 0x0007fff2, 19 }, { 0x001fffe3, 21 }, { 0x03ffffe6, 26 }, { 0x07ffffe0, 27 },
+  { 0x07ffffe1, 27 }, { 0x03ffffe7, 26 }, { 0x07ffffe2, 27 }, { 0x00fffff2, 24 },
+  { 0x001fffe4, 21 }, { 0x001fffe5, 21 }, { 0x03ffffe8, 26 }, { 0x03ffffe9, 26 },
+  { 0x0ffffffd, 28 }, { 0x07ffffe3, 27 }, { 0x07ffffe4, 27 }, { 0x07ffffe5, 27 },
+  { 0x000fffec, 20 }, { 0x00fffff3, 24 }, { 0x000fffed, 20 }, { 0x001fffe6, 21 },
+  { 0x003fffe9, 22 }, { 0x001fffe7, 21 }, { 0x001fffe8, 21 }, { 0x007ffff3, 23 },
+  { 0x003fffea, 22 }, { 0x003fffeb, 22 }, { 0x01ffffee, 25 }, { 0x01ffffef, 25 },
+  { 0x00fffff4, 24 }, { 0x00fffff5, 24 }, { 0x03ffffea, 26 }, { 0x007ffff4, 23 },
+  { 0x03ffffeb, 26 }, { 0x07ffffe6, 27 }, { 0x03ffffec, 26 }, { 0x03ffffed, 26 },
+  { 0x07ffffe7, 27 }, { 0x07ffffe8, 27 }, { 0x07ffffe9, 27 }, { 0x07ffffea, 27 },
+  { 0x07ffffeb, 27 }, { 0x0ffffffe, 28 }, { 0x07ffffec, 27 }, { 0x07ffffed, 27 },
+  { 0x07ffffee, 27 }, { 0x07ffffef, 27 }, { 0x07fffff0, 27 }, { 0x03ffffee, 26 },
+  { 0x3fffffff, 30 }
+};
+
+const hpack_huffman::decode_table hpack_huffman::decode_table_;
+
+hpack_huffman::decode_table::decode_table()
+{
+  // the code tree, a child being an inner node, or a leaf holding the
+  // symbol s as -s-1, 0 while not known, the root being no one's child
+  std::vector<boost::array<int, 2> > tree(1);
+  tree[0][0] = tree[0][1] = 0;
+  for (int s = 0; s < 257; ++s)
+  {
+    int node = 0;
+    for (int bit = codes_[s].size - 1; bit > 0; --bit)
+    {
+      const int side = (codes_[s].bits >> bit) & 1;
+      if (!tree[node][side])
+      {
+        tree[node][side] = static_cast<int>(tree.size());
+        const boost::array<int, 2> leaves = {{ 0, 0 }};
+        tree.push_back(leaves);
+      }
+      node = tree[node][side];
+    }
+    tree[node][codes_[s].bits & 1] = -s - 1;
+  }
+
+  // a code may end on padding, the most significant bits of the end of
+  // string, shorter than a byte
+  std::vector<bool> accepting(tree.size(), false);
+  for (int node = 0, depth = 0; depth < 8 && node >= 0; ++depth)
+  {
+    accepting[node] = true;
+    node = tree[node][1];
+  }
+
+  // no code is shorter than 5 bits, 4 bits decode a symbol at most
+  for (std::size_t state = 0; state < tree.size(); ++state)
+    for (int nibble = 0; nibble < 16; ++nibble)
+    {
+      transition& t = next[state][nibble];
+      t.flags = 0;
+      t.symbol = 0;
+      int node = static_cast<int>(state);
+      for (int bit = 3; bit >= 0; --bit)
+      {
+        node = tree[node][(nibble >> bit) & 1];
+        if (node < 0)
+        {
+          if (node == -257)
+            t.flags |= fail;
+          t.flags |= emit;
+          t.symbol = static_cast<boost::uint8_t>(-node - 1);
+          node = 0;
+        }
+      }
+      t.state = static_cast<boost::uint8_t>(node);
+      if (accepting[node])
+        t.flags |= accept;
+    }
+}
+
+std::size_t hpack_huffman::encoded_size(const std::string& value)
+{
+  std::size_t bits = 0;
+  for (std::size_t i = 0; i < value.size(); ++i)
+    bits += codes_[static_cast<unsigned char>(value[i])].size;
+  return (bits + 7) / 8;
+}
+
+void hpack_huffman::encode(const std::string& value, std::string& out)
+{
+  // fewer than 8 bits left over, plus a code of at most 30
+  boost::uint64_t pending = 0;
+  int count = 0;
+  for (std::size_t i = 0; i < value.size(); ++i)
+  {
+    const code& c = codes_[static_cast<unsigned char>(value[i])];
+    pending = (pending << c.size) | c.bits;
+    count += c.size;
+    while (count >= 8)
+    {
+      count -= 8;
+      out += static_cast<char>(pending >> count);
+    }
+  }
+  // padded with the first bits of the end of string, all ones
+  if (count)
+    out += static_cast<char>((pending << (8 - count)) | (0xff >> count));
+}
+
+bool hpack_huffman::decode(const unsigned char* begin,
+    const unsigned char* end, std::string& out)
+{
+  out.clear();
+  boost::uint8_t state = 0;
+  bool accepted = true;
+  for (; begin != end; ++begin)
+  {
+    const transition& high = decode_table_.next[state][*begin >> 4];
+    const transition& low = decode_table_.next[high.state][*begin & 0x0f];
+    if ((high.flags | low.flags) & fail)
+      return false;
+    if (high.flags & emit)
+      out += static_cast<char>(high.symbol);
+    if (low.flags & emit)
+      out += static_cast<char>(low.symbol);
+    state = low.state;
+    accepted = (low.flags & accept) != 0;
+  }
+  return accepted;
+}
+
+} // namespace server
+} // namespace http
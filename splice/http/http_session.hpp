@@ -33,10 +33,12 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
 
+#include "body_parser.hpp"
 #include "reply.hpp"
 #include "request.hpp"
 #include "request_handler.hpp"
 #include "request_parser.hpp"
+#include "router.hpp"
 
 #include "../tcp_session.hpp"
 
@@ -55,6 +57,11 @@ namespace splice
     explicit http_session(socket_t& socket
       ,http::server::request_handler& handler);
 
+    /// Construct a http_session answering requests through the routes of
+    /// a router, a 404 when none matches.
+    http_session(socket_t& socket
+      ,http::server::router& router);
+
   protected:
 
     template<typename _t>
@@ -78,20 +85,160 @@ namespace splice
     /// Handle completion of a write operation.
     void handle_write(const boost::system::error_code& e);
 
+    // CRTP virtual function, how long a persistent connection may wait
+    // for its next request.
+    boost::posix_time::time_duration keep_alive_timeout();
+
+    // CRTP virtual function, requests served on a single connection,
+    // the last reply closes it.
+    unsigned max_keep_alive_requests();
+
+    // Read the next request, or its end, for at most keep_alive_timeout
+    void async_read_request(incoming_data_ptr incoming_data);
+
+    // Go on once parse has consumed the bytes up to next, the bytes
+    // left in [next,end) are pipelined requests
+    void on_parsed(boost::tribool result
+      ,incoming_data_ptr incoming_data
+      ,const char* next
+      ,const char* end);
+
+    // The headers of request_ are parsed, go on with its body from the
+    // bytes left in [next,end), if it has any
+    void start_body(incoming_data_ptr incoming_data
+      ,const char* next
+      ,const char* end);
+
+    // Parse the body of request_ in [begin,end), read more of it in
+    // incoming_data until it is complete
+    void parse_body(incoming_data_ptr incoming_data
+      ,const char* begin
+      ,const char* end);
+
+    // The interim 100 Continue is written, read the body
+    void on_continue_written(incoming_data_ptr incoming_data
+      ,const boost::system::error_code& e);
+
+    // CRTP virtual function, bytes of content a request may have, beyond
+    // them it is answered with a 413.
+    boost::uint64_t max_body_size();
+
+    // CRTP virtual function, a run of the content of req, in place in the
+    // receive buffer, valid during the call only. The default gathers the
+    // content in req.body.
+    void on_body_chunk(const http::server::request& req
+      ,const char* data
+      ,std::size_t size);
+
+    // CRTP virtual function, fill out the reply of a request, through the
+    // request_handler or the router by default.
+    void handle_request(const http::server::request& req
+      ,http::server::reply& rep);
+
+    // Answer the parsed request_, requests are answered one at a time,
+    // in order
+    void write_reply();
+
+    // Answer with a stock reply and close the connection, what follows
+    // the request can't be parsed
+    void write_error(http::server::reply::status_type status);
+
+    void on_idle_timeout(const boost::system::error_code& e);
+
+    // CRTP virtual function, bytes of a file_body sent in a row before
+    // giving way to other sessions, also the read buffer size when
+    // sendfile isn't available.
+    std::size_t file_chunk_size();
+
+    // The headers of a reply with a file_body are written, send the file
+    void on_header_written(const boost::system::error_code& e);
+
+    // Send the next range of reply_.file, after its multipart header
+    // lines, or the closing delimiter once all of them are sent
+    void send_range();
+
+    // Send the file_body of reply_ from file_offset_, until the socket
+    // would block, file_end_ or file_chunk_size bytes
+    void send_file();
+
+    // The socket is writable again, or the last chunk or part header
+    // lines are written
+    void on_file_chunk(const boost::system::error_code& e);
+
+    // The headers of a streamed reply are written, hand the writer of its
+    // body to reply_.stream
+    void on_stream_header_written(const boost::system::error_code& e);
+
+    // Write a chunk of the streamed body, handler being called once the
+    // chunk is written
+    void write_chunk(boost::asio::const_buffer data
+      ,http::server::chunk_writer::handler_type handler);
+
+    void on_chunk_written(http::server::chunk_writer::handler_type handler
+      ,const boost::system::error_code& e);
+
+    // End the streamed body, once the chunk being written is written
+    void end_chunks();
+
+    // The chunk_writer of a streamed reply, keeps the session alive
+    class stream_writer;
+
+    // Whether the client asks to keep the connection open,
+    // the default of HTTP/1.1 and an option of HTTP/1.0
+    static bool wants_keep_alive(const http::server::request& req);
+
+    // Whether the reply has a header named name, case insensitive
+    static bool has_header(const http::server::reply& rep,const char* name);
+
     friend class base_t;
 
   private:
-    /// The handler used to process the incoming request.
-    http::server::request_handler& request_handler_;
+    /// The handler used to process the incoming request, or the router
+    /// dispatching it, one of them being null.
+    http::server::request_handler* request_handler_;
+    http::server::router* router_;
 
     /// The incoming request.
     http::server::request request_;
 
-    /// The parser for the incoming request.
+    /// The parser for the incoming request, and for its body.
     http::server::request_parser request_parser_;
+    http::server::body_parser body_parser_;
 
-    /// The reply to be sent back to the client.
+    /// The reply to be sent back to the client, and its status line and
+    /// header lines, rendered in a buffer kept from reply to reply.
     http::server::reply reply_;
+    std::string head_;
+
+    /// Pipelined bytes received after request_, parsed once reply_ is sent.
+    incoming_data_ptr pending_data_;
+    const char* pending_begin_;
+    const char* pending_end_;
+
+    /// Requests answered, and whether the connection stays open after
+    /// the current reply.
+    unsigned request_count_;
+    bool keep_alive_;
+
+    /// Closes a connection waiting too long for a request.
+    boost::asio::deadline_timer idle_timer_;
+
+    /// The range of reply_.file being sent, the next byte to send and the
+    /// end of the range, and the chunk being written when sendfile isn't
+    /// available.
+    std::size_t file_range_;
+    boost::uint64_t file_offset_;
+    boost::uint64_t file_end_;
+    std::vector<char> file_buffer_;
+
+    /// A streamed body is being written, as chunks unless the client is
+    /// HTTP/1.0, with a chunk being written, or the end of the body
+    /// waiting for it.
+    bool streaming_;
+    bool chunked_;
+    bool chunk_pending_;
+    bool end_pending_;
+    char chunk_head_[24];
   };
 
 } // namespace splice
@@ -17,11 +17,20 @@
 #include "../detail/config.hpp"
 
 #include "http_session.hpp"
+#include <cstdio>
 #include <vector>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/atomic.hpp>
 #include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/asio/write.hpp>
 #include <boost/asio/placeholders.hpp>
 
+#if defined(SPLICE_HAS_SENDFILE)
+# include <cerrno>
+# include <sys/sendfile.h>
+#endif
+
 namespace splice
 {
 
@@ -30,7 +39,42 @@ namespace splice
     (socket_t& socket
     ,http::server::request_handler& handler)
     :base_t(socket)
-    ,request_handler_(handler)
+    ,request_handler_(&handler)
+    ,router_(0)
+    ,pending_begin_(0)
+    ,pending_end_(0)
+    ,request_count_(0)
+    ,keep_alive_(true)
+    ,idle_timer_(get_io_service())
+    ,file_range_(0)
+    ,file_offset_(0)
+    ,file_end_(0)
+    ,streaming_(false)
+    ,chunked_(false)
+    ,chunk_pending_(false)
+    ,end_pending_(false)
+  {
+  }
+
+  template <typename up_t,typename log_t>
+  http_session<up_t,log_t>::http_session
+    (socket_t& socket
+    ,http::server::router& router)
+    :base_t(socket)
+    ,request_handler_(0)
+    ,router_(&router)
+    ,pending_begin_(0)
+    ,pending_end_(0)
+    ,request_count_(0)
+    ,keep_alive_(true)
+    ,idle_timer_(get_io_service())
+    ,file_range_(0)
+    ,file_offset_(0)
+    ,file_end_(0)
+    ,streaming_(false)
+    ,chunked_(false)
+    ,chunk_pending_(false)
+    ,end_pending_(false)
   {
   }
 
@@ -91,42 +135,21 @@ namespace splice
       return;
     }
 
+    const char* const end=incoming_data->data()+bytes_transferred;
     boost::tribool result;
-    boost::tie(result,boost::tuples::ignore)=request_parser_.parse(
-      request_,incoming_data->data(),incoming_data->data()+bytes_transferred);
+    const char* next;
+    boost::tie(result,next)=request_parser_.parse(
+      request_,incoming_data->data(),end);
 
-    if(result)
-    {
-      log_trace(EZ_FLFT,"if(result)");
-      request_handler_.handle_request(request_,reply_);
-      boost::asio::async_write(get_socket(),reply_.to_buffers(),
-        get_strand().wrap(
-        boost::bind(&http_session::handle_write,shared_from_this(),
-        boost::asio::placeholders::error)));
-    }
-    else if(!result)
+    if(!result)
     {
       log_trace(EZ_FLFT,"else if(!result)");
       hand_shake_data_t incoming(incoming_data,bytes_transferred,hand_shake_t::http);
       handshake_fail(incoming,cast_up()->move_socket());
       return;
-
-      //reply_=reply::stock_reply(reply::bad_request);
-      //boost::asio::async_write(get_socket(),reply_.to_buffers(),
-      //  get_strand().wrap(
-      //  boost::bind(&http_session::handle_write,shared_from_this(),
-      //  boost::asio::placeholders::error)));
-    }
-    else
-    {
-      log_trace(EZ_FLFT,"else");
-      get_socket().async_read_some(boost::asio::buffer(*incoming_data),
-        get_strand().wrap(
-        boost::bind(&http_session::handle_read,shared_from_this(),
-        incoming_data,
-        boost::asio::placeholders::error,
-        boost::asio::placeholders::bytes_transferred)));
     }
+
+    on_parsed(result,incoming_data,next,end);
   }
 
   template <typename up_t,typename log_t>
@@ -135,55 +158,555 @@ namespace splice
     const boost::system::error_code& e,
     std::size_t bytes_transferred)
   {
-    namespace ba=boost::asio;
-    using namespace http;
-    using namespace http::server;
-    using string=std::string;
-
     log_trace(EZ_FLFT,"");
 
+    boost::system::error_code ignored_ec;
+    idle_timer_.cancel(ignored_ec);
+
     if(!e)
     {
+      const char* const end=buffer->data()+bytes_transferred;
+      if(body_parser_.started())
+      {
+        parse_body(buffer,buffer->data(),end);
+        return;
+      }
+
       boost::tribool result;
-      boost::tie(result,boost::tuples::ignore)=request_parser_.parse(
-        request_,buffer->data(),buffer->data()+bytes_transferred);
+      const char* next;
+      boost::tie(result,next)=request_parser_.parse(
+        request_,buffer->data(),end);
 
-      if(result)
+      on_parsed(result,buffer,next,end);
+    }
+    else if(e!=boost::asio::error::operation_aborted)
+    {
+      log_trace(EZ_FLFT,e.message());
+      get_socket().close(ignored_ec);
+    }
+  }
+
+  template <typename up_t,typename log_t>
+  void http_session<up_t,log_t>::on_parsed(
+    boost::tribool result,
+    incoming_data_ptr incoming_data,
+    const char* next,
+    const char* end)
+  {
+    using namespace http::server;
+
+    if(result)
+      start_body(incoming_data,next,end);
+    else if(!result)
+      write_error(reply::bad_request);
+    else // all bytes consumed, the request goes on in the next read
+      async_read_request(incoming_data);
+  }
+
+  template <typename up_t,typename log_t>
+  void http_session<up_t,log_t>::start_body(
+    incoming_data_ptr incoming_data,
+    const char* next,
+    const char* end)
+  {
+    using namespace http::server;
+    using boost::algorithm::iequals;
+
+    if(!body_parser_.start(request_,cast_up()->max_body_size()))
+    {
+      write_error(body_parser_.too_large()
+        ?reply::payload_too_large:reply::bad_request);
+      return;
+    }
+
+    // a client waiting for a go-ahead before sending the body gets it
+    bool expects_continue=false;
+    if(!body_parser_.complete()&&next==end&&request_.http_version_major==1
+      &&request_.http_version_minor>=1)
+      for(auto& h:request_.headers)
+        if(iequals(h.name,"Expect")&&iequals(h.value,"100-continue"))
+          expects_continue=true;
+
+    if(expects_continue)
+    {
+      static const char continue_line[]="HTTP/1.1 100 Continue\r\n\r\n";
+      boost::asio::async_write(get_socket(),
+        boost::asio::buffer(continue_line,sizeof(continue_line)-1),
+        get_strand().wrap(
+        boost::bind(&http_session::on_continue_written,shared_from_this(),
+        incoming_data,boost::asio::placeholders::error)));
+    }
+    else
+      parse_body(incoming_data,next,end);
+  }
+
+  template <typename up_t,typename log_t>
+  void http_session<up_t,log_t>::on_continue_written(
+    incoming_data_ptr incoming_data,
+    const boost::system::error_code& e)
+  {
+    if(e)
+      handle_write(e);
+    else
+      async_read_request(incoming_data);
+  }
+
+  template <typename up_t,typename log_t>
+  void http_session<up_t,log_t>::parse_body(
+    incoming_data_ptr incoming_data,
+    const char* begin,
+    const char* end)
+  {
+    using namespace http::server;
+
+    // the content is handed out in place, the buffer is read into again
+    // once all of it is consumed
+    boost::tribool result;
+    const char* next;
+    boost::tie(result,next)=body_parser_.parse(begin,end,
+      [this](const char* data,std::size_t size)
+      {
+        cast_up()->on_body_chunk(request_,data,size);
+      });
+
+    if(result)
+    {
+      pending_data_=incoming_data;
+      pending_begin_=next;
+      pending_end_=end;
+      write_reply();
+    }
+    else if(!result)
+      write_error(body_parser_.too_large()
+        ?reply::payload_too_large:reply::bad_request);
+    else
+      async_read_request(incoming_data);
+  }
+
+  template <typename up_t,typename log_t>
+  boost::uint64_t http_session<up_t,log_t>::max_body_size()
+  {
+    return 1024*1024;
+  }
+
+  template <typename up_t,typename log_t>
+  void http_session<up_t,log_t>::on_body_chunk(
+    const http::server::request&,
+    const char* data,
+    std::size_t size)
+  {
+    request_.body.append(data,size);
+  }
+
+  template <typename up_t,typename log_t>
+  void http_session<up_t,log_t>::handle_request(
+    const http::server::request& req,
+    http::server::reply& rep)
+  {
+    using namespace http::server;
+
+    if(!router_)
+      request_handler_->handle_request(req,rep);
+    else if(!router_->route(req,rep))
+      rep=reply::stock_reply(reply::not_found);
+  }
+
+  template <typename up_t,typename log_t>
+  void http_session<up_t,log_t>::write_reply()
+  {
+    using namespace http::server;
+
+    const bool client_keep_alive=wants_keep_alive(request_);
+    keep_alive_=client_keep_alive
+      &&++request_count_<cast_up()->max_keep_alive_requests();
+
+    cast_up()->handle_request(request_,reply_);
+
+    if(reply_.stream)
+    { // an HTTP/1.0 client reads the body up to the end of the connection
+      chunked_=request_.http_version_major>1
+        ||(request_.http_version_major==1&&request_.http_version_minor>=1);
+      if(chunked_)
+      {
+        reply_.headers.push_back(header());
+        reply_.headers.back().name="Transfer-Encoding";
+        reply_.headers.back().value="chunked";
+      }
+      else
+        keep_alive_=false;
+    }
+
+    // the end of a content is only known from its Content-Length on a
+    // persistent connection, a shared header block carries its own
+    if(!reply_.file&&!reply_.stream&&!reply_.shared
+      &&reply_.status!=reply::no_content&&reply_.status!=reply::not_modified
+      &&!has_header(reply_,"Content-Length"))
+    {
+      reply_.headers.push_back(header());
+      reply_.headers.back().name="Content-Length";
+      reply_.headers.back().value=size_string(reply_.content.size());
+    }
+
+    // a Connection header set by the handler is overwritten rather than
+    // sent twice, and its close is honoured
+    header* connection=0;
+    for(auto& h:reply_.headers)
+      if(boost::algorithm::iequals(h.name,"Connection"))
+      {
+        connection=&h;
+        if(boost::algorithm::icontains(h.value,"close"))
+          keep_alive_=false;
+        break;
+      }
+
+    // HTTP/1.1 connections are persistent unless told otherwise,
+    // HTTP/1.0 ones only when asked for
+    if(!keep_alive_||request_.http_version_minor==0)
+    {
+      if(!connection)
       {
-        request_handler_.handle_request(request_,reply_);
-        boost::asio::async_write(get_socket(),reply_.to_buffers(),
+        reply_.headers.push_back(header());
+        connection=&reply_.headers.back();
+        connection->name="Connection";
+      }
+      connection->value=keep_alive_?"keep-alive":"close";
+    }
+
+    boost::asio::async_write(get_socket(),reply_.to_buffers(head_),
+      get_strand().wrap(
+      boost::bind(reply_.file?&http_session::on_header_written
+      :reply_.stream?&http_session::on_stream_header_written
+      :&http_session::handle_write,shared_from_this(),
+      boost::asio::placeholders::error)));
+  }
+
+  template <typename up_t,typename log_t>
+  void http_session<up_t,log_t>::write_error(
+    http::server::reply::status_type status)
+  {
+    using namespace http::server;
+
+    reply_=reply::stock_reply(status);
+    keep_alive_=false;
+    reply_.headers.push_back(header());
+    reply_.headers.back().name="Connection";
+    reply_.headers.back().value="close";
+    boost::asio::async_write(get_socket(),reply_.to_buffers(head_),
+      get_strand().wrap(
+      boost::bind(&http_session::handle_write,shared_from_this(),
+      boost::asio::placeholders::error)));
+  }
+
+  template <typename up_t,typename log_t>
+  void http_session<up_t,log_t>::on_header_written(
+    const boost::system::error_code& e)
+  {
+    using namespace http::server;
+
+    if(e)
+    {
+      handle_write(e);
+      return;
+    }
+
+    if(reply_.ranges.empty())
+    { // the whole file
+      reply_.ranges.push_back(reply::file_range());
+      reply_.ranges.back().first=0;
+      reply_.ranges.back().size=reply_.file->size();
+    }
+    file_range_=0;
+    send_range();
+  }
+
+  template <typename up_t,typename log_t>
+  void http_session<up_t,log_t>::send_range()
+  {
+    using namespace http::server;
+
+    if(file_range_==reply_.ranges.size())
+    {
+      if(reply_.ranges_tail.empty())
+        handle_write(boost::system::error_code());
+      else
+        boost::asio::async_write(get_socket(),
+          boost::asio::buffer(reply_.ranges_tail),
           get_strand().wrap(
           boost::bind(&http_session::handle_write,shared_from_this(),
           boost::asio::placeholders::error)));
-      }
-      else if(!result)
+      return;
+    }
+
+    const reply::file_range& range=reply_.ranges[file_range_++];
+    file_offset_=range.first;
+    file_end_=range.first+range.size;
+    if(range.head.empty())
+      send_file();
+    else
+      boost::asio::async_write(get_socket(),boost::asio::buffer(range.head),
+        get_strand().wrap(
+        boost::bind(&http_session::on_file_chunk,shared_from_this(),
+        boost::asio::placeholders::error)));
+  }
+
+  template <typename up_t,typename log_t>
+  void http_session<up_t,log_t>::on_file_chunk(
+    const boost::system::error_code& e)
+  {
+    if(e)
+      handle_write(e);
+    else
+      send_file();
+  }
+
+#if defined(SPLICE_HAS_SENDFILE)
+
+  template <typename up_t,typename log_t>
+  void http_session<up_t,log_t>::send_file()
+  {
+    socket_t& socket=get_socket();
+    boost::system::error_code ec;
+    socket.native_non_blocking(true,ec);
+
+    // from the page cache to the socket, never through user space
+    std::size_t budget=cast_up()->file_chunk_size();
+    while(file_offset_<file_end_)
+    {
+      off_t offset=static_cast<off_t>(file_offset_);
+      const ssize_t n=::sendfile(socket.native_handle(),
+        reply_.file->native_handle(),&offset,static_cast<std::size_t>(
+        (std::min)(file_end_-file_offset_,static_cast<boost::uint64_t>(budget))));
+
+      if(n>0)
       {
-        reply_=reply::stock_reply(reply::bad_request);
-        boost::asio::async_write(get_socket(),reply_.to_buffers(),
+        file_offset_+=n;
+        budget-=(std::min)(budget,static_cast<std::size_t>(n));
+        if(!budget&&file_offset_<file_end_)
+        { // the other sessions of this thread get their turn
+          get_strand().post(boost::bind(&http_session::send_file,
+            shared_from_this()));
+          return;
+        }
+      }
+      else if(n<0&&(errno==EAGAIN||errno==EWOULDBLOCK))
+      { // socket buffer full, wait for the client to read
+        socket.async_write_some(boost::asio::null_buffers(),
           get_strand().wrap(
-          boost::bind(&http_session::handle_write,shared_from_this(),
+          boost::bind(&http_session::on_file_chunk,shared_from_this(),
           boost::asio::placeholders::error)));
+        return;
       }
-      else
+      else if(n<0&&errno!=EINTR)
       {
-        get_socket().async_read_some(boost::asio::buffer(*buffer),
-          get_strand().wrap(
-          boost::bind(&http_session::handle_read,shared_from_this(),
-          buffer,
-          boost::asio::placeholders::error,
-          boost::asio::placeholders::bytes_transferred)));
+        handle_write(boost::system::error_code(errno,
+          boost::system::system_category()));
+        return;
+      }
+      else if(n==0)
+      { // file truncated since opened
+        handle_write(boost::asio::error::eof);
+        return;
       }
     }
-    else if(e!=boost::asio::error::operation_aborted)
+
+    send_range();
+  }
+
+#else
+
+  template <typename up_t,typename log_t>
+  void http_session<up_t,log_t>::send_file()
+  {
+    if(file_offset_==file_end_)
     {
-      log_trace(EZ_FLFT,e.message());
-      get_socket().close();
+      send_range();
+      return;
     }
+
+    // one chunk at a time, the next one is read once this one is written
+    file_buffer_.resize(cast_up()->file_chunk_size());
+    const std::size_t n=reply_.file->read(file_offset_,&file_buffer_[0],
+      static_cast<std::size_t>((std::min)(file_end_-file_offset_,
+      static_cast<boost::uint64_t>(file_buffer_.size()))));
+    if(!n)
+    { // file truncated since opened
+      handle_write(boost::asio::error::eof);
+      return;
+    }
+    file_offset_+=n;
+
+    boost::asio::async_write(get_socket(),boost::asio::buffer(&file_buffer_[0],n),
+      get_strand().wrap(
+      boost::bind(&http_session::on_file_chunk,shared_from_this(),
+      boost::asio::placeholders::error)));
+  }
+
+#endif // defined(SPLICE_HAS_SENDFILE)
+
+  template <typename up_t,typename log_t>
+  class http_session<up_t,log_t>::stream_writer
+    :public http::server::chunk_writer
+  {
+  public:
+    explicit stream_writer(const boost::shared_ptr<up_t>& session)
+      :session_(session)
+      ,closed_(false)
+    {
+    }
+
+    ~stream_writer()
+    {
+      close();
+    }
+
+    void async_write(const boost::asio::const_buffer& data
+      ,const handler_type& handler)
+    {
+      // once closed, the session may be streaming another reply
+      if(closed_)
+      {
+        session_->get_strand().post(boost::bind(handler,
+          boost::system::error_code(boost::asio::error::operation_aborted)));
+        return;
+      }
+      session_->get_strand().dispatch(
+        boost::bind(&http_session::write_chunk,session_,data,handler));
+    }
+
+    void close()
+    {
+      if(!closed_.exchange(true))
+        session_->get_strand().dispatch(
+          boost::bind(&http_session::end_chunks,session_));
+    }
+
+  private:
+    boost::shared_ptr<up_t> session_;
+    boost::atomic<bool> closed_;
+  };
+
+  template <typename up_t,typename log_t>
+  void http_session<up_t,log_t>::on_stream_header_written(
+    const boost::system::error_code& e)
+  {
+    if(e)
+    {
+      handle_write(e);
+      return;
+    }
+
+    streaming_=true;
+    reply_.stream(boost::make_shared<stream_writer>(shared_from_this()));
+  }
+
+  template <typename up_t,typename log_t>
+  void http_session<up_t,log_t>::write_chunk(
+    boost::asio::const_buffer data,
+    http::server::chunk_writer::handler_type handler)
+  {
+    BOOST_ASSERT(!chunk_pending_);
+
+    // an empty chunk would end the body, nothing is written
+    const std::size_t size=boost::asio::buffer_size(data);
+    if(!streaming_||!size)
+    {
+      const boost::system::error_code ec=streaming_
+        ?boost::system::error_code():boost::asio::error::operation_aborted;
+      get_strand().post(boost::bind(handler,ec));
+      return;
+    }
+
+    // the size line and the CRLF closing the chunk are left empty for an
+    // HTTP/1.0 client
+    static const char crlf[]={'\r','\n'};
+    const std::size_t head_size=chunked_?std::sprintf(chunk_head_,"%lx\r\n"
+      ,static_cast<unsigned long>(size)):0;
+    const boost::array<boost::asio::const_buffer,3> buffers={{
+      boost::asio::buffer(chunk_head_,head_size),
+      data,
+      boost::asio::buffer(crlf,chunked_?sizeof(crlf):0)}};
+
+    chunk_pending_=true;
+    boost::asio::async_write(get_socket(),buffers,
+      get_strand().wrap(
+      boost::bind(&http_session::on_chunk_written,shared_from_this(),
+      handler,boost::asio::placeholders::error)));
+  }
+
+  template <typename up_t,typename log_t>
+  void http_session<up_t,log_t>::on_chunk_written(
+    http::server::chunk_writer::handler_type handler,
+    const boost::system::error_code& e)
+  {
+    chunk_pending_=false;
+    if(e)
+    { // the body is given up along with the connection
+      streaming_=false;
+      handle_write(e);
+    }
+    handler(e);
+
+    if(end_pending_)
+      end_chunks();
+  }
+
+  template <typename up_t,typename log_t>
+  void http_session<up_t,log_t>::end_chunks()
+  {
+    if(chunk_pending_)
+    {
+      end_pending_=true;
+      return;
+    }
+    end_pending_=false;
+    if(!streaming_)
+      return;
+    streaming_=false;
+
+    // the last chunk, or the end of the connection for HTTP/1.0
+    static const char last_chunk[]={'0','\r','\n','\r','\n'};
+    if(!chunked_)
+      handle_write(boost::system::error_code());
+    else
+      boost::asio::async_write(get_socket(),boost::asio::buffer(last_chunk),
+        get_strand().wrap(
+        boost::bind(&http_session::handle_write,shared_from_this(),
+        boost::asio::placeholders::error)));
+  }
+
+  template <typename up_t,typename log_t>
+  std::size_t http_session<up_t,log_t>::file_chunk_size()
+  {
+    return 256*1024;
   }
 
   template <typename up_t,typename log_t>
   void http_session<up_t,log_t>::handle_write(const boost::system::error_code& e)
   {
+    using namespace http::server;
+
+    if(!e&&keep_alive_)
+    { // ready for the next request, maybe already received
+      request_=request();
+      request_parser_.reset();
+      body_parser_.reset();
+      reply_=reply();
+
+      if(pending_begin_!=pending_end_)
+      {
+        const char* const begin=pending_begin_;
+        pending_begin_=pending_end_;
+        boost::tribool result;
+        const char* next;
+        boost::tie(result,next)=request_parser_.parse(
+          request_,begin,pending_end_);
+        on_parsed(result,pending_data_,next,pending_end_);
+      }
+      else
+        async_read_request(pending_data_);
+      return;
+    }
+
     if(!e)
     {
       // Initiate graceful http_session closure.
@@ -194,8 +717,83 @@ namespace splice
     if(e!=boost::asio::error::operation_aborted)
     {
       log_trace(EZ_FLFT,e.message());
-      get_socket().close();
+      boost::system::error_code ignored_ec;
+      get_socket().close(ignored_ec);
     }
   }
 
+  template <typename up_t,typename log_t>
+  void http_session<up_t,log_t>::async_read_request(
+    incoming_data_ptr incoming_data)
+  {
+    if(!incoming_data)
+      incoming_data=mk_incoming_data();
+
+    idle_timer_.expires_from_now(cast_up()->keep_alive_timeout());
+    idle_timer_.async_wait(get_strand().wrap(
+      boost::bind(&http_session::on_idle_timeout,shared_from_this(),
+      boost::asio::placeholders::error)));
+
+    get_socket().async_read_some(boost::asio::buffer(*incoming_data),
+      get_strand().wrap(
+      boost::bind(&http_session::handle_read,shared_from_this(),
+      incoming_data,
+      boost::asio::placeholders::error,
+      boost::asio::placeholders::bytes_transferred)));
+  }
+
+  template <typename up_t,typename log_t>
+  void http_session<up_t,log_t>::on_idle_timeout(const boost::system::error_code& e)
+  {
+    // canceled, or expired while the read was completing
+    if(e||idle_timer_.expires_at()>boost::asio::deadline_timer::traits_type::now())
+      return;
+
+    log_trace(EZ_FLFT,"idle connection closed");
+    boost::system::error_code ignored_ec;
+    get_socket().close(ignored_ec);
+  }
+
+  template <typename up_t,typename log_t>
+  boost::posix_time::time_duration http_session<up_t,log_t>::keep_alive_timeout()
+  {
+    return boost::posix_time::seconds(5);
+  }
+
+  template <typename up_t,typename log_t>
+  unsigned http_session<up_t,log_t>::max_keep_alive_requests()
+  {
+    return 100;
+  }
+
+  template <typename up_t,typename log_t>
+  bool http_session<up_t,log_t>::wants_keep_alive(
+    const http::server::request& req)
+  {
+    using boost::algorithm::iequals;
+    using boost::algorithm::icontains;
+
+    bool keep_alive=req.http_version_major>1
+      ||(req.http_version_major==1&&req.http_version_minor>=1);
+    for(auto& h:req.headers)
+      if(iequals(h.name,"Connection"))
+      {
+        if(icontains(h.value,"close"))
+          return false;
+        if(icontains(h.value,"keep-alive"))
+          keep_alive=true;
+      }
+    return keep_alive;
+  }
+
+  template <typename up_t,typename log_t>
+  bool http_session<up_t,log_t>::has_header(
+    const http::server::reply& rep,const char* name)
+  {
+    for(auto& h:rep.headers)
+      if(boost::algorithm::iequals(h.name,name))
+        return true;
+    return false;
+  }
+
 } // namespace splice
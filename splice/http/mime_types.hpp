@@ -29,6 +29,10 @@ namespace mime_types {
 /// Convert a file extension into a MIME type.
 std::string extension_to_type(const std::string& extension);
 
+/// Whether content of a MIME type shrinks when compressed, text mostly,
+/// images and fonts being compressed already.
+bool is_compressible(const std::string& mime_type);
+
 } // namespace mime_types
 } // namespace server
 } // namespace http
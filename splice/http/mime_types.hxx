@@ -28,11 +28,26 @@ struct mapping
   const char* mime_type;
 } mappings[] =
 {
+  { "css", "text/css" },
+  { "csv", "text/csv" },
   { "gif", "image/gif" },
   { "htm", "text/html" },
   { "html", "text/html" },
+  { "ico", "image/x-icon" },
+  { "jpeg", "image/jpeg" },
   { "jpg", "image/jpeg" },
+  { "js", "application/javascript" },
+  { "json", "application/json" },
+  { "map", "application/json" },
+  { "mjs", "application/javascript" },
+  { "pdf", "application/pdf" },
   { "png", "image/png" },
+  { "svg", "image/svg+xml" },
+  { "txt", "text/plain" },
+  { "wasm", "application/wasm" },
+  { "webp", "image/webp" },
+  { "woff2", "font/woff2" },
+  { "xml", "application/xml" },
   { 0, 0 } // Marks end of list.
 };
 
@@ -49,6 +64,16 @@ std::string extension_to_type(const std::string& extension)
   return "text/plain";
 }
 
+bool is_compressible(const std::string& mime_type)
+{
+  return mime_type.compare(0, 5, "text/") == 0
+    || mime_type == "application/javascript"
+    || mime_type == "application/json"
+    || mime_type == "application/xml"
+    || mime_type == "application/wasm"
+    || mime_type == "image/svg+xml";
+}
+
 } // namespace mime_types
 } // namespace server
 } // namespace http
@@ -19,14 +19,44 @@
 #endif
 #include "../detail/config.hpp"
 
+#include <ctime>
 #include <string>
 #include <vector>
+#include <boost/array.hpp>
 #include <boost/asio.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include "chunk_writer.hpp"
+#include "file_body.hpp"
 #include "header.hpp"
 
 namespace http {
 namespace server {
 
+/// Header block and content built once and shared by many replies,
+/// i.e. a file held by the file_cache.
+struct shared_content
+{
+  /// The status line and header lines, each one ending with CRLF, sent
+  /// in place of the status line of the reply.
+  std::string head;
+
+  std::string content;
+
+  /// Strong entity tag, quoted as in the ETag header.
+  std::string etag;
+
+  /// Modification time, as in the Last-Modified header.
+  std::time_t last_modified;
+
+  /// The header block of a 304 answering a conditional request, without
+  /// content.
+  boost::shared_ptr<const shared_content> not_modified;
+};
+
+typedef boost::shared_ptr<const shared_content> shared_content_ptr;
+
 /// A reply to be sent to a client.
 struct reply
 {
@@ -37,6 +67,7 @@ struct reply
     created = 201,
     accepted = 202,
     no_content = 204,
+    partial_content = 206,
     multiple_choices = 300,
     moved_permanently = 301,
     moved_temporarily = 302,
@@ -45,6 +76,9 @@ struct reply
     unauthorized = 401,
     forbidden = 403,
     not_found = 404,
+    method_not_allowed = 405,
+    payload_too_large = 413,
+    range_not_satisfiable = 416,
     internal_server_error = 500,
     not_implemented = 501,
     bad_gateway = 502,
@@ -57,15 +91,50 @@ struct reply
   /// The content to be sent in the reply.
   std::string content;
 
-  /// Convert the reply into a vector of buffers. The buffers do not own the
-  /// underlying memory blocks, therefore the reply object must remain valid and
-  /// not be changed until the write operation has completed.
-  std::vector<boost::asio::const_buffer> to_buffers();
+  /// When set, its header block is sent before headers and its content
+  /// instead of content, which isn't copied.
+  shared_content_ptr shared;
+
+  /// When set, the file is sent from disk after the headers, content
+  /// being empty.
+  file_body_ptr file;
+
+  /// A part of file, preceded by its multipart/byteranges header lines.
+  struct file_range
+  {
+    std::string head;
+    boost::uint64_t first;
+    boost::uint64_t size;
+  };
+
+  /// The parts of file sent in a 206, all of it when empty, and the
+  /// closing delimiter of a multipart/byteranges body.
+  std::vector<file_range> ranges;
+  std::string ranges_tail;
+
+  /// When set, the body is streamed, content being empty and headers
+  /// without Content-Length. Called once the header lines are written,
+  /// with the writer of the body.
+  boost::function<void (const chunk_writer_ptr&)> stream;
+
+  /// Render the status line, a Date header and the headers into head, at
+  /// once, and return it along with the content. The buffers do not own the
+  /// underlying memory blocks, therefore head and the reply object must
+  /// remain valid and not be changed until the write operation has
+  /// completed. The capacity of head is reused from reply to reply.
+  boost::array<boost::asio::const_buffer, 2> to_buffers(std::string& head);
 
   /// Get a stock reply.
   static reply stock_reply(status_type status);
+
+  /// The status line of a status, ending with CRLF.
+  static const std::string& status_line(status_type status);
 };
 
+/// Decimal form of a size, i.e. a Content-Length value, without the stream
+/// of lexical_cast.
+std::string size_string(boost::uint64_t size);
+
 } // namespace server
 } // namespace http
 
@@ -18,7 +18,7 @@
 
 #include "reply.hpp"
 #include <string>
-#include <boost/lexical_cast.hpp>
+#include "date_cache.hpp"
 
 namespace http {
 namespace server {
@@ -26,76 +26,92 @@ namespace server {
 namespace status_strings {
 
 const std::string ok =
-  "HTTP/1.0 200 OK\r\n";
+  "HTTP/1.1 200 OK\r\n";
 const std::string created =
-  "HTTP/1.0 201 Created\r\n";
+  "HTTP/1.1 201 Created\r\n";
 const std::string accepted =
-  "HTTP/1.0 202 Accepted\r\n";
+  "HTTP/1.1 202 Accepted\r\n";
 const std::string no_content =
-  "HTTP/1.0 204 No Content\r\n";
+  "HTTP/1.1 204 No Content\r\n";
+const std::string partial_content =
+  "HTTP/1.1 206 Partial Content\r\n";
 const std::string multiple_choices =
-  "HTTP/1.0 300 Multiple Choices\r\n";
+  "HTTP/1.1 300 Multiple Choices\r\n";
 const std::string moved_permanently =
-  "HTTP/1.0 301 Moved Permanently\r\n";
+  "HTTP/1.1 301 Moved Permanently\r\n";
 const std::string moved_temporarily =
-  "HTTP/1.0 302 Moved Temporarily\r\n";
+  "HTTP/1.1 302 Moved Temporarily\r\n";
 const std::string not_modified =
-  "HTTP/1.0 304 Not Modified\r\n";
+  "HTTP/1.1 304 Not Modified\r\n";
 const std::string bad_request =
-  "HTTP/1.0 400 Bad Request\r\n";
+  "HTTP/1.1 400 Bad Request\r\n";
 const std::string unauthorized =
-  "HTTP/1.0 401 Unauthorized\r\n";
+  "HTTP/1.1 401 Unauthorized\r\n";
 const std::string forbidden =
-  "HTTP/1.0 403 Forbidden\r\n";
+  "HTTP/1.1 403 Forbidden\r\n";
 const std::string not_found =
-  "HTTP/1.0 404 Not Found\r\n";
+  "HTTP/1.1 404 Not Found\r\n";
+const std::string method_not_allowed =
+  "HTTP/1.1 405 Method Not Allowed\r\n";
+const std::string payload_too_large =
+  "HTTP/1.1 413 Payload Too Large\r\n";
+const std::string range_not_satisfiable =
+  "HTTP/1.1 416 Range Not Satisfiable\r\n";
 const std::string internal_server_error =
-  "HTTP/1.0 500 Internal Server Error\r\n";
+  "HTTP/1.1 500 Internal Server Error\r\n";
 const std::string not_implemented =
-  "HTTP/1.0 501 Not Implemented\r\n";
+  "HTTP/1.1 501 Not Implemented\r\n";
 const std::string bad_gateway =
-  "HTTP/1.0 502 Bad Gateway\r\n";
+  "HTTP/1.1 502 Bad Gateway\r\n";
 const std::string service_unavailable =
-  "HTTP/1.0 503 Service Unavailable\r\n";
+  "HTTP/1.1 503 Service Unavailable\r\n";
 
-boost::asio::const_buffer to_buffer(reply::status_type status)
+const std::string& to_string(reply::status_type status)
 {
   switch (status)
   {
   case reply::ok:
-    return boost::asio::buffer(ok);
+    return ok;
   case reply::created:
-    return boost::asio::buffer(created);
+    return created;
   case reply::accepted:
-    return boost::asio::buffer(accepted);
+    return accepted;
   case reply::no_content:
-    return boost::asio::buffer(no_content);
+    return no_content;
+  case reply::partial_content:
+    return partial_content;
   case reply::multiple_choices:
-    return boost::asio::buffer(multiple_choices);
+    return multiple_choices;
   case reply::moved_permanently:
-    return boost::asio::buffer(moved_permanently);
+    return moved_permanently;
   case reply::moved_temporarily:
-    return boost::asio::buffer(moved_temporarily);
+    return moved_temporarily;
   case reply::not_modified:
-    return boost::asio::buffer(not_modified);
+    return not_modified;
   case reply::bad_request:
-    return boost::asio::buffer(bad_request);
+    return bad_request;
   case reply::unauthorized:
-    return boost::asio::buffer(unauthorized);
+    return unauthorized;
   case reply::forbidden:
-    return boost::asio::buffer(forbidden);
+    return forbidden;
   case reply::not_found:
-    return boost::asio::buffer(not_found);
+    return not_found;
+  case reply::method_not_allowed:
+    return method_not_allowed;
+  case reply::payload_too_large:
+    return payload_too_large;
+  case reply::range_not_satisfiable:
+    return range_not_satisfiable;
   case reply::internal_server_error:
-    return boost::asio::buffer(internal_server_error);
+    return internal_server_error;
   case reply::not_implemented:
-    return boost::asio::buffer(not_implemented);
+    return not_implemented;
   case reply::bad_gateway:
-    return boost::asio::buffer(bad_gateway);
+    return bad_gateway;
   case reply::service_unavailable:
-    return boost::asio::buffer(service_unavailable);
+    return service_unavailable;
   default:
-    return boost::asio::buffer(internal_server_error);
+    return internal_server_error;
   }
 }
 
@@ -108,20 +124,26 @@ const char crlf[] = { '\r', '\n' };
 
 } // namespace misc_strings
 
-std::vector<boost::asio::const_buffer> reply::to_buffers()
+boost::array<boost::asio::const_buffer, 2> reply::to_buffers(
+    std::string& head)
 {
-  std::vector<boost::asio::const_buffer> buffers;
-  buffers.push_back(status_strings::to_buffer(status));
+  head.clear();
+  head += shared ? shared->head : status_line(status);
+  date_cache::append(head);
   for (std::size_t i = 0; i < headers.size(); ++i)
   {
-    header& h = headers[i];
-    buffers.push_back(boost::asio::buffer(h.name));
-    buffers.push_back(boost::asio::buffer(misc_strings::name_value_separator));
-    buffers.push_back(boost::asio::buffer(h.value));
-    buffers.push_back(boost::asio::buffer(misc_strings::crlf));
+    const header& h = headers[i];
+    head += h.name;
+    head.append(misc_strings::name_value_separator,
+        sizeof(misc_strings::name_value_separator));
+    head += h.value;
+    head.append(misc_strings::crlf, sizeof(misc_strings::crlf));
   }
-  buffers.push_back(boost::asio::buffer(misc_strings::crlf));
-  buffers.push_back(boost::asio::buffer(content));
+  head.append(misc_strings::crlf, sizeof(misc_strings::crlf));
+
+  const boost::array<boost::asio::const_buffer, 2> buffers = {{
+    boost::asio::buffer(head),
+    boost::asio::buffer(shared ? shared->content : content) }};
   return buffers;
 }
 
@@ -143,6 +165,11 @@ const char no_content[] =
   "<head><title>No Content</title></head>"
   "<body><h1>204 Content</h1></body>"
   "</html>";
+const char partial_content[] =
+  "<html>"
+  "<head><title>Partial Content</title></head>"
+  "<body><h1>206 Partial Content</h1></body>"
+  "</html>";
 const char multiple_choices[] =
   "<html>"
   "<head><title>Multiple Choices</title></head>"
@@ -183,6 +210,21 @@ const char not_found[] =
   "<head><title>Not Found</title></head>"
   "<body><h1>404 Not Found</h1></body>"
   "</html>";
+const char method_not_allowed[] =
+  "<html>"
+  "<head><title>Method Not Allowed</title></head>"
+  "<body><h1>405 Method Not Allowed</h1></body>"
+  "</html>";
+const char payload_too_large[] =
+  "<html>"
+  "<head><title>Payload Too Large</title></head>"
+  "<body><h1>413 Payload Too Large</h1></body>"
+  "</html>";
+const char range_not_satisfiable[] =
+  "<html>"
+  "<head><title>Range Not Satisfiable</title></head>"
+  "<body><h1>416 Range Not Satisfiable</h1></body>"
+  "</html>";
 const char internal_server_error[] =
   "<html>"
   "<head><title>Internal Server Error</title></head>"
@@ -216,6 +258,8 @@ std::string to_string(reply::status_type status)
     return accepted;
   case reply::no_content:
     return no_content;
+  case reply::partial_content:
+    return partial_content;
   case reply::multiple_choices:
     return multiple_choices;
   case reply::moved_permanently:
@@ -232,6 +276,12 @@ std::string to_string(reply::status_type status)
     return forbidden;
   case reply::not_found:
     return not_found;
+  case reply::method_not_allowed:
+    return method_not_allowed;
+  case reply::payload_too_large:
+    return payload_too_large;
+  case reply::range_not_satisfiable:
+    return range_not_satisfiable;
   case reply::internal_server_error:
     return internal_server_error;
   case reply::not_implemented:
@@ -254,11 +304,29 @@ reply reply::stock_reply(reply::status_type status)
   rep.content = stock_replies::to_string(status);
   rep.headers.resize(2);
   rep.headers[0].name = "Content-Length";
-  rep.headers[0].value = boost::lexical_cast<std::string>(rep.content.size());
+  rep.headers[0].value = size_string(rep.content.size());
   rep.headers[1].name = "Content-Type";
   rep.headers[1].value = "text/html";
   return rep;
 }
 
+const std::string& reply::status_line(reply::status_type status)
+{
+  return status_strings::to_string(status);
+}
+
+std::string size_string(boost::uint64_t size)
+{
+  // digits from the last one
+  char buffer[20];
+  char* p = buffer + sizeof(buffer);
+  do
+  {
+    *--p = static_cast<char>('0' + size % 10);
+    size /= 10;
+  } while (size);
+  return std::string(p, buffer + sizeof(buffer));
+}
+
 } // namespace server
 } // namespace http
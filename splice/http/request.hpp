@@ -35,6 +35,9 @@ struct request
   int http_version_major;
   int http_version_minor;
   std::vector<header> headers;
+
+  /// The content, as gathered by the default http_session::on_body_chunk.
+  std::string body;
 };
 
 } // namespace server
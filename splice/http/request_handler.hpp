@@ -20,12 +20,15 @@
 #include "../detail/config.hpp"
 
 #include <string>
+#include <vector>
+#include <boost/atomic.hpp>
 #include <boost/noncopyable.hpp>
+#include "file_cache.hpp"
+#include "reply.hpp"
 
 namespace http {
 namespace server {
 
-struct reply;
 struct request;
 
 /// The common handler for all incoming requests.
@@ -33,19 +36,42 @@ class request_handler
   : private boost::noncopyable
 {
 public:
-  /// Construct with a directory containing files to be served.
-  explicit request_handler(const std::string& doc_root);
+  /// Construct with a directory containing files to be served, up to
+  /// cache_bytes of them being kept in memory.
+  explicit request_handler(const std::string& doc_root,
+      std::size_t cache_bytes = 32 * 1024 * 1024);
 
   /// Handle a request and produce a reply.
   void handle_request(const request& req, reply& rep);
 
+  /// Perform URL-decoding on a string. Returns false if the encoding was
+  /// invalid.
+  static bool url_decode(const std::string& in, std::string& out);
+
 private:
   /// The directory containing the files to be served.
   std::string doc_root_;
 
-  /// Perform URL-decoding on a string. Returns false if the encoding was
-  /// invalid.
-  static bool url_decode(const std::string& in, std::string& out);
+  /// The files served recently.
+  file_cache cache_;
+
+  /// Makes the boundary of each multipart/byteranges body unique.
+  boost::atomic<boost::uint64_t> boundaries_;
+
+  /// Fill out the reply of a file sent from disk, the part of it asked
+  /// for by a Range header, or the whole of it.
+  void reply_file(const request& req, const std::string& range,
+      const file_body_ptr& body, const std::string& extension, reply& rep);
+
+  /// The file_cache codings accepted by the Accept-Encoding header of
+  /// a request, identity only when there is none.
+  static unsigned accepted_codings(const request& req);
+
+  /// Parse the value of a Range header into sorted, merged ranges of a
+  /// file of size bytes. Returns false when the header is to be ignored,
+  /// true without any range when none is satisfiable.
+  static bool parse_ranges(const std::string& in, boost::uint64_t size,
+      std::vector<reply::file_range>& ranges);
 };
 
 } // namespace server
@@ -17,20 +17,35 @@
 #include "../detail/config.hpp"
 
 #include "request_handler.hpp"
-#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 #include <sstream>
 #include <string>
+#include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
-#include <boost/numeric/conversion/cast.hpp> 
 #include "mime_types.hpp"
 #include "reply.hpp"
 #include "request.hpp"
+#include "validators.hpp"
 
 namespace http {
 namespace server {
 
-request_handler::request_handler(const std::string& doc_root)
+namespace detail {
+
+bool range_before(const reply::file_range& a, const reply::file_range& b)
+{
+  return a.first < b.first;
+}
+
+} // namespace detail
+
+request_handler::request_handler(const std::string& doc_root,
+    std::size_t cache_bytes)
   : doc_root_(doc_root)
+  , cache_(cache_bytes)
+  , boundaries_(static_cast<boost::uint64_t>(std::time(0)) << 20)
 {
 }
 
@@ -67,25 +82,244 @@ void request_handler::handle_request(const request& req, reply& rep)
     extension = request_path.substr(last_dot_pos + 1);
   }
 
-  // Open the file to send back.
-  std::string full_path = doc_root_ + request_path;
-  std::ifstream is(full_path.c_str(), std::ios::in | std::ios::binary);
-  if (!is)
+  // A Range of a GET is served from disk, through sendfile where
+  // available, other requests are served from the cache.
+  std::string range;
+  if (req.method == "GET")
+    for (std::size_t i = 0; i < req.headers.size(); ++i)
+      if (boost::iequals(req.headers[i].name, "Range"))
+        range = req.headers[i].value;
+
+  // Find the file to send back, read from disk on a cache miss.
+  const std::string full_path = doc_root_ + request_path;
+  shared_content_ptr file;
+  if (range.empty())
+    file = cache_.get(request_path, full_path, extension, accepted_codings(req));
+  if (file)
+  {
+    // Fill out the reply to be sent to the client, headers and content
+    // are shared with the cache.
+    if (validators::not_modified(req, file->etag, file->last_modified))
+    {
+      rep.status = reply::not_modified;
+      rep.shared = file->not_modified;
+      return;
+    }
+    rep.status = reply::ok;
+    rep.shared = file;
+    return;
+  }
+
+  // Too large to be cached, sent from disk by the session.
+  file_body_ptr body = file_body::open(full_path);
+  if (!body)
   {
     rep = reply::stock_reply(reply::not_found);
     return;
   }
+  reply_file(req, range, body, extension, rep);
+}
+
+void request_handler::reply_file(const request& req, const std::string& range,
+    const file_body_ptr& body, const std::string& extension, reply& rep)
+{
+  const boost::uint64_t size = body->size();
+  const std::string etag = validators::etag(size, body->modified());
+  const std::string last_modified = validators::http_date(body->modified());
+  if (validators::not_modified(req, etag, body->modified()))
+  {
+    rep.status = reply::not_modified;
+    rep.headers.resize(2);
+    rep.headers[0].name = "ETag";
+    rep.headers[0].value = etag;
+    rep.headers[1].name = "Last-Modified";
+    rep.headers[1].value = last_modified;
+    return;
+  }
+
+  std::vector<reply::file_range> ranges;
+  const bool partial = !range.empty()
+    && validators::if_range(req, etag, body->modified())
+    && parse_ranges(range, size, ranges);
+  if (partial && ranges.empty())
+  {
+    rep = reply::stock_reply(reply::range_not_satisfiable);
+    rep.headers.push_back(header());
+    rep.headers.back().name = "Content-Range";
+    rep.headers.back().value = "bytes */" + size_string(size);
+    return;
+  }
 
-  // Fill out the reply to be sent to the client.
-  rep.status = reply::ok;
-  char buf[512];
-  while (is.read(buf, sizeof(buf)).gcount() > 0)
-    rep.content.append(buf, boost::numeric_cast<size_t>(is.gcount()));
-  rep.headers.resize(2);
-  rep.headers[0].name = "Content-Length";
-  rep.headers[0].value = boost::lexical_cast<std::string>(rep.content.size());
-  rep.headers[1].name = "Content-Type";
-  rep.headers[1].value = mime_types::extension_to_type(extension);
+  const std::string type = mime_types::extension_to_type(extension);
+  boost::uint64_t length = size;
+  std::string content_type = type;
+  if (partial && ranges.size() == 1)
+  {
+    length = ranges[0].size;
+    rep.headers.push_back(header());
+    rep.headers.back().name = "Content-Range";
+    rep.headers.back().value = "bytes "
+      + size_string(ranges[0].first) + "-"
+      + size_string(ranges[0].first + ranges[0].size - 1)
+      + "/" + size_string(size);
+  }
+  else if (partial)
+  {
+    // each part is preceded by its header lines, the body length is
+    // known beforehand
+    char boundary[32];
+    std::sprintf(boundary, "splice%016llx",
+        static_cast<unsigned long long>(++boundaries_));
+    length = 0;
+    for (std::size_t i = 0; i < ranges.size(); ++i)
+    {
+      ranges[i].head = std::string("\r\n--") + boundary + "\r\n"
+        "Content-Type: " + type + "\r\n"
+        "Content-Range: bytes "
+        + size_string(ranges[i].first) + "-"
+        + size_string(ranges[i].first + ranges[i].size - 1)
+        + "/" + size_string(size) + "\r\n\r\n";
+      length += ranges[i].head.size() + ranges[i].size;
+    }
+    rep.ranges_tail = std::string("\r\n--") + boundary + "--\r\n";
+    length += rep.ranges_tail.size();
+    content_type = std::string("multipart/byteranges; boundary=") + boundary;
+  }
+
+  rep.status = partial ? reply::partial_content : reply::ok;
+  rep.file = body;
+  rep.ranges.swap(ranges);
+  const std::size_t n = rep.headers.size();
+  rep.headers.resize(n + 5);
+  rep.headers[n].name = "Content-Length";
+  rep.headers[n].value = size_string(length);
+  rep.headers[n + 1].name = "Content-Type";
+  rep.headers[n + 1].value = content_type;
+  rep.headers[n + 2].name = "Accept-Ranges";
+  rep.headers[n + 2].value = "bytes";
+  rep.headers[n + 3].name = "ETag";
+  rep.headers[n + 3].value = etag;
+  rep.headers[n + 4].name = "Last-Modified";
+  rep.headers[n + 4].value = last_modified;
+}
+
+unsigned request_handler::accepted_codings(const request& req)
+{
+  unsigned accepted = 1 << file_cache::identity;
+  unsigned refused = 0;
+  for (std::size_t i = 0; i < req.headers.size(); ++i)
+  {
+    if (!boost::iequals(req.headers[i].name, "Accept-Encoding"))
+      continue;
+
+    // e.g. "gzip, deflate;q=0.5, br;q=1.0, *;q=0"
+    const std::string& value = req.headers[i].value;
+    for (std::size_t begin = 0; begin < value.size();)
+    {
+      std::size_t end = value.find(',', begin);
+      if (end == std::string::npos)
+        end = value.size();
+      std::string coding = value.substr(begin, end - begin);
+      begin = end + 1;
+
+      bool refuse = false;
+      const std::size_t params = coding.find(';');
+      if (params != std::string::npos)
+      {
+        std::string q = coding.substr(params + 1);
+        coding.erase(params);
+        boost::algorithm::erase_all(q, " ");
+        refuse = boost::istarts_with(q, "q=")
+          && std::strtod(q.c_str() + 2, 0) <= 0.0;
+      }
+      boost::algorithm::trim(coding);
+
+      unsigned codings = 0;
+      if (boost::iequals(coding, "gzip"))
+        codings = 1 << file_cache::gzip;
+      else if (boost::iequals(coding, "br"))
+        codings = 1 << file_cache::br;
+      else if (coding == "*")
+        codings = (1 << file_cache::coding_count) - 1;
+      (refuse ? refused : accepted) |= codings;
+    }
+  }
+
+  // an explicit q=0 wins over "*", identity is the fallback anyway
+  return (accepted & ~refused) | (1 << file_cache::identity);
+}
+
+bool request_handler::parse_ranges(const std::string& in,
+    boost::uint64_t size, std::vector<reply::file_range>& ranges)
+{
+  // beyond, the header is ignored rather than a part sent per byte
+  const std::size_t max_ranges = 16;
+
+  // e.g. "bytes=0-499, 1000-, -500"
+  if (!boost::istarts_with(in, "bytes="))
+    return false;
+  std::vector<std::string> specs;
+  boost::algorithm::split(specs, in.substr(6), boost::is_any_of(","));
+  bool specified = false;
+  for (std::size_t i = 0; i < specs.size(); ++i)
+  {
+    std::string& spec = specs[i];
+    boost::algorithm::trim(spec);
+    if (spec.empty())
+      continue;
+    const std::size_t dash = spec.find('-');
+    if (dash == std::string::npos
+        || spec.find_first_not_of("0123456789-") != std::string::npos
+        || spec.find('-', dash + 1) != std::string::npos)
+      return false;
+    specified = true;
+
+    // up to 19 digits fit in 64 bits
+    const std::string first_pos = spec.substr(0, dash);
+    const std::string last_pos = spec.substr(dash + 1);
+    if (first_pos.size() > 19 || last_pos.size() > 19)
+      return false;
+    reply::file_range range;
+    if (first_pos.empty())
+    { // the last bytes
+      if (last_pos.empty())
+        return false;
+      const boost::uint64_t suffix = boost::lexical_cast<boost::uint64_t>(last_pos);
+      if (!suffix || !size)
+        continue;
+      range.first = size - (std::min)(suffix, size);
+      range.size = size - range.first;
+    }
+    else
+    {
+      range.first = boost::lexical_cast<boost::uint64_t>(first_pos);
+      boost::uint64_t last = last_pos.empty()
+        ? range.first : boost::lexical_cast<boost::uint64_t>(last_pos);
+      if (last < range.first)
+        return false;
+      if (range.first >= size)
+        continue;
+      last = last_pos.empty() ? size - 1 : (std::min)(last, size - 1);
+      range.size = last - range.first + 1;
+    }
+    ranges.push_back(range);
+  }
+
+  // overlapping or adjacent ranges are sent as one
+  std::sort(ranges.begin(), ranges.end(), detail::range_before);
+  std::size_t merged = 0;
+  for (std::size_t i = 1; i < ranges.size(); ++i)
+  {
+    reply::file_range& last = ranges[merged];
+    if (ranges[i].first <= last.first + last.size)
+      last.size = (std::max)(last.first + last.size,
+          ranges[i].first + ranges[i].size) - last.first;
+    else
+      ranges[++merged] = ranges[i];
+  }
+  if (!ranges.empty())
+    ranges.resize(merged + 1);
+  return specified && ranges.size() <= max_ranges;
 }
 
 bool request_handler::url_decode(const std::string& in, std::string& out)
@@ -0,0 +1,197 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef HTTP_REQUEST_VIEW_HPP
+#define HTTP_REQUEST_VIEW_HPP
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include <cstring>
+#include <boost/array.hpp>
+#include <boost/utility/string_ref.hpp>
+#include "basic_request_parser.hpp"
+
+namespace http {
+namespace server {
+
+/// A request parsed in place, its fields refer to the receive buffer,
+/// which must outlive it and stay unchanged. Nothing is allocated: a
+/// request with more than max_headers headers, or a folded header value,
+/// fails to parse. The headers most looked for are indexed when first
+/// looked for.
+struct request_view
+{
+  /// Headers found through the index.
+  enum known_header
+  {
+    host,
+    connection,
+    upgrade,
+    sec_websocket_key,
+    content_length,
+    known_count
+  };
+
+  struct header
+  {
+    boost::string_ref name;
+    boost::string_ref value;
+  };
+
+  /// Headers in order of arrival, in a fixed array.
+  class header_list
+  {
+  public:
+    static const std::size_t max_headers = 64;
+
+    typedef const header* const_iterator;
+
+    header_list()
+      : size_(0)
+    {
+    }
+
+    /// Add an empty header, false when full.
+    bool extend()
+    {
+      if (size_ == max_headers)
+        return false;
+      headers_[size_++] = header();
+      return true;
+    }
+
+    void clear()
+    {
+      size_ = 0;
+    }
+
+    bool empty() const
+    {
+      return !size_;
+    }
+
+    std::size_t size() const
+    {
+      return size_;
+    }
+
+    header& back()
+    {
+      return headers_[size_ - 1];
+    }
+
+    const header& operator[](std::size_t i) const
+    {
+      return headers_[i];
+    }
+
+    const_iterator begin() const
+    {
+      return headers_.data();
+    }
+
+    const_iterator end() const
+    {
+      return headers_.data() + size_;
+    }
+
+  private:
+    boost::array<header, max_headers> headers_;
+    std::size_t size_;
+  };
+
+  boost::string_ref method;
+  boost::string_ref uri;
+  int http_version_major;
+  int http_version_minor;
+  header_list headers;
+
+  request_view()
+    : http_version_major(0)
+    , http_version_minor(0)
+    , indexed_(false)
+  {
+  }
+
+  /// Forget the previous request, before parsing another one.
+  void clear()
+  {
+    *this = request_view();
+  }
+
+  /// Value of the first header of a known name, empty when absent.
+  boost::string_ref get(known_header name) const
+  {
+    if (!indexed_)
+      index();
+    return known_[name];
+  }
+
+  /// Value of the first header named name, case insensitive, empty when
+  /// absent.
+  boost::string_ref get(boost::string_ref name) const
+  {
+    for (header_list::const_iterator h = headers.begin(); h != headers.end(); ++h)
+      if (iequals(h->name, name))
+        return h->value;
+    return boost::string_ref();
+  }
+
+  /// Case insensitive comparison, of ASCII.
+  static bool iequals(boost::string_ref a, boost::string_ref b)
+  {
+    if (a.size() != b.size())
+      return false;
+    for (std::size_t i = 0; i < a.size(); ++i)
+    {
+      char ca = a[i], cb = b[i];
+      if (ca >= 'A' && ca <= 'Z') ca += 'a' - 'A';
+      if (cb >= 'A' && cb <= 'Z') cb += 'a' - 'A';
+      if (ca != cb)
+        return false;
+    }
+    return true;
+  }
+
+private:
+  /// One pass over the headers, the first one of each known name wins.
+  void index() const
+  {
+    static const char* const names[known_count] =
+    {
+      "Host",
+      "Connection",
+      "Upgrade",
+      "Sec-WebSocket-Key",
+      "Content-Length"
+    };
+
+    for (std::size_t i = 0; i < known_count; ++i)
+      known_[i] = boost::string_ref();
+    for (std::size_t i = headers.size(); i-- > 0;)
+      for (std::size_t k = 0; k < known_count; ++k)
+        if (iequals(headers[i].name, names[k]))
+          known_[k] = headers[i].value;
+    indexed_ = true;
+  }
+
+  mutable boost::string_ref known_[known_count];
+  mutable bool indexed_;
+};
+
+/// Parser of a request_view, in place.
+typedef basic_request_parser<request_view> request_view_parser;
+
+} // namespace server
+} // namespace http
+
+#endif // HTTP_REQUEST_VIEW_HPP
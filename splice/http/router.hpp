@@ -0,0 +1,144 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef HTTP_ROUTER_HPP
+#define HTTP_ROUTER_HPP
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include "reply.hpp"
+
+namespace http {
+namespace server {
+
+struct request;
+class request_handler;
+
+/// Values captured by the parameters of a route pattern, URL-decoded,
+/// in the order of the pattern.
+class route_params
+{
+public:
+  typedef std::vector<std::pair<std::string, std::string> > values_type;
+
+  /// The value of a parameter, empty when the pattern has none so named.
+  const std::string& operator[](const std::string& name) const;
+
+  const values_type& values() const
+  {
+    return values_;
+  }
+
+private:
+  friend class router;
+  values_type values_;
+};
+
+/// Dispatch requests to handlers by method and path, e.g.
+///
+///   router.add("GET", "/health", health);
+///   router.add("GET", "/users/:id", get_user);
+///   router.add("GET", "/*", router::files(request_handler));
+///
+/// A ":name" segment captures one path segment, a trailing "*name" the
+/// rest of the path, "*" the method any method without its own route.
+/// Patterns are compiled into a radix tree, a lookup walks the path once
+/// without any allocation but the captured values; a static segment
+/// wins over a parameter, a parameter over a wildcard.
+/// Routes are added before the server starts, the router being then
+/// shared by every session without any lock.
+/// A handler sets the status, headers and content of the reply; the
+/// framing headers, Content-Length or Transfer-Encoding and Connection,
+/// are added by the session.
+class router
+  : private boost::noncopyable
+{
+public:
+  typedef boost::function<void (const request&, const route_params&, reply&)>
+    handler_type;
+
+  router();
+
+  /// Add a route. Throws std::invalid_argument on a pattern that doesn't
+  /// start with '/', names a parameter differently than a route already
+  /// added at the same place, or has a wildcard before its end.
+  void add(const std::string& method, const std::string& pattern,
+      const handler_type& handler);
+
+  /// Fill out the reply of a request, a 405 listing the allowed methods
+  /// when its path is routed but not its method. Returns false when no
+  /// route matches the path, the reply being untouched.
+  bool route(const request& req, reply& rep) const;
+
+  /// A handler serving the files of a request_handler, which is to
+  /// outlive the router.
+  static handler_type files(request_handler& handler);
+
+private:
+  struct node;
+  typedef boost::shared_ptr<node> node_ptr;
+
+  struct node
+  {
+    /// Static text matched by this node, the root one being empty.
+    std::string prefix;
+
+    /// First character of the prefix of each static child, scanned
+    /// before the children themselves.
+    std::string indices;
+    std::vector<node_ptr> children;
+
+    /// Child matching a ":name" segment, and a trailing "*name".
+    node_ptr param;
+    std::string param_name;
+    node_ptr wildcard;
+    std::string wildcard_name;
+
+    /// Handlers of the routes ending here, by method.
+    std::vector<std::pair<std::string, handler_type> > handlers;
+  };
+
+  /// A parameter and the raw text it matches.
+  struct capture
+  {
+    const std::string* name;
+    const char* begin;
+    const char* end;
+  };
+
+  /// The node at the end of static text below n, splitting a child whose
+  /// prefix only partly matches.
+  static node* insert(node* n, const std::string& text);
+
+  /// The node whose routes match path [p, end) below n, static children
+  /// first, then the parameter and the wildcard ones, with what their
+  /// parameters capture. Null when none matches.
+  static const node* match(const node* n, const char* p, const char* end,
+      std::vector<capture>& captures);
+
+  node_ptr root_;
+};
+
+} // namespace server
+} // namespace http
+
+#if defined(SPLICE_HEADER_ONLY)
+# include "router.hxx"
+#endif
+
+#endif // HTTP_ROUTER_HPP
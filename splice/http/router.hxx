@@ -0,0 +1,233 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include "router.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include "request.hpp"
+#include "request_handler.hpp"
+
+namespace http {
+namespace server {
+
+namespace detail {
+
+const std::string no_route_param;
+
+} // namespace detail
+
+const std::string& route_params::operator[](const std::string& name) const
+{
+  for (std::size_t i = 0; i < values_.size(); ++i)
+    if (values_[i].first == name)
+      return values_[i].second;
+  return detail::no_route_param;
+}
+
+router::router()
+  : root_(boost::make_shared<node>())
+{
+}
+
+void router::add(const std::string& method, const std::string& pattern,
+    const handler_type& handler)
+{
+  if (pattern.empty() || pattern[0] != '/')
+    throw std::invalid_argument("route pattern without a leading '/': "
+        + pattern);
+
+  // static text, then a parameter up to the next '/', and so on
+  node* n = root_.get();
+  for (std::size_t i = 0; i < pattern.size();)
+  {
+    const std::size_t param = pattern.find_first_of(":*", i);
+    n = insert(n, pattern.substr(i, param - i));
+    if (param == std::string::npos)
+      break;
+    if (pattern[param - 1] != '/')
+      throw std::invalid_argument("route parameter within a segment: "
+          + pattern);
+
+    std::size_t name_end = pattern.find('/', param);
+    if (name_end == std::string::npos)
+      name_end = pattern.size();
+    const std::string name = pattern.substr(param + 1, name_end - param - 1);
+    node_ptr& child = pattern[param] == ':' ? n->param : n->wildcard;
+    std::string& child_name = pattern[param] == ':'
+      ? n->param_name : n->wildcard_name;
+    if (pattern[param] == '*' && name_end != pattern.size())
+      throw std::invalid_argument("route wildcard before the end: " + pattern);
+    if (!child)
+    {
+      child = boost::make_shared<node>();
+      child_name = name;
+    }
+    else if (child_name != name)
+      throw std::invalid_argument("route parameter named " + name
+          + " instead of " + child_name + ": " + pattern);
+    n = child.get();
+    i = name_end;
+  }
+
+  for (std::size_t i = 0; i < n->handlers.size(); ++i)
+    if (n->handlers[i].first == method)
+    {
+      n->handlers[i].second = handler;
+      return;
+    }
+  n->handlers.push_back(std::make_pair(method, handler));
+}
+
+bool router::route(const request& req, reply& rep) const
+{
+  // the query isn't part of the path
+  const char* const path = req.uri.data();
+  const std::size_t query = req.uri.find('?');
+  const char* const end = path
+    + (query != std::string::npos ? query : req.uri.size());
+
+  std::vector<capture> captures;
+  const node* n = match(root_.get(), path, end, captures);
+  if (!n)
+    return false;
+
+  const handler_type* handler = 0;
+  for (std::size_t i = 0; i < n->handlers.size(); ++i)
+    if (n->handlers[i].first == req.method)
+    {
+      handler = &n->handlers[i].second;
+      break;
+    }
+    else if (n->handlers[i].first == "*")
+      handler = &n->handlers[i].second;
+
+  if (!handler)
+  {
+    rep = reply::stock_reply(reply::method_not_allowed);
+    rep.headers.push_back(header());
+    rep.headers.back().name = "Allow";
+    for (std::size_t i = 0; i < n->handlers.size(); ++i)
+      rep.headers.back().value += (i ? ", " : "") + n->handlers[i].first;
+    return true;
+  }
+
+  route_params params;
+  params.values_.resize(captures.size());
+  for (std::size_t i = 0; i < captures.size(); ++i)
+  {
+    params.values_[i].first = *captures[i].name;
+    if (!request_handler::url_decode(
+        std::string(captures[i].begin, captures[i].end),
+        params.values_[i].second))
+    {
+      rep = reply::stock_reply(reply::bad_request);
+      return true;
+    }
+  }
+
+  (*handler)(req, params, rep);
+  return true;
+}
+
+router::handler_type router::files(request_handler& handler)
+{
+  return boost::bind(&request_handler::handle_request, &handler, _1, _3);
+}
+
+router::node* router::insert(node* n, const std::string& text)
+{
+  for (std::size_t i = 0; i < text.size();)
+  {
+    // children start with distinct characters
+    const std::size_t c = n->indices.find(text[i]);
+    if (c == std::string::npos)
+    {
+      node_ptr child = boost::make_shared<node>();
+      child->prefix = text.substr(i);
+      n->indices += text[i];
+      n->children.push_back(child);
+      return child.get();
+    }
+
+    node* child = n->children[c].get();
+    std::size_t common = 1;
+    while (common < child->prefix.size() && i + common < text.size()
+        && child->prefix[common] == text[i + common])
+      ++common;
+
+    if (common < child->prefix.size())
+    { // the tail of the child keeps its routes and children
+      node_ptr tail = boost::make_shared<node>(*child);
+      tail->prefix.erase(0, common);
+      *child = node();
+      child->prefix = text.substr(i, common);
+      child->indices = tail->prefix[0];
+      child->children.push_back(tail);
+    }
+    n = child;
+    i += common;
+  }
+  return n;
+}
+
+const router::node* router::match(const node* n, const char* p,
+    const char* end, std::vector<capture>& captures)
+{
+  if (p == end)
+  {
+    if (!n->handlers.empty())
+      return n;
+    if (!n->wildcard)
+      return 0;
+    const capture rest = { &n->wildcard_name, p, end };
+    captures.push_back(rest);
+    return n->wildcard.get();
+  }
+
+  const std::size_t c = n->indices.find(*p);
+  if (c != std::string::npos)
+  {
+    const node* child = n->children[c].get();
+    const std::size_t size = child->prefix.size();
+    if (static_cast<std::size_t>(end - p) >= size
+        && std::memcmp(p, child->prefix.data(), size) == 0)
+      if (const node* found = match(child, p + size, end, captures))
+        return found;
+  }
+
+  if (n->param)
+  {
+    const char* const segment_end = std::find(p, end, '/');
+    if (segment_end != p)
+    {
+      const capture segment = { &n->param_name, p, segment_end };
+      captures.push_back(segment);
+      if (const node* found = match(n->param.get(), segment_end, end, captures))
+        return found;
+      captures.pop_back();
+    }
+  }
+
+  if (!n->wildcard)
+    return 0;
+  const capture rest = { &n->wildcard_name, p, end };
+  captures.push_back(rest);
+  return n->wildcard.get();
+}
+
+} // namespace server
+} // namespace http
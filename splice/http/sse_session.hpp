@@ -0,0 +1,142 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef HTTP_SSE_SESSION_HPP
+#define HTTP_SSE_SESSION_HPP
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include <string>
+#include <boost/asio.hpp>
+#include <boost/cstdint.hpp>
+
+#include "chunk_writer.hpp"
+#include "event_stream.hpp"
+#include "http_session.hpp"
+
+#include "../event_history.hpp"
+#include "../pubsub_hub.hpp"
+
+namespace splice
+{
+
+  /// An http_session also answering requests for an event stream,
+  /// "Accept: text/event-stream", as a browser EventSource sends them.
+  /// The reply is a streamed body, held open, where the messages published
+  /// on a topic of a pubsub_hub are written as server-sent events: a one
+  /// way feed without any WebSocket framing, going through HTTP proxies.
+  /// Events published meanwhile are gathered and written at once, so that
+  /// a client that is slow to read gets fewer, larger chunks. A client
+  /// reconnecting with a Last-Event-ID gets the events it missed from an
+  /// event_history, the ones still kept there.
+  template <typename up_t,typename log_t=no_log>
+  class sse_session
+    :public http_session<up_t,log_t>
+  {
+  public:
+    using base_t=http_session<up_t,log_t>;
+
+    /// Construct a session streaming the messages of hub, numbered and
+    /// kept by history, if any, in order to resume a stream.
+    sse_session(socket_t& socket
+      ,http::server::request_handler& handler
+      ,pubsub_hub& hub
+      ,event_history* history=0);
+
+    sse_session(socket_t& socket
+      ,http::server::router& router
+      ,pubsub_hub& hub
+      ,event_history* history=0);
+
+    // Called by pubsub_hub from the publishing thread,
+    // the message is written as an event.
+    void on_publish(const publication& pub);
+
+  protected:
+    // CRTP virtual function, an event stream is requested, the topic it
+    // subscribes to, a topic ending with '*' subscribing to every topic
+    // starting with what precedes the '*'. Returns false to answer the
+    // request as any other one, the default for every request.
+    bool event_stream_topic(const http::server::request& req
+      ,std::string& topic);
+
+    // CRTP virtual function, how long a stream may stay without any
+    // event before a comment is written, for proxies to keep it open and
+    // to notice a client gone.
+    boost::posix_time::time_duration heartbeat_interval();
+
+    // CRTP virtual function, bytes of events a client may leave unread,
+    // beyond them its stream is ended, the client reconnecting with the
+    // id of the last event it received.
+    std::size_t max_queued_size();
+
+    // An event stream request is answered here, any other one by the
+    // http_session
+    void handle_request(const http::server::request& req
+      ,http::server::reply& rep);
+
+    friend class base_t;
+
+  private:
+    // The header lines of the stream are written, subscribe to topic
+    // and send the events after last_event_id, if resumed
+    void start_events(const http::server::chunk_writer_ptr& writer
+      ,const std::string& topic
+      ,boost::uint64_t last_event_id
+      ,bool resume);
+
+    // Queue an event, those with an id already replayed are dropped
+    void push_event(const http::server::event_ptr& event
+      ,boost::uint64_t id);
+
+    // Write the events queued, unless a write is in flight
+    void write_events();
+
+    void on_events_written(const boost::system::error_code& e);
+
+    void on_heartbeat(const boost::system::error_code& e);
+
+    // Unsubscribe and end the body, the connection waits for the next
+    // request
+    void end_events();
+
+    // The value of a Last-Event-ID header, false if there is none
+    static bool last_event_id(const http::server::request& req
+      ,boost::uint64_t& id);
+
+    pubsub_hub* hub_;
+    event_history* history_;
+
+    /// The body of the event stream, null when none is open.
+    http::server::chunk_writer_ptr writer_;
+
+    /// The last event replayed from history_, live events up to it being
+    /// dropped.
+    boost::uint64_t last_id_;
+
+    /// Events published while the write of sending_ is in flight, and
+    /// whether anything was written since the last heartbeat.
+    std::string queued_;
+    std::string sending_;
+    bool writing_;
+    bool sent_;
+
+    boost::asio::deadline_timer heartbeat_timer_;
+  };
+
+} // namespace splice
+
+#if defined(SPLICE_HEADER_ONLY)
+# include "sse_session.hxx"
+#endif // defined(SPLICE_HEADER_ONLY)
+
+#endif // HTTP_SSE_SESSION_HPP
@@ -0,0 +1,268 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include "sse_session.hpp"
+#include <vector>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/bind.hpp>
+#include <boost/asio/placeholders.hpp>
+
+namespace splice
+{
+
+  template <typename up_t,typename log_t>
+  sse_session<up_t,log_t>::sse_session
+    (socket_t& socket
+    ,http::server::request_handler& handler
+    ,pubsub_hub& hub
+    ,event_history* history)
+    :base_t(socket,handler)
+    ,hub_(&hub)
+    ,history_(history)
+    ,last_id_(0)
+    ,writing_(false)
+    ,sent_(false)
+    ,heartbeat_timer_(get_io_service())
+  {
+  }
+
+  template <typename up_t,typename log_t>
+  sse_session<up_t,log_t>::sse_session
+    (socket_t& socket
+    ,http::server::router& router
+    ,pubsub_hub& hub
+    ,event_history* history)
+    :base_t(socket,router)
+    ,hub_(&hub)
+    ,history_(history)
+    ,last_id_(0)
+    ,writing_(false)
+    ,sent_(false)
+    ,heartbeat_timer_(get_io_service())
+  {
+  }
+
+  template <typename up_t,typename log_t>
+  void sse_session<up_t,log_t>::on_publish(const publication& pub)
+  {
+    // may be called from any thread, the stream belongs to the strand;
+    // posted, never run within event_history::publish and its lock
+    get_strand().post(boost::bind(&sse_session::push_event,sp_cast_up(),
+      pub.encoded<sse_event>(),pub.id()));
+  }
+
+  template <typename up_t,typename log_t>
+  bool sse_session<up_t,log_t>::event_stream_topic(
+    const http::server::request&,
+    std::string&)
+  {
+    return false;
+  }
+
+  template <typename up_t,typename log_t>
+  boost::posix_time::time_duration sse_session<up_t,log_t>::heartbeat_interval()
+  {
+    return boost::posix_time::seconds(15);
+  }
+
+  template <typename up_t,typename log_t>
+  std::size_t sse_session<up_t,log_t>::max_queued_size()
+  {
+    return 1024*1024;
+  }
+
+  template <typename up_t,typename log_t>
+  void sse_session<up_t,log_t>::handle_request(
+    const http::server::request& req,
+    http::server::reply& rep)
+  {
+    using namespace http::server;
+    using boost::algorithm::iequals;
+    using boost::algorithm::icontains;
+
+    bool accepted=false;
+    for(auto& h:req.headers)
+      if(iequals(h.name,"Accept")&&icontains(h.value,"text/event-stream"))
+        accepted=true;
+
+    std::string topic;
+    if(writer_||req.method!="GET"||!accepted
+      ||!cast_up()->event_stream_topic(req,topic))
+    {
+      base_t::handle_request(req,rep);
+      return;
+    }
+
+    log_info(EZ_FLFT,"event stream of "+topic);
+    rep.status=reply::ok;
+    rep.headers.resize(3);
+    rep.headers[0].name="Content-Type";
+    rep.headers[0].value="text/event-stream";
+    rep.headers[1].name="Cache-Control";
+    rep.headers[1].value="no-cache";
+    // a buffering reverse proxy, nginx, would hold the events back
+    rep.headers[2].name="X-Accel-Buffering";
+    rep.headers[2].value="no";
+
+    // the session is alive when its reply starts streaming
+    boost::uint64_t id=0;
+    const bool resume=last_event_id(req,id);
+    rep.stream=[this,topic,id,resume](const chunk_writer_ptr& writer)
+    {
+      start_events(writer,topic,id,resume);
+    };
+  }
+
+  template <typename up_t,typename log_t>
+  void sse_session<up_t,log_t>::start_events(
+    const http::server::chunk_writer_ptr& writer,
+    const std::string& topic,
+    boost::uint64_t last_event_id,
+    bool resume)
+  {
+    writer_=writer;
+    last_id_=0;
+    sent_=false;
+
+    // subscribed first, the events published while replaying arrive
+    // after the replayed ones and are dropped up to last_id_
+    hub_->subscribe(sp_cast_up(),topic);
+    if(resume&&history_)
+    {
+      std::vector<http::server::event_ptr> events;
+      last_id_=history_->replay(last_event_id,topic,events);
+      for(auto& e:events)
+        queued_+=*e;
+      write_events();
+    }
+
+    heartbeat_timer_.expires_from_now(cast_up()->heartbeat_interval());
+    heartbeat_timer_.async_wait(get_strand().wrap(
+      boost::bind(&sse_session::on_heartbeat,shared_from_this(),
+      boost::asio::placeholders::error)));
+  }
+
+  template <typename up_t,typename log_t>
+  void sse_session<up_t,log_t>::push_event(
+    const http::server::event_ptr& event,
+    boost::uint64_t id)
+  {
+    if(!writer_||(id&&id<=last_id_))
+      return;
+
+    if(queued_.size()+event->size()>cast_up()->max_queued_size())
+    {
+      log_warning(EZ_FLFT,"event stream client too slow");
+      end_events();
+      return;
+    }
+
+    queued_+=*event;
+    write_events();
+  }
+
+  template <typename up_t,typename log_t>
+  void sse_session<up_t,log_t>::write_events()
+  {
+    if(writing_||queued_.empty())
+      return;
+
+    // everything queued goes in a single chunk
+    sending_.swap(queued_);
+    queued_.clear();
+    writing_=true;
+    sent_=true;
+    writer_->async_write(boost::asio::buffer(sending_),
+      boost::bind(&sse_session::on_events_written,shared_from_this(),_1));
+  }
+
+  template <typename up_t,typename log_t>
+  void sse_session<up_t,log_t>::on_events_written(
+    const boost::system::error_code& e)
+  {
+    writing_=false;
+    sending_.clear();
+    if(e)
+    {
+      log_trace(EZ_FLFT,e.message());
+      end_events();
+      return;
+    }
+    if(writer_)
+      write_events();
+  }
+
+  template <typename up_t,typename log_t>
+  void sse_session<up_t,log_t>::on_heartbeat(
+    const boost::system::error_code& e)
+  {
+    if(e||!writer_)
+      return;
+
+    // a comment line, ignored by the client
+    if(!sent_)
+    {
+      queued_+=":\n\n";
+      write_events();
+    }
+    sent_=false;
+
+    heartbeat_timer_.expires_from_now(cast_up()->heartbeat_interval());
+    heartbeat_timer_.async_wait(get_strand().wrap(
+      boost::bind(&sse_session::on_heartbeat,shared_from_this(),
+      boost::asio::placeholders::error)));
+  }
+
+  template <typename up_t,typename log_t>
+  void sse_session<up_t,log_t>::end_events()
+  {
+    if(!writer_)
+      return;
+
+    hub_->unsubscribe(sp_cast_up());
+    boost::system::error_code ignored_ec;
+    heartbeat_timer_.cancel(ignored_ec);
+    queued_.clear();
+
+    // the writer holds the session, released along with it
+    http::server::chunk_writer_ptr writer;
+    writer.swap(writer_);
+    writer->close();
+  }
+
+  template <typename up_t,typename log_t>
+  bool sse_session<up_t,log_t>::last_event_id(
+    const http::server::request& req,
+    boost::uint64_t& id)
+  {
+    using boost::algorithm::iequals;
+
+    for(auto& h:req.headers)
+      if(iequals(h.name,"Last-Event-ID"))
+      {
+        if(h.value.empty()||h.value.size()>19)
+          return false;
+        id=0;
+        for(auto c:h.value)
+        {
+          if(c<'0'||c>'9')
+            return false;
+          id=id*10+(c-'0');
+        }
+        return true;
+      }
+    return false;
+  }
+
+} // namespace splice
@@ -0,0 +1,62 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef HTTP_VALIDATORS_HPP
+#define HTTP_VALIDATORS_HPP
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include <ctime>
+#include <string>
+#include <boost/cstdint.hpp>
+
+namespace http {
+namespace server {
+
+struct request;
+
+/// Validators of a served file, answering conditional requests
+/// (RFC 7232) so that a client holding a fresh copy gets a bodiless 304.
+namespace validators {
+
+/// Strong entity tag, quoted, of a file of size bytes modified at
+/// modified. A coding other than identity is appended, each coding of
+/// a file being a different representation.
+std::string etag(boost::uint64_t size, std::time_t modified,
+    const char* coding = 0);
+
+/// Format a time as an HTTP-date, e.g. "Sun, 06 Nov 1994 08:49:37 GMT".
+std::string http_date(std::time_t time);
+
+/// Parse an HTTP-date in the IMF-fixdate format, the obsolete formats
+/// being refused.
+bool parse_http_date(const std::string& in, std::time_t& time);
+
+/// Whether a GET or HEAD request holds a fresh copy, If-None-Match being
+/// evaluated first, If-Modified-Since only in its absence.
+bool not_modified(const request& req, const std::string& etag,
+    std::time_t last_modified);
+
+/// Whether the Range of a request applies, i.e. it has no If-Range or the
+/// If-Range validator still matches, strongly.
+bool if_range(const request& req, const std::string& etag,
+    std::time_t last_modified);
+
+} // namespace validators
+} // namespace server
+} // namespace http
+
+#if defined(SPLICE_HEADER_ONLY)
+# include "validators.hxx"
+#endif
+
+#endif // HTTP_VALIDATORS_HPP
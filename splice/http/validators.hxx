@@ -0,0 +1,172 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include "validators.hpp"
+#include <cstdio>
+#include <cstring>
+#include <boost/algorithm/string.hpp>
+#include "request.hpp"
+
+namespace http {
+namespace server {
+namespace validators {
+
+namespace detail {
+
+const char* const day_names[] =
+  { "Thu", "Fri", "Sat", "Sun", "Mon", "Tue", "Wed" }; // 1970-01-01 was a Thursday
+const char* const month_names[] =
+  { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+// Days since 1970-01-01 of a proleptic Gregorian date, neither gmtime nor
+// timegm being both thread safe and portable.
+boost::int64_t days_from_civil(boost::int64_t y, unsigned m, unsigned d)
+{
+  y -= m <= 2;
+  const boost::int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned yoe = static_cast<unsigned>(y - era * 400);
+  const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<boost::int64_t>(doe) - 719468;
+}
+
+void civil_from_days(boost::int64_t z, boost::int64_t& y, unsigned& m, unsigned& d)
+{
+  z += 719468;
+  const boost::int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+  const unsigned doe = static_cast<unsigned>(z - era * 146097);
+  const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const unsigned mp = (5 * doy + 2) / 153;
+  d = doy - (153 * mp + 2) / 5 + 1;
+  m = mp < 10 ? mp + 3 : mp - 9;
+  y = static_cast<boost::int64_t>(yoe) + era * 400 + (m <= 2);
+}
+
+const std::string* find_header(const request& req, const char* name)
+{
+  for (std::size_t i = 0; i < req.headers.size(); ++i)
+    if (boost::iequals(req.headers[i].name, name))
+      return &req.headers[i].value;
+  return 0;
+}
+
+} // namespace detail
+
+std::string etag(boost::uint64_t size, std::time_t modified, const char* coding)
+{
+  char buffer[64];
+  const int n = std::sprintf(buffer, "\"%llx-%llx%s%s\"",
+      static_cast<unsigned long long>(modified),
+      static_cast<unsigned long long>(size),
+      coding ? "-" : "", coding ? coding : "");
+  return std::string(buffer, n);
+}
+
+std::string http_date(std::time_t time)
+{
+  const boost::int64_t t = static_cast<boost::int64_t>(time);
+  boost::int64_t days = t / 86400;
+  boost::int64_t seconds = t % 86400;
+  if (seconds < 0)
+  {
+    seconds += 86400;
+    --days;
+  }
+  boost::int64_t year;
+  unsigned month, day;
+  detail::civil_from_days(days, year, month, day);
+
+  char buffer[32];
+  const int n = std::sprintf(buffer, "%s, %02u %s %04d %02d:%02d:%02d GMT",
+      detail::day_names[((days % 7) + 7) % 7], day,
+      detail::month_names[month - 1], static_cast<int>(year), static_cast<int>(seconds / 3600),
+      static_cast<int>(seconds / 60 % 60), static_cast<int>(seconds % 60));
+  return std::string(buffer, n);
+}
+
+bool parse_http_date(const std::string& in, std::time_t& time)
+{
+  char weekday[4], month_name[4];
+  int day, year, hour, minute, second;
+  char gmt[4];
+  if (std::sscanf(in.c_str(), "%3s, %d %3s %d %d:%d:%d %3s", weekday, &day,
+      month_name, &year, &hour, &minute, &second, gmt) != 8
+      || std::strcmp(gmt, "GMT") != 0)
+    return false;
+
+  unsigned month = 0;
+  while (month < 12 && std::strcmp(detail::month_names[month], month_name) != 0)
+    ++month;
+  if (month == 12 || day < 1 || day > 31 || year < 1970 || hour > 23
+      || minute > 59 || second > 60)
+    return false;
+
+  time = static_cast<std::time_t>(
+      detail::days_from_civil(year, month + 1, static_cast<unsigned>(day)) * 86400
+      + hour * 3600 + minute * 60 + second);
+  return true;
+}
+
+bool not_modified(const request& req, const std::string& etag,
+    std::time_t last_modified)
+{
+  if (req.method != "GET" && req.method != "HEAD")
+    return false;
+
+  // weak comparison, a W/ prefix is ignored
+  if (const std::string* if_none_match =
+      detail::find_header(req, "If-None-Match"))
+  {
+    std::vector<std::string> tags;
+    boost::algorithm::split(tags, *if_none_match, boost::is_any_of(","));
+    for (std::size_t i = 0; i < tags.size(); ++i)
+    {
+      std::string& tag = tags[i];
+      boost::algorithm::trim(tag);
+      if (boost::starts_with(tag, "W/"))
+        tag.erase(0, 2);
+      if (tag == "*" || (!etag.empty() && tag == etag))
+        return true;
+    }
+    return false;
+  }
+
+  // a date in the future is invalid and ignored
+  std::time_t since;
+  if (const std::string* if_modified_since =
+      detail::find_header(req, "If-Modified-Since"))
+    return parse_http_date(*if_modified_since, since)
+      && since <= std::time(0) && last_modified <= since;
+  return false;
+}
+
+bool if_range(const request& req, const std::string& etag,
+    std::time_t last_modified)
+{
+  const std::string* value = detail::find_header(req, "If-Range");
+  if (!value)
+    return true;
+
+  // an entity tag, compared strongly, or else a date
+  if (boost::starts_with(*value, "\"") || boost::starts_with(*value, "W/"))
+    return !etag.empty() && *value == etag;
+  std::time_t date;
+  return parse_http_date(*value, date) && date == last_modified;
+}
+
+} // namespace validators
+} // namespace server
+} // namespace http
@@ -0,0 +1,160 @@
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef PORTABLE_BINARY_ARCHIVE_HPP
+#define PORTABLE_BINARY_ARCHIVE_HPP
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "detail/config.hpp"
+
+#include <istream>
+#include <ostream>
+#include <string>
+
+#include <boost/cstdint.hpp>
+#include <boost/archive/basic_archive.hpp>
+#include <boost/archive/detail/common_iarchive.hpp>
+#include <boost/archive/detail/common_oarchive.hpp>
+#include <boost/archive/detail/register_archive.hpp>
+
+namespace splice
+{
+
+  // Binary archives readable on any platform, whatever its byte order and
+  // the size of its integers: an integer is written as a byte holding its
+  // sign and its count of significant bytes, then these bytes, least
+  // significant first, so that small values, as the class ids and the
+  // sizes of the serialization library, take one or two bytes.
+  // float and double are written as their IEEE 754 representation.
+  // Wide strings are not supported.
+  class portable_binary_oarchive
+    :public boost::archive::detail::common_oarchive<portable_binary_oarchive>
+  {
+  public:
+    using base_t=boost::archive::detail::common_oarchive<portable_binary_oarchive>;
+
+    // Unless flags has boost::archive::no_header, the archive starts with
+    // the signature and the version of the serialization library.
+    explicit portable_binary_oarchive(std::ostream& os,unsigned flags=0);
+
+    // Primitives, called by the serialization library
+    template<class T>
+    void save(const T& t)
+    {
+      save_integer(static_cast<boost::intmax_t>(t));
+    }
+
+    void save(const float& t);
+    void save(const double& t);
+    void save(const std::string& t);
+
+    void save_binary(const void* address,std::size_t count);
+
+#if BOOST_VERSION<105900
+    template<class T>
+    void save_override(T& t,BOOST_PFTO int)
+    {
+      base_t::save_override(t,0);
+    }
+
+    void save_override(const boost::archive::class_name_type& t,int);
+
+    // ids of optional class information aren't written, as for
+    // binary_oarchive
+    void save_override(const boost::archive::class_id_optional_type&,int)
+    {
+    }
+#else
+    template<class T>
+    void save_override(T& t)
+    {
+      base_t::save_override(t);
+    }
+
+    void save_override(const boost::archive::class_name_type& t);
+
+    void save_override(const boost::archive::class_id_optional_type&)
+    {
+    }
+#endif
+
+  private:
+    void save_integer(boost::intmax_t value);
+
+    std::streambuf& sb_;
+  };
+
+  class portable_binary_iarchive
+    :public boost::archive::detail::common_iarchive<portable_binary_iarchive>
+  {
+  public:
+    using base_t=boost::archive::detail::common_iarchive<portable_binary_iarchive>;
+
+    // flags are those the archive was written with
+    explicit portable_binary_iarchive(std::istream& is,unsigned flags=0);
+
+    // Primitives, called by the serialization library
+    template<class T>
+    void load(T& t)
+    {
+      t=static_cast<T>(load_integer());
+    }
+
+    void load(bool& t);
+    void load(boost::archive::class_id_type& t);
+    void load(float& t);
+    void load(double& t);
+    void load(std::string& t);
+
+    void load_binary(void* address,std::size_t count);
+
+#if BOOST_VERSION<105900
+    template<class T>
+    void load_override(T& t,BOOST_PFTO int)
+    {
+      base_t::load_override(t,0);
+    }
+
+    void load_override(boost::archive::class_name_type& t,int);
+
+    void load_override(boost::archive::class_id_optional_type&,int)
+    {
+    }
+#else
+    template<class T>
+    void load_override(T& t)
+    {
+      base_t::load_override(t);
+    }
+
+    void load_override(boost::archive::class_name_type& t);
+
+    void load_override(boost::archive::class_id_optional_type&)
+    {
+    }
+#endif
+
+  private:
+    boost::intmax_t load_integer();
+
+    std::streambuf& sb_;
+  };
+
+} // namespace splice {
+
+BOOST_SERIALIZATION_REGISTER_ARCHIVE(splice::portable_binary_oarchive)
+BOOST_SERIALIZATION_REGISTER_ARCHIVE(splice::portable_binary_iarchive)
+
+#if defined(SPLICE_HEADER_ONLY)
+# include "portable_binary_archive.hxx"
+#endif // defined(SPLICE_HEADER_ONLY)
+
+#endif // #ifndef PORTABLE_BINARY_ARCHIVE_HPP
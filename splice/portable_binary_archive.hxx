@@ -0,0 +1,232 @@
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "detail/config.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <boost/archive/archive_exception.hpp>
+#include <boost/serialization/throw_exception.hpp>
+#include <boost/archive/impl/archive_serializer_map.ipp>
+
+#include "portable_binary_archive.hpp"
+
+namespace splice
+{
+
+  portable_binary_oarchive::portable_binary_oarchive(std::ostream& os,unsigned flags)
+    :base_t(flags)
+    ,sb_(*os.rdbuf())
+  {
+    if(flags&boost::archive::no_header)
+      return;
+
+    const std::string signature(boost::archive::BOOST_ARCHIVE_SIGNATURE());
+    save(signature);
+    save(boost::archive::library_version_type(boost::archive::BOOST_ARCHIVE_VERSION()));
+  }
+
+  void portable_binary_oarchive::save(const float& t)
+  {
+    BOOST_STATIC_ASSERT(sizeof(float)==4);
+    boost::uint32_t bits;
+    std::memcpy(&bits,&t,sizeof(bits));
+    unsigned char bytes[4];
+    for(unsigned i=0; i<sizeof(bytes); i++)
+      bytes[i]=static_cast<unsigned char>(bits>>(8*i));
+    save_binary(bytes,sizeof(bytes));
+  }
+
+  void portable_binary_oarchive::save(const double& t)
+  {
+    BOOST_STATIC_ASSERT(sizeof(double)==8);
+    boost::uint64_t bits;
+    std::memcpy(&bits,&t,sizeof(bits));
+    unsigned char bytes[8];
+    for(unsigned i=0; i<sizeof(bytes); i++)
+      bytes[i]=static_cast<unsigned char>(bits>>(8*i));
+    save_binary(bytes,sizeof(bytes));
+  }
+
+  void portable_binary_oarchive::save(const std::string& t)
+  {
+    save_integer(static_cast<boost::intmax_t>(t.size()));
+    save_binary(t.data(),t.size());
+  }
+
+  void portable_binary_oarchive::save_binary(const void* address,std::size_t count)
+  {
+    const std::streamsize n=sb_.sputn(static_cast<const char*>(address),
+      static_cast<std::streamsize>(count));
+    if(n!=static_cast<std::streamsize>(count))
+      boost::serialization::throw_exception(boost::archive::archive_exception(
+        boost::archive::archive_exception::output_stream_error));
+  }
+
+#if BOOST_VERSION<105900
+  void portable_binary_oarchive::save_override(
+    const boost::archive::class_name_type& t,int)
+#else
+  void portable_binary_oarchive::save_override(
+    const boost::archive::class_name_type& t)
+#endif
+  {
+    const std::string name(t);
+    save(name);
+  }
+
+  void portable_binary_oarchive::save_integer(boost::intmax_t value)
+  {
+    // the magnitude, computed unsigned so that the smallest value fits
+    const bool negative=value<0;
+    boost::uintmax_t magnitude=negative
+      ?0-static_cast<boost::uintmax_t>(value):static_cast<boost::uintmax_t>(value);
+
+    unsigned char bytes[1+sizeof(boost::uintmax_t)];
+    unsigned char size=0;
+    while(magnitude)
+    {
+      bytes[1+size++]=static_cast<unsigned char>(magnitude);
+      magnitude>>=8;
+    }
+    bytes[0]=size|(negative?0x80:0);
+    save_binary(bytes,1+size);
+  }
+
+  portable_binary_iarchive::portable_binary_iarchive(std::istream& is,unsigned flags)
+    :base_t(flags)
+    ,sb_(*is.rdbuf())
+  {
+    if(flags&boost::archive::no_header)
+      return;
+
+    std::string signature;
+    load(signature);
+    if(signature!=boost::archive::BOOST_ARCHIVE_SIGNATURE())
+      boost::serialization::throw_exception(boost::archive::archive_exception(
+        boost::archive::archive_exception::invalid_signature));
+
+    boost::archive::library_version_type version;
+    load(version);
+    if(boost::archive::BOOST_ARCHIVE_VERSION()<version)
+      boost::serialization::throw_exception(boost::archive::archive_exception(
+        boost::archive::archive_exception::unsupported_version));
+    set_library_version(version);
+  }
+
+  void portable_binary_iarchive::load(bool& t)
+  {
+    t=load_integer()!=0;
+  }
+
+  void portable_binary_iarchive::load(boost::archive::class_id_type& t)
+  {
+    t=boost::archive::class_id_type(static_cast<int>(load_integer()));
+  }
+
+  void portable_binary_iarchive::load(float& t)
+  {
+    unsigned char bytes[4];
+    load_binary(bytes,sizeof(bytes));
+    boost::uint32_t bits=0;
+    for(unsigned i=0; i<sizeof(bytes); i++)
+      bits|=static_cast<boost::uint32_t>(bytes[i])<<(8*i);
+    std::memcpy(&t,&bits,sizeof(t));
+  }
+
+  void portable_binary_iarchive::load(double& t)
+  {
+    unsigned char bytes[8];
+    load_binary(bytes,sizeof(bytes));
+    boost::uint64_t bits=0;
+    for(unsigned i=0; i<sizeof(bytes); i++)
+      bits|=static_cast<boost::uint64_t>(bytes[i])<<(8*i);
+    std::memcpy(&t,&bits,sizeof(t));
+  }
+
+  void portable_binary_iarchive::load(std::string& t)
+  {
+    const boost::intmax_t size=load_integer();
+    if(size<0)
+      boost::serialization::throw_exception(boost::archive::archive_exception(
+        boost::archive::archive_exception::input_stream_error));
+
+    // grown as the bytes arrive, a corrupted size fails on the stream end
+    // rather than on a huge allocation
+    t.clear();
+    char buffer[4096];
+    for(boost::uintmax_t left=static_cast<boost::uintmax_t>(size); left;)
+    {
+      const std::size_t n=static_cast<std::size_t>(
+        (std::min)(left,static_cast<boost::uintmax_t>(sizeof(buffer))));
+      load_binary(buffer,n);
+      t.append(buffer,n);
+      left-=n;
+    }
+  }
+
+  void portable_binary_iarchive::load_binary(void* address,std::size_t count)
+  {
+    const std::streamsize n=sb_.sgetn(static_cast<char*>(address),
+      static_cast<std::streamsize>(count));
+    if(n!=static_cast<std::streamsize>(count))
+      boost::serialization::throw_exception(boost::archive::archive_exception(
+        boost::archive::archive_exception::input_stream_error));
+  }
+
+#if BOOST_VERSION<105900
+  void portable_binary_iarchive::load_override(
+    boost::archive::class_name_type& t,int)
+#else
+  void portable_binary_iarchive::load_override(
+    boost::archive::class_name_type& t)
+#endif
+  {
+    std::string name;
+    load(name);
+    if(name.size()>BOOST_SERIALIZATION_MAX_KEY_SIZE-1)
+      boost::serialization::throw_exception(boost::archive::archive_exception(
+        boost::archive::archive_exception::invalid_class_name));
+    std::memcpy(t,name.data(),name.size());
+    t.t[name.size()]='\0';
+  }
+
+  boost::intmax_t portable_binary_iarchive::load_integer()
+  {
+    unsigned char head;
+    load_binary(&head,1);
+    const unsigned size=head&0x7f;
+    if(size>sizeof(boost::uintmax_t))
+      boost::serialization::throw_exception(boost::archive::archive_exception(
+        boost::archive::archive_exception::input_stream_error));
+
+    unsigned char bytes[sizeof(boost::uintmax_t)];
+    load_binary(bytes,size);
+    boost::uintmax_t magnitude=0;
+    for(unsigned i=size; i--;)
+      magnitude=(magnitude<<8)|bytes[i];
+    return static_cast<boost::intmax_t>((head&0x80)?0-magnitude:magnitude);
+  }
+
+} // namespace splice {
+
+namespace boost {
+namespace archive {
+namespace detail {
+
+  template class archive_serializer_map<splice::portable_binary_oarchive>;
+  template class archive_serializer_map<splice::portable_binary_iarchive>;
+
+} // namespace detail
+} // namespace archive
+} // namespace boost
@@ -0,0 +1,331 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUBSUB_HUB_HPP
+#define PUBSUB_HUB_HPP
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "detail/config.hpp"
+
+#include <string>
+#include <vector>
+
+#include <boost/array.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+namespace splice
+{
+
+  // A message published on a topic, given to the on_publish function of
+  // every subscriber. All subscribers are called from the publishing
+  // thread, a session must hand the message over to its own strand.
+  class publication
+    : private boost::noncopyable
+  {
+  public:
+    // id numbers the message as a server-sent event, see event_history,
+    // 0 when it is published on the hub only
+    publication(const std::string& topic,const std::string& message
+      ,boost::uint64_t id=0)
+      :topic_(topic)
+      ,message_(message)
+      ,id_(id)
+      ,encoding_count_(0)
+    {
+    }
+
+    const std::string& topic() const
+    {
+      return topic_;
+    }
+
+    const std::string& message() const
+    {
+      return message_;
+    }
+
+    boost::uint64_t id() const
+    {
+      return id_;
+    }
+
+    // The message encoded by encoder_t on first call, then shared by every
+    // subscriber of the same transport. The hub knows no transport, each
+    // one provides its encoder, see ws_text_frame and sse_event:
+    //   struct encoder_t
+    //   {
+    //     typedef boost::shared_ptr<const T> type;
+    //     static type encode(const publication& pub);
+    //   };
+    template<typename encoder_t>
+    typename encoder_t::type encoded() const
+    {
+      using element_t=typename encoder_t::type::element_type;
+
+      void* key=&encoding_key<encoder_t>::value;
+      for(std::size_t i=0; i<encoding_count_; i++)
+        if(encodings_[i].key_==key)
+          return boost::static_pointer_cast<element_t>(encodings_[i].value_);
+
+      typename encoder_t::type value(encoder_t::encode(*this));
+      if(encoding_count_<encodings_.size())
+      { // beyond, encoded for each subscriber
+        encodings_[encoding_count_].key_=key;
+        encodings_[encoding_count_].value_=value;
+        encoding_count_++;
+      }
+      return value;
+    }
+
+  private:
+    // One per encoder, its address identifies the encoding, not const
+    // so that identical constants can't be folded by the linker
+    template<typename encoder_t>
+    struct encoding_key
+    {
+      static char value;
+    };
+
+    struct encoding
+    {
+      void* key_;
+      boost::shared_ptr<const void> value_;
+    };
+
+    const std::string& topic_;
+    const std::string& message_;
+    const boost::uint64_t id_;
+    mutable boost::array<encoding,4> encodings_;
+    mutable std::size_t encoding_count_;
+  };
+
+  template<typename encoder_t>
+  char publication::encoding_key<encoder_t>::value=0;
+
+  // Topic based publish/subscribe between sessions of any kind.
+  // A subscriber is a session exposing a public
+  //   void on_publish(const publication& pub);
+  // ws_session and tcp_session provide one, that simply writes the message,
+  // sse_session writes it as a server-sent event.
+  // A topic ending with '*' subscribes to every topic starting with what
+  // precedes the '*', "news.*" receives "news.sport" and "news.weather".
+  //
+  // Subscribers are spread over shards by session, each shard holding an
+  // immutable snapshot replaced on every (un)subscription. Publishing only
+  // loads the snapshots, it never waits on a subscription or on another
+  // publisher. Sessions are held by weak pointer and forgotten once destroyed.
+  class pubsub_hub
+    : private boost::noncopyable
+  {
+  public:
+    // 0 shards means one per hardware thread
+    explicit pubsub_hub(unsigned shard_count=0)
+      :shard_count_(shard_count?shard_count:
+        (std::max)(boost::thread::hardware_concurrency(),1u))
+      ,shards_(new shard[shard_count_])
+    {
+      for(unsigned i=0; i<shard_count_; i++)
+        shards_[i].snapshot_=boost::make_shared<const snapshot>();
+    }
+
+    template<typename session_t>
+    void subscribe(const boost::shared_ptr<session_t>& session,
+      const std::string& topic)
+    {
+      subscriber s;
+      s.owner_=session.get();
+      s.session_=session;
+      s.prefix_=!topic.empty()&&topic[topic.size()-1]=='*';
+      s.topic_=s.prefix_?topic.substr(0,topic.size()-1):topic;
+      s.deliver_=deliver<session_t>(session);
+
+      shard& sh=get_shard(s.owner_);
+      boost::lock_guard<boost::mutex> lock(sh.mutex_);
+      boost::shared_ptr<snapshot> next(boost::make_shared<snapshot>(
+        *boost::atomic_load(&sh.snapshot_)));
+      if(s.prefix_)
+        next->prefixes_.push_back(s);
+      else
+        next->topics_[s.topic_].push_back(s);
+      boost::atomic_store(&sh.snapshot_,
+        boost::shared_ptr<const snapshot>(next));
+    }
+
+    // Unsubscribe from one topic, given as it was subscribed
+    template<typename session_t>
+    void unsubscribe(const boost::shared_ptr<session_t>& session,
+      const std::string& topic)
+    {
+      remove(session.get(),&topic);
+    }
+
+    // Unsubscribe from all topics
+    template<typename session_t>
+    void unsubscribe(const boost::shared_ptr<session_t>& session)
+    {
+      remove(session.get(),0);
+    }
+
+    // Deliver message to every subscriber of topic, returns
+    // the number of subscribers reached.
+    std::size_t publish(const std::string& topic,const std::string& message)
+    {
+      return publish(publication(topic,message));
+    }
+
+    std::size_t publish(const publication& pub)
+    {
+      const std::string& topic=pub.topic();
+      std::size_t count=0;
+
+      for(unsigned i=0; i<shard_count_; i++)
+      {
+        const boost::shared_ptr<const snapshot> snap(
+          boost::atomic_load(&shards_[i].snapshot_));
+        bool gone=false;
+
+        auto it=snap->topics_.find(topic);
+        if(it!=snap->topics_.end())
+          for(auto& s:it->second)
+            deliver_to(s,pub,count,gone);
+
+        for(auto& s:snap->prefixes_)
+          if(topic.compare(0,s.topic_.size(),s.topic_)==0)
+            deliver_to(s,pub,count,gone);
+
+        if(gone)
+          remove(0,0,i); // forget destroyed sessions
+      }
+
+      return count;
+    }
+
+  private:
+    // Calls on_publish on a living session, returns false
+    // once the session has been destroyed
+    template<typename session_t>
+    struct deliver
+    {
+      deliver(const boost::shared_ptr<session_t>& session)
+        :session_(session)
+      {
+      }
+
+      bool operator()(const publication& pub) const
+      {
+        boost::shared_ptr<session_t> session(session_.lock());
+        if(!session)
+          return false;
+        session->on_publish(pub);
+        return true;
+      }
+
+      boost::weak_ptr<session_t> session_;
+    };
+
+    struct subscriber
+    {
+      const void* owner_;
+      boost::weak_ptr<void> session_;
+      bool prefix_;
+      std::string topic_;
+      boost::function<bool(const publication&)> deliver_;
+    };
+
+    using subscribers_t=std::vector<subscriber>;
+
+    struct snapshot
+    {
+      boost::unordered_map<std::string,subscribers_t> topics_;
+      subscribers_t prefixes_;
+    };
+
+    struct shard
+    {
+      boost::mutex mutex_;
+      boost::shared_ptr<const snapshot> snapshot_;
+    };
+
+    shard& get_shard(const void* owner)
+    {
+      return shards_[boost::hash<const void*>()(owner)%shard_count_];
+    }
+
+    static void deliver_to(const subscriber& s,const publication& pub,
+      std::size_t& count,bool& gone)
+    {
+      if(s.deliver_(pub))
+        count++;
+      else
+        gone=true;
+    }
+
+    // Remove the subscriptions of owner to topic, all topics when null,
+    // then the destroyed sessions of the shard.
+    void remove(const void* owner,const std::string* topic)
+    {
+      remove(owner,topic,
+        static_cast<unsigned>(&get_shard(owner)-shards_.get()));
+    }
+
+    void remove(const void* owner,const std::string* topic,unsigned index)
+    {
+      shard& sh=shards_[index];
+      boost::lock_guard<boost::mutex> lock(sh.mutex_);
+      const boost::shared_ptr<const snapshot> current(
+        boost::atomic_load(&sh.snapshot_));
+
+      boost::shared_ptr<snapshot> next(boost::make_shared<snapshot>());
+      for(auto& t:current->topics_)
+      {
+        subscribers_t kept(keep(t.second,owner,topic));
+        if(!kept.empty())
+          next->topics_[t.first].swap(kept);
+      }
+      next->prefixes_=keep(current->prefixes_,owner,topic);
+
+      boost::atomic_store(&sh.snapshot_,
+        boost::shared_ptr<const snapshot>(next));
+    }
+
+    static subscribers_t keep(const subscribers_t& subscribers,
+      const void* owner,const std::string* topic)
+    {
+      subscribers_t kept;
+      kept.reserve(subscribers.size());
+      for(auto& s:subscribers)
+      {
+        const bool removed=owner==s.owner_&&(!topic||
+          (s.prefix_?*topic==s.topic_+'*':*topic==s.topic_));
+        if(!removed&&!s.session_.expired())
+          kept.push_back(s);
+      }
+      return kept;
+    }
+
+    const unsigned shard_count_;
+    boost::scoped_array<shard> shards_;
+  };
+
+} // namespace splice {
+
+#endif // #ifndef PUBSUB_HUB_HPP
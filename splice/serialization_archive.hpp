@@ -0,0 +1,67 @@
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef SERIALIZATION_ARCHIVE_HPP
+#define SERIALIZATION_ARCHIVE_HPP
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "detail/config.hpp"
+
+#include <boost/archive/basic_archive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/text_oarchive.hpp>
+
+#include "portable_binary_archive.hpp"
+
+namespace splice
+{
+
+  // Archive policies of serialization_engine and serialization_session,
+  // the archives a message is written with and read from, and their flags.
+  // Both ends of a connection must use the same policy, a server chooses
+  // it per port, or per handshake in a multi protocol server, through the
+  // session class it builds.
+  // Archives of polymorphic messages must be registered, their header
+  // included before BOOST_CLASS_EXPORT.
+
+  // Integers in decimal, readable but the slowest to write and to parse,
+  // a header on every message. The default.
+  struct text_archive
+  {
+    using oarchive_t=boost::archive::text_oarchive;
+    using iarchive_t=boost::archive::text_iarchive;
+    static const unsigned flags=0;
+  };
+
+  // Memory images of the primitives, the fastest, between builds sharing
+  // the byte order, the size of integers and the version of the
+  // serialization library, hence without any header.
+  struct binary_archive
+  {
+    using oarchive_t=boost::archive::binary_oarchive;
+    using iarchive_t=boost::archive::binary_iarchive;
+    static const unsigned flags=boost::archive::no_header;
+  };
+
+  // Compact integers of any byte order, see portable_binary_oarchive, a
+  // header telling the version of the serialization library that wrote it.
+  struct portable_binary_archive
+  {
+    using oarchive_t=portable_binary_oarchive;
+    using iarchive_t=portable_binary_iarchive;
+    static const unsigned flags=0;
+  };
+
+} // namespace splice {
+
+#endif // #ifndef SERIALIZATION_ARCHIVE_HPP
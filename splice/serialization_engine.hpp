@@ -16,6 +16,7 @@
 #endif
 #include "detail/config.hpp"
 
+#include "serialization_archive.hpp"
 #include "tcp_session.hpp"
 
 #include <boost/tuple/tuple.hpp>
@@ -24,12 +25,15 @@ namespace splice
 {
 
   /// Represents a single connection from a client.
-  template <typename up_t,typename msg_t,typename log_t=no_log>
+  /// archive_t, see serialization_archive.hpp, is the archive the messages
+  /// are written with, the one the peer reads them with.
+  template <typename up_t,typename msg_t,typename log_t=no_log
+    ,typename archive_t=text_archive>
   class serialization_engine : public tcp_session<up_t,log_t>
   {
   public:
     using base_t=tcp_session<up_t,log_t>;
-    using my_t=serialization_engine<up_t,msg_t,log_t>;
+    using my_t=serialization_engine<up_t,msg_t,log_t,archive_t>;
     using msg_ptr=boost::shared_ptr<msg_t>;
     using write_tuple_t=boost::tuple<msg_ptr, std::string, std::string>;
     using write_tuple_ptr=boost::shared_ptr<write_tuple_t>;
@@ -98,8 +102,9 @@ namespace splice
 
   };
 
-  template <typename up_t,typename msg_t,typename log_t=no_log>
-  using ser_eng_base=serialization_engine<up_t,msg_t,log_t>;
+  template <typename up_t,typename msg_t,typename log_t=no_log
+    ,typename archive_t=text_archive>
+  using ser_eng_base=serialization_engine<up_t,msg_t,log_t,archive_t>;
 
 } // namespace splice {
 
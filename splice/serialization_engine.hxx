@@ -32,8 +32,6 @@
 #include <boost/archive/iterators/insert_linebreaks.hpp>
 #include <boost/archive/iterators/transform_width.hpp>
 #include <boost/archive/iterators/ostream_iterator.hpp>
-#include <boost/archive/text_iarchive.hpp>
-#include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/iterators/base64_from_binary.hpp>
 #include <boost/archive/iterators/insert_linebreaks.hpp>
 #include <boost/archive/iterators/transform_width.hpp>
@@ -41,36 +39,33 @@
 
 #include <boost/serialization/shared_ptr.hpp>
 
-//#include <boost/archive/binary_iarchive.hpp> TODO
-//#include <boost/archive/binary_oarchive.hpp>
-
 #include "serialization_engine.hpp"
 
 namespace splice
 {
 
   /// Represents a single connection from a client.
-  template <typename up_t,typename msg_t,typename below_t>
-  serialization_engine<up_t,msg_t,below_t>::serialization_engine(boost::asio::io_service& io_service)
+  template <typename up_t,typename msg_t,typename below_t,typename archive_t>
+  serialization_engine<up_t,msg_t,below_t,archive_t>::serialization_engine(boost::asio::io_service& io_service)
     : base_t(io_service)
   {
   }
 
-  template <typename up_t,typename msg_t,typename below_t>
-  serialization_engine<up_t,msg_t,below_t>::serialization_engine(socket_t& socket)
+  template <typename up_t,typename msg_t,typename below_t,typename archive_t>
+  serialization_engine<up_t,msg_t,below_t,archive_t>::serialization_engine(socket_t& socket)
     :base_t(socket)
   {
   }
 
-  template <typename up_t,typename msg_t,typename below_t>
-  void serialization_engine<up_t,msg_t,below_t>::on_read_struct(msg_ptr msg)
+  template <typename up_t,typename msg_t,typename below_t,typename archive_t>
+  void serialization_engine<up_t,msg_t,below_t,archive_t>::on_read_struct(msg_ptr msg)
   {
     BOOST_STATIC_ASSERT_MSG(false,
       "on_read_struct function must be defined in a server derived class");
   }
 
-  template <typename up_t,typename msg_t,typename below_t>
-  void serialization_engine<up_t,msg_t,below_t>::handle_read(msg_ptr,const boost::system::error_code& error)
+  template <typename up_t,typename msg_t,typename below_t,typename archive_t>
+  void serialization_engine<up_t,msg_t,below_t,archive_t>::handle_read(msg_ptr,const boost::system::error_code& error)
   {
     if(error)
     {
@@ -79,8 +74,8 @@ namespace splice
     }
   }
 
-  template <typename up_t,typename msg_t,typename below_t>
-  void serialization_engine<up_t,msg_t,below_t>::handle_read_dataframe(
+  template <typename up_t,typename msg_t,typename below_t,typename archive_t>
+  void serialization_engine<up_t,msg_t,below_t,archive_t>::handle_read_dataframe(
     incoming_data_ptr incoming_data,
     const boost::system::error_code& error,
     std::size_t bytes_transferred)
@@ -90,8 +85,8 @@ namespace splice
     async_read();
   }
 
-  template <typename up_t,typename msg_t,typename below_t>
-  void serialization_engine<up_t,msg_t,below_t>::async_write_struct(msg_ptr msg)
+  template <typename up_t,typename msg_t,typename below_t,typename archive_t>
+  void serialization_engine<up_t,msg_t,below_t,archive_t>::async_write_struct(msg_ptr msg)
   {
     namespace ph=boost::asio::placeholders;
     namespace ba=boost::asio;
@@ -100,7 +95,7 @@ namespace splice
 
     // Serialize the data first so we know how large it is.
     std::ostringstream archive_stream;
-    boost::archive::text_oarchive archive(archive_stream);
+    typename archive_t::oarchive_t archive(archive_stream,archive_t::flags);
     archive<<msg;
     std::string& outbound_data=boost::get<1>(*wt)=archive_stream.str();
 
@@ -127,15 +122,15 @@ namespace splice
       ph::error,wt)));
   }
 
-  template <typename up_t,typename msg_t,typename below_t>
-  void serialization_engine<up_t,msg_t,below_t>::on_write_struct(const boost::system::error_code& ec,write_tuple_ptr wt)
+  template <typename up_t,typename msg_t,typename below_t,typename archive_t>
+  void serialization_engine<up_t,msg_t,below_t,archive_t>::on_write_struct(const boost::system::error_code& ec,write_tuple_ptr wt)
   {
     if(ec)
       cast_up()->on_error_code(EZ_FLF,ec);
   }
 
-  template <typename up_t,typename msg_t,typename below_t>
-  void serialization_engine<up_t,msg_t,below_t>::async_read()
+  template <typename up_t,typename msg_t,typename below_t,typename archive_t>
+  void serialization_engine<up_t,msg_t,below_t,archive_t>::async_read()
   {
     namespace ph=boost::asio::placeholders;
     namespace ba=boost::asio;
@@ -150,8 +145,8 @@ namespace splice
       ph::bytes_transferred)));
   }
 
-  template <typename up_t,typename msg_t,typename below_t>
-  void serialization_engine<up_t,msg_t,below_t>::on_read_header(
+  template <typename up_t,typename msg_t,typename below_t,typename archive_t>
+  void serialization_engine<up_t,msg_t,below_t,archive_t>::on_read_header(
     boost::shared_ptr<std::vector<char>> inbound_header,
     const boost::system::error_code& ec, // Result of operation.
     std::size_t bytes_transferred)           // Number of bytes read.
@@ -193,8 +188,8 @@ namespace splice
       ph::bytes_transferred)));
   }
 
-  template <typename up_t,typename msg_t,typename below_t>
-  void serialization_engine<up_t,msg_t,below_t>::on_read_data(
+  template <typename up_t,typename msg_t,typename below_t,typename archive_t>
+  void serialization_engine<up_t,msg_t,below_t,archive_t>::on_read_data(
     boost::shared_ptr<std::vector<char>> inbound_data,
     const boost::system::error_code& ec, // Result of operation.
     std::size_t bytes_transferred)           // Number of bytes read.
@@ -212,7 +207,7 @@ namespace splice
     {
       std::string archive_data(inbound_data->begin(),inbound_data->end());
       std::istringstream archive_stream(archive_data);
-      boost::archive::text_iarchive archive(archive_stream);
+      typename archive_t::iarchive_t archive(archive_stream,archive_t::flags);
       archive>>msg;
     }
     catch(std::exception& ex)
@@ -226,8 +221,8 @@ namespace splice
     cast_up()->on_read_struct(msg);
   }
 
-  template <typename up_t,typename msg_t,typename below_t>
-  void serialization_engine<up_t,msg_t,below_t>::on_error_ex_ec(std::exception& ex,const boost::system::error_code& ec)
+  template <typename up_t,typename msg_t,typename below_t,typename archive_t>
+  void serialization_engine<up_t,msg_t,below_t,archive_t>::on_error_ex_ec(std::exception& ex,const boost::system::error_code& ec)
   {
   }
 
@@ -24,13 +24,16 @@ namespace splice
   // TODO must be able to serialize msg_t, not only msg_ptr
 
   /// Represents a single connection from a client.
-  template <typename up_t,typename msg_t,typename log_t=no_log>
+  /// archive_t, see serialization_archive.hpp, is the archive the messages
+  /// are written with, the one the peer reads them with.
+  template <typename up_t,typename msg_t,typename log_t=no_log
+    ,typename archive_t=text_archive>
   class serialization_session
-    : public ser_eng_base<up_t,msg_t,log_t>
+    : public ser_eng_base<up_t,msg_t,log_t,archive_t>
   {
   public:
-    using base_t=ser_eng_base<up_t,msg_t,log_t>;
-    using my_t=serialization_session<up_t,msg_t,log_t>;
+    using base_t=ser_eng_base<up_t,msg_t,log_t,archive_t>;
+    using my_t=serialization_session<up_t,msg_t,log_t,archive_t>;
 
     serialization_session(boost::asio::io_service& io_service);
 
@@ -38,6 +41,11 @@ namespace splice
 
     void on_read(msg_ptr msg);
 
+    // Called by pubsub_hub from the publishing thread, must be defined
+    // in a derived class subscribing to a hub, to turn the message
+    // into a msg_t.
+    void on_publish(const publication& pub);
+
   protected:
 
     void on_handshake_success();
@@ -21,34 +21,41 @@
 namespace splice
 {
 
-    template <typename up_t,typename msg_t,typename log_t>
-    serialization_session<up_t,msg_t,log_t>::serialization_session(boost::asio::io_service& io_service)
+    template <typename up_t,typename msg_t,typename log_t,typename archive_t>
+    serialization_session<up_t,msg_t,log_t,archive_t>::serialization_session(boost::asio::io_service& io_service)
       :base_t(io_service)
     {
     }
 
-    template <typename up_t,typename msg_t,typename log_t>
-    serialization_session<up_t,msg_t,log_t>::serialization_session(socket_t& socket)
+    template <typename up_t,typename msg_t,typename log_t,typename archive_t>
+    serialization_session<up_t,msg_t,log_t,archive_t>::serialization_session(socket_t& socket)
       :base_t(socket)
     {
     }
 
-    template <typename up_t,typename msg_t,typename log_t>
-    void serialization_session<up_t,msg_t,log_t>::on_read(msg_ptr msg)
+    template <typename up_t,typename msg_t,typename log_t,typename archive_t>
+    void serialization_session<up_t,msg_t,log_t,archive_t>::on_read(msg_ptr msg)
     {
       BOOST_STATIC_ASSERT_MSG(false,
         "on_read function must be defined in a server derived class");
     }
 
-    template <typename up_t,typename msg_t,typename log_t>
-    void serialization_session<up_t,msg_t,log_t>::on_handshake_success()
+    template <typename up_t,typename msg_t,typename log_t,typename archive_t>
+    void serialization_session<up_t,msg_t,log_t,archive_t>::on_publish(const publication& pub)
+    {
+      BOOST_STATIC_ASSERT_MSG(false,
+        "on_publish function must be defined in a derived class subscribing to a pubsub_hub");
+    }
+
+    template <typename up_t,typename msg_t,typename log_t,typename archive_t>
+    void serialization_session<up_t,msg_t,log_t,archive_t>::on_handshake_success()
     {
       log_trace(EZ_FLFT,"");
       async_read();
     }
 
-    template <typename up_t,typename msg_t,typename log_t>
-    void serialization_session<up_t,msg_t,log_t>::handle_read(msg_ptr, const boost::system::error_code& error)
+    template <typename up_t,typename msg_t,typename log_t,typename archive_t>
+    void serialization_session<up_t,msg_t,log_t,archive_t>::handle_read(msg_ptr, const boost::system::error_code& error)
     {
       if (error)
       {
@@ -57,8 +64,8 @@ namespace splice
       }
     }
 
-    template <typename up_t,typename msg_t,typename log_t>
-    void serialization_session<up_t,msg_t,log_t>::handle_read_dataframe(
+    template <typename up_t,typename msg_t,typename log_t,typename archive_t>
+    void serialization_session<up_t,msg_t,log_t,archive_t>::handle_read_dataframe(
       incoming_data_ptr incoming_data,
       const boost::system::error_code& error,
       std::size_t bytes_transferred)
@@ -68,15 +75,15 @@ namespace splice
       cast_up()->async_read();
     }
 
-    template <typename up_t,typename msg_t,typename log_t>
-    void serialization_session<up_t,msg_t,log_t>::async_write(msg_ptr msg)
+    template <typename up_t,typename msg_t,typename log_t,typename archive_t>
+    void serialization_session<up_t,msg_t,log_t,archive_t>::async_write(msg_ptr msg)
     {
       cast_up()->async_write(msg,&up_t::on_write);
     }
     
-    template <typename up_t,typename msg_t,typename log_t>
+    template <typename up_t,typename msg_t,typename log_t,typename archive_t>
     template<typename func_t>
-    void serialization_session<up_t,msg_t,log_t>::async_write(msg_ptr msg,func_t on_write_func)
+    void serialization_session<up_t,msg_t,log_t,archive_t>::async_write(msg_ptr msg,func_t on_write_func)
     {
       namespace ba = boost::asio;
       namespace ph = ba::placeholders;
@@ -85,7 +92,7 @@ namespace splice
 
       // Serialize the data first so we know how large it is.
       std::ostringstream archive_stream;
-      boost::archive::text_oarchive archive(archive_stream);
+      typename archive_t::oarchive_t archive(archive_stream,archive_t::flags);
       archive << msg;
       std::string& outbound_data = boost::get<1>(*wt) = archive_stream.str();
 
@@ -112,22 +119,22 @@ namespace splice
         ph::error, wt)));
     }
 
-    template <typename up_t,typename msg_t,typename log_t>
-    void serialization_session<up_t,msg_t,log_t>::on_write(const boost::system::error_code& ec, write_tuple_ptr wt)
+    template <typename up_t,typename msg_t,typename log_t,typename archive_t>
+    void serialization_session<up_t,msg_t,log_t,archive_t>::on_write(const boost::system::error_code& ec, write_tuple_ptr wt)
     {
       msg_ptr msg=boost::get<0>(*wt);
       cast_up()->on_write_msg(ec,msg);
     }
 
-    template <typename up_t,typename msg_t,typename log_t>
-    void serialization_session<up_t,msg_t,log_t>::on_write_msg(const boost::system::error_code& ec,msg_ptr msg)
+    template <typename up_t,typename msg_t,typename log_t,typename archive_t>
+    void serialization_session<up_t,msg_t,log_t,archive_t>::on_write_msg(const boost::system::error_code& ec,msg_ptr msg)
     {
       if (ec)
         cast_up()->on_error_code(EZ_FLF,ec);
     }
 
-    template <typename up_t,typename msg_t,typename log_t>
-    void serialization_session<up_t,msg_t,log_t>::async_read()
+    template <typename up_t,typename msg_t,typename log_t,typename archive_t>
+    void serialization_session<up_t,msg_t,log_t,archive_t>::async_read()
     {
       log_trace(EZ_FLFT,"");
 
@@ -145,8 +152,8 @@ namespace splice
         ph::bytes_transferred)));
     }
 
-    template <typename up_t,typename msg_t,typename log_t>
-    void serialization_session<up_t,msg_t,log_t>::on_read_header(
+    template <typename up_t,typename msg_t,typename log_t,typename archive_t>
+    void serialization_session<up_t,msg_t,log_t,archive_t>::on_read_header(
       boost::shared_ptr<std::vector<char>> inbound_header,
       const boost::system::error_code& ec, // Result of operation.
       std::size_t bytes_transferred)       // Number of bytes read.
@@ -186,8 +193,8 @@ namespace splice
         ph::bytes_transferred)));
     }
 
-    template <typename up_t,typename msg_t,typename log_t>
-    void serialization_session<up_t,msg_t,log_t>::on_read_data(
+    template <typename up_t,typename msg_t,typename log_t,typename archive_t>
+    void serialization_session<up_t,msg_t,log_t,archive_t>::on_read_data(
       boost::shared_ptr<std::vector<char>> inbound_data,
       const boost::system::error_code& ec, // Result of operation.
       std::size_t bytes_transferred)  // Number of bytes read.
@@ -207,7 +214,7 @@ namespace splice
       {
         std::string archive_data(inbound_data->begin(), inbound_data->end());
         std::istringstream archive_stream(archive_data);
-        boost::archive::text_iarchive archive(archive_stream);
+        typename archive_t::iarchive_t archive(archive_stream,archive_t::flags);
         archive >> msg;
       }
       catch (std::exception& ex)
@@ -223,8 +230,8 @@ namespace splice
       cast_up()->on_read(msg);
     }
 
-    template <typename up_t,typename msg_t,typename log_t>
-    void serialization_session<up_t,msg_t,log_t>::on_error_ex_ec(std::exception& ex, const boost::system::error_code& ec)
+    template <typename up_t,typename msg_t,typename log_t,typename archive_t>
+    void serialization_session<up_t,msg_t,log_t,archive_t>::on_error_ex_ec(std::exception& ex, const boost::system::error_code& ec)
     {
     }
 
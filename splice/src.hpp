@@ -9,14 +9,23 @@
 # error Do not compile Splice library source with SPLICE_HEADER_ONLY defined
 #endif
 
+#include "http/body_parser.hxx"
+#include "http/date_cache.hxx"
+#include "http/file_cache.hxx"
+#include "http/h2_session.hxx"
+#include "http/hpack.hxx"
 #include "http/http_session.hxx"
 #include "http/mime_types.hxx"
 #include "http/reply.hxx"
 #include "http/request_handler.hxx"
-#include "http/request_parser.hxx"
+#include "http/router.hxx"
+#include "http/sse_session.hxx"
+#include "http/validators.hxx"
+#include "portable_binary_archive.hxx"
 #include "tcp_session.hxx"
 #include "web_socket/ws_session.hxx"
 #include "web_socket/ws_handshake.hxx"
+#include "web_socket/ws_client_session.hxx"
 #include "serialization_session.hxx"
 #include "serialization_engine.hxx"
 #include "ez_server.hxx"
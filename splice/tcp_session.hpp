@@ -18,6 +18,9 @@
 #include "common_types.hpp"
 #include "logger/log_interface.hpp"
 
+#include <deque>
+
+#include <boost/function.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/enable_shared_from_this.hpp>
@@ -26,6 +29,8 @@
 namespace splice
 {
 
+  class publication;
+
   /// Represents a single connection from a client.
   template <typename up_t,typename log_t=no_log>
   class tcp_session
@@ -55,6 +60,10 @@ namespace splice
 
     boost::asio::io_service& get_io_service() BOOST_NOEXCEPT;
 
+    // Called by pubsub_hub from the publishing thread,
+    // the message is queued and written as is.
+    void on_publish(const publication& pub)BOOST_NOEXCEPT;
+
   protected:
 
     // Start the first asynchronous operation for a mono protocol server
@@ -125,6 +134,8 @@ namespace splice
 
     void on_read_string(std::string& msg)BOOST_NOEXCEPT;
 
+    // Queue msg, from any thread, messages are written one at a time
+    // in the order they are queued.
     void async_write(const std::string& msg)BOOST_NOEXCEPT;
 
     template<typename func_t>
@@ -152,6 +163,22 @@ namespace splice
     friend class mono_protocol;
 
   private:
+    using write_handler_t=boost::function<void(const error_code&)>;
+
+    // A message waiting in the outbound queue
+    struct outbound_message
+    {
+      boost::shared_ptr<std::string> msg_;
+      write_handler_t on_write_;
+    };
+
+    // Outbound queue operations, all run on the strand
+    void enqueue_message(const outbound_message& msg)BOOST_NOEXCEPT;
+
+    void write_next()BOOST_NOEXCEPT;
+
+    void on_write_queue(const error_code& error)BOOST_NOEXCEPT;
+
     void log_constructor(const char* file,unsigned line,const char* func)BOOST_NOEXCEPT;
 
     boost::asio::deadline_timer handshake_timeout_;
@@ -163,6 +190,10 @@ namespace splice
     socket_t socket_;
     boost::mutex mutex_socket_;
 
+    // Messages are written one at a time, in order, from the front of
+    // the queue, the front message being the one currently written.
+    std::deque<outbound_message> write_queue_;
+
   }; //class tcp_session
 
 } // namespace splice {
@@ -13,6 +13,7 @@
 #include "detail/config.hpp"
 
 #include "tcp_session.hpp"
+#include "pubsub_hub.hpp"
 
 #include <boost/bind.hpp>
 #include <boost/bind/protect.hpp>
@@ -306,10 +307,50 @@ namespace splice
 
     log_trace(EZ_FLFT,"");
 
+    // built apart, a bind expression given to bind would be
+    // evaluated instead of being stored
     boost::shared_ptr<std::string> str(boost::make_shared<std::string>(msg));
-    ba::async_write(get_socket(),ba::buffer(str->c_str(),str->length()),
-      get_strand().wrap(bind(on_write_func,sp_cast_up(),
-      str,ba::placeholders::error)));
+    outbound_message out={str,write_handler_t(bind(on_write_func,sp_cast_up(),
+      str,ba::placeholders::error))};
+
+    // may be called from any thread, the queue belongs to the strand
+    get_strand().dispatch(boost::bind(&my_t::enqueue_message,sp_cast_up(),
+      out));
+  }
+
+  template <typename up_t,typename log_t>
+  void tcp_session<up_t,log_t>::enqueue_message(const outbound_message& msg)
+  {
+    write_queue_.push_back(msg);
+    if(write_queue_.size()==1)
+      write_next();
+  }
+
+  template <typename up_t,typename log_t>
+  void tcp_session<up_t,log_t>::write_next()
+  {
+    namespace ba=boost::asio;
+
+    const std::string& front=*write_queue_.front().msg_;
+    ba::async_write(get_socket(),ba::buffer(front.c_str(),front.length()),
+      get_strand().wrap(boost::bind(&my_t::on_write_queue,sp_cast_up(),
+      ba::placeholders::error)));
+  }
+
+  template <typename up_t,typename log_t>
+  void tcp_session<up_t,log_t>::on_write_queue(const error_code& error)
+  {
+    outbound_message done(write_queue_.front());
+    write_queue_.pop_front();
+
+    // the messages behind a failed one are dropped
+    if(error)
+      write_queue_.clear();
+    else if(!write_queue_.empty())
+      write_next();
+
+    // last, the handler may queue another message
+    done.on_write_(error);
   }
 
   template <typename up_t,typename log_t>
@@ -321,6 +362,13 @@ namespace splice
       cast_up()->on_error_code(EZ_FLF,error);
   }
 
+  template <typename up_t,typename log_t>
+  void tcp_session<up_t,log_t>::on_publish(const publication& pub)
+  {
+    // queued behind the messages being written, never interleaved
+    async_write(pub.message());
+  }
+
   template <typename up_t,typename log_t>
   void tcp_session<up_t,log_t>::on_handshake_timeout(
     const error_code& error)
@@ -0,0 +1,434 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+// permessage-deflate extension, compression of web socket messages
+// http://tools.ietf.org/html/rfc7692
+//
+// zlib is required, define SPLICE_HAS_ZLIB and link with zlib
+// to enable that extension, otherwise it is never negotiated.
+
+#ifndef WEBSOCKET_PERMESSAGE_DEFLATE_HPP
+#define WEBSOCKET_PERMESSAGE_DEFLATE_HPP
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/algorithm/string/trim.hpp>
+
+#if defined(SPLICE_HAS_ZLIB)
+# include <zlib.h>
+#endif
+
+namespace splice
+{
+
+  // Server side configuration of permessage-deflate, returned by the
+  // deflate_config() CRTP function of a web socket session.
+  // A smaller window or no context takeover trades compression ratio
+  // against memory, each compressor holds about 2^(window bits+2) bytes
+  // and each decompressor 2^window bits.
+  struct deflate_options
+  {
+    // Accept the extension when offered by the client
+    bool enabled_;
+
+    // Reset the compressor after each message
+    bool server_no_context_takeover_;
+
+    // Ask the client to reset its compressor after each message
+    bool client_no_context_takeover_;
+
+    // LZ77 window size of the compressor, 9 to 15
+    unsigned server_max_window_bits_;
+
+    // Maximum window the client compressor may use, 8 to 15,
+    // only applied when the client offers client_max_window_bits
+    unsigned client_max_window_bits_;
+
+    // zlib compression level, 0 to 9, or -1 for zlib default
+    int compression_level_;
+
+    // zlib memory level, 1 to 9
+    int mem_level_;
+
+    // Messages smaller than threshold_ bytes are sent uncompressed
+    std::size_t threshold_;
+
+    // Larger decompressed messages are rejected
+    std::size_t max_inflated_size_;
+
+    deflate_options()
+      :enabled_(false)
+      ,server_no_context_takeover_(false)
+      ,client_no_context_takeover_(false)
+      ,server_max_window_bits_(15)
+      ,client_max_window_bits_(15)
+      ,compression_level_(-1)
+      ,mem_level_(8)
+      ,threshold_(64)
+      ,max_inflated_size_(16*1024*1024)
+    {
+    }
+  };
+
+  // Parameters agreed with a client during the handshake
+  struct deflate_params
+  {
+    bool accepted_;
+    bool server_no_context_takeover_;
+    bool client_no_context_takeover_;
+    unsigned server_max_window_bits_;
+    unsigned client_max_window_bits_;
+
+    // The Sec-WebSocket-Extensions value sent back to the client
+    std::string response_;
+
+    deflate_params()
+      :accepted_(false)
+      ,server_no_context_takeover_(false)
+      ,client_no_context_takeover_(false)
+      ,server_max_window_bits_(15)
+      ,client_max_window_bits_(15)
+    {
+    }
+
+    // Select the first acceptable offer of a Sec-WebSocket-Extensions
+    // header value, as "permessage-deflate; client_max_window_bits, ..."
+    // Returns false when no offer can be accepted.
+    bool negotiate(const std::string& offers,const deflate_options& options)
+    {
+      *this=deflate_params();
+
+#if defined(SPLICE_HAS_ZLIB)
+      if(!options.enabled_)
+        return false;
+
+      std::string::size_type begin=0;
+      while(begin<=offers.size())
+      {
+        std::string::size_type end=offers.find(',',begin);
+        if(end==std::string::npos)
+          end=offers.size();
+
+        if(accept_offer(offers.substr(begin,end-begin),options))
+          return accepted_=true;
+
+        *this=deflate_params();
+        begin=end+1;
+      }
+#endif // defined(SPLICE_HAS_ZLIB)
+      return false;
+    }
+
+  private:
+    static bool to_window_bits(const std::string& value,unsigned& bits)
+    {
+      if(value.size()<1||value.size()>2
+        ||value.find_first_not_of("0123456789")!=std::string::npos)
+        return false;
+      bits=boost::lexical_cast<unsigned>(value);
+      return bits>=8&&bits<=15;
+    }
+
+    bool accept_offer(const std::string& offer,const deflate_options& options)
+    {
+      using boost::algorithm::trim_copy;
+      using boost::lexical_cast;
+
+      bool server_bits_requested=false;
+      bool client_bits_offered=false;
+      unsigned client_bits=15;
+
+      std::string::size_type begin=0;
+      for(unsigned i=0; begin<=offer.size(); i++)
+      {
+        std::string::size_type end=offer.find(';',begin);
+        if(end==std::string::npos)
+          end=offer.size();
+        const std::string param=trim_copy(offer.substr(begin,end-begin));
+        begin=end+1;
+
+        if(i==0)
+        { // extension name
+          if(param!="permessage-deflate")
+            return false;
+          continue;
+        }
+
+        std::string name(param),value;
+        const std::string::size_type eq=param.find('=');
+        if(eq!=std::string::npos)
+        {
+          name=trim_copy(param.substr(0,eq));
+          value=trim_copy(param.substr(eq+1));
+          if(value.size()>=2&&value[0]=='"'&&value[value.size()-1]=='"')
+            value=value.substr(1,value.size()-2);
+        }
+
+        if(name=="server_no_context_takeover")
+        {
+          if(eq!=std::string::npos||server_no_context_takeover_)
+            return false;
+          server_no_context_takeover_=true;
+        }
+        else if(name=="client_no_context_takeover")
+        {
+          if(eq!=std::string::npos||client_no_context_takeover_)
+            return false;
+          client_no_context_takeover_=true;
+        }
+        else if(name=="server_max_window_bits")
+        {
+          unsigned bits=0;
+          // zlib deflate can't use a window of 8 bits, decline
+          if(server_bits_requested||!to_window_bits(value,bits)||bits<9)
+            return false;
+          server_bits_requested=true;
+          server_max_window_bits_=bits;
+        }
+        else if(name=="client_max_window_bits")
+        {
+          if(client_bits_offered
+            ||(eq!=std::string::npos&&!to_window_bits(value,client_bits)))
+            return false;
+          client_bits_offered=true;
+        }
+        else // unknown parameter, decline that offer
+          return false;
+      }
+
+      // Apply server configuration on client offer
+      if(options.server_no_context_takeover_)
+        server_no_context_takeover_=true;
+      if(options.client_no_context_takeover_)
+        client_no_context_takeover_=true;
+
+      const unsigned server_bits=
+        std::max(9u,std::min(15u,options.server_max_window_bits_));
+      server_max_window_bits_=server_bits_requested?
+        std::min(server_max_window_bits_,server_bits):server_bits;
+
+      // The client window can only be limited when client offers it
+      client_max_window_bits_=client_bits_offered?
+        std::max(8u,std::min(client_bits,options.client_max_window_bits_)):15;
+
+      response_="permessage-deflate";
+      if(server_no_context_takeover_)
+        response_+="; server_no_context_takeover";
+      if(client_no_context_takeover_)
+        response_+="; client_no_context_takeover";
+      if(server_bits_requested)
+        response_+="; server_max_window_bits="
+          +lexical_cast<std::string>(server_max_window_bits_);
+      if(client_bits_offered&&client_max_window_bits_<15)
+        response_+="; client_max_window_bits="
+          +lexical_cast<std::string>(client_max_window_bits_);
+
+      return true;
+    }
+  };
+
+  // Compressor and decompressor of a web socket session, built when
+  // the extension has been negotiated.
+  class permessage_deflate
+    : private boost::noncopyable
+  {
+  public:
+    permessage_deflate(const deflate_params& params,
+      const deflate_options& options)
+      :params_(params)
+      ,threshold_(options.threshold_)
+      ,max_inflated_size_(options.max_inflated_size_)
+      ,deflate_ok_(false)
+      ,inflate_ok_(false)
+      ,too_big_(false)
+    {
+#if defined(SPLICE_HAS_ZLIB)
+      deflate_stream_=z_stream();
+      inflate_stream_=z_stream();
+
+      // negative window bits is raw deflate, without zlib header,
+      // zlib does not support a window of 8 bits in deflate.
+      deflate_ok_=deflateInit2(&deflate_stream_,
+        options.compression_level_,Z_DEFLATED,
+        -static_cast<int>(std::max(9u,params_.server_max_window_bits_)),
+        options.mem_level_,Z_DEFAULT_STRATEGY)==Z_OK;
+
+      // a larger window than the client one always decodes
+      inflate_ok_=inflateInit2(&inflate_stream_,
+        -static_cast<int>(std::max(9u,params_.client_max_window_bits_)))==Z_OK;
+#endif // defined(SPLICE_HAS_ZLIB)
+    }
+
+    ~permessage_deflate()
+    {
+#if defined(SPLICE_HAS_ZLIB)
+      if(deflate_ok_)
+        deflateEnd(&deflate_stream_);
+      if(inflate_ok_)
+        inflateEnd(&inflate_stream_);
+#endif // defined(SPLICE_HAS_ZLIB)
+    }
+
+    const deflate_params& params() const
+    {
+      return params_;
+    }
+
+    // Compress a message payload in place, returns false when the payload
+    // must be sent uncompressed (below threshold or compressor failure).
+    // Thread safe, but with context takeover messages must be written
+    // in the order they have been compressed.
+    bool deflate(std::vector<boost::uint8_t>& payload)
+    {
+#if defined(SPLICE_HAS_ZLIB)
+      if(payload.size()<threshold_)
+        return false;
+
+      boost::lock_guard<boost::mutex> lock(deflate_mutex_);
+      if(!deflate_ok_)
+        return false;
+
+      std::vector<boost::uint8_t> out(payload.size()/2+64);
+      deflate_stream_.next_in=payload.empty()?Z_NULL:&payload[0];
+      deflate_stream_.avail_in=static_cast<uInt>(payload.size());
+      std::size_t produced=0;
+      do
+      {
+        if(produced==out.size())
+          out.resize(out.size()*2);
+        deflate_stream_.next_out=&out[produced];
+        deflate_stream_.avail_out=static_cast<uInt>(out.size()-produced);
+        const int rc=::deflate(&deflate_stream_,Z_SYNC_FLUSH);
+        produced=out.size()-deflate_stream_.avail_out;
+        if(rc!=Z_OK&&rc!=Z_BUF_ERROR)
+        { // stream state is lost, no more compression
+          deflate_ok_=false;
+          deflateEnd(&deflate_stream_);
+          return false;
+        }
+      }
+      while(deflate_stream_.avail_out==0);
+
+      // RFC 7692 7.2.1, remove the 4 octets 0x00 0x00 0xff 0xff
+      // of the empty deflate block terminating the sync flush
+      if(produced>=4)
+        produced-=4;
+      out.resize(produced);
+
+      if(params_.server_no_context_takeover_)
+        deflateReset(&deflate_stream_);
+
+      payload.swap(out);
+      return true;
+#else
+      return false;
+#endif // defined(SPLICE_HAS_ZLIB)
+    }
+
+    // Decompress a message payload in place, returns false when the
+    // payload is invalid or, see too_big, larger than max_size or
+    // max_inflated_size_.
+    // Not thread safe, called from the session reading strand.
+    bool inflate(std::vector<boost::uint8_t>& payload,
+      std::size_t max_size=(std::numeric_limits<std::size_t>::max)())
+    {
+      too_big_=false;
+#if defined(SPLICE_HAS_ZLIB)
+      if(!inflate_ok_)
+        return false;
+      // one byte more than the limit tells a larger message
+      const std::size_t limit=std::min(std::min(max_size,max_inflated_size_),
+        (std::numeric_limits<std::size_t>::max)()-1);
+
+      // RFC 7692 7.2.2, append the 4 octets removed by the compressor
+      static const boost::uint8_t tail[]={0x00,0x00,0xff,0xff};
+      payload.insert(payload.end(),tail,tail+sizeof(tail));
+
+      std::vector<boost::uint8_t> out(std::min<std::size_t>(
+        payload.size()*4+64,limit+1));
+      inflate_stream_.next_in=&payload[0];
+      inflate_stream_.avail_in=static_cast<uInt>(payload.size());
+      std::size_t produced=0;
+      for(;;)
+      {
+        inflate_stream_.next_out=&out[produced];
+        inflate_stream_.avail_out=static_cast<uInt>(out.size()-produced);
+        const int rc=::inflate(&inflate_stream_,Z_SYNC_FLUSH);
+        produced=out.size()-inflate_stream_.avail_out;
+        if(produced>limit)
+        {
+          too_big_=true;
+          return false;
+        }
+        if(rc!=Z_OK&&rc!=Z_BUF_ERROR&&rc!=Z_STREAM_END)
+          return false;
+        if(rc==Z_STREAM_END)
+        { // final block, the appended octets are not part of the stream
+          inflateReset(&inflate_stream_);
+          break;
+        }
+        if(inflate_stream_.avail_in==0&&inflate_stream_.avail_out!=0)
+          break;
+        if(inflate_stream_.avail_out==0)
+          out.resize(std::min(out.size()*2,limit+1));
+        else if(rc==Z_BUF_ERROR)
+          return false; // no progress, truncated data
+      }
+      out.resize(produced);
+
+      if(params_.client_no_context_takeover_)
+        inflateReset(&inflate_stream_);
+
+      payload.swap(out);
+      return true;
+#else
+      return false;
+#endif // defined(SPLICE_HAS_ZLIB)
+    }
+
+    // True when the last inflate failed on a message too large
+    bool too_big() const
+    {
+      return too_big_;
+    }
+
+  private:
+    const deflate_params params_;
+    const std::size_t threshold_;
+    const std::size_t max_inflated_size_;
+
+    bool deflate_ok_;
+    bool inflate_ok_;
+    bool too_big_;
+    boost::mutex deflate_mutex_;
+#if defined(SPLICE_HAS_ZLIB)
+    z_stream deflate_stream_;
+    z_stream inflate_stream_;
+#endif // defined(SPLICE_HAS_ZLIB)
+  };
+
+  using permessage_deflate_ptr=boost::shared_ptr<permessage_deflate>;
+
+} // namespace splice {
+
+#endif // #ifndef WEBSOCKET_PERMESSAGE_DEFLATE_HPP
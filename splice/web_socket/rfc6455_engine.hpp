@@ -20,6 +20,9 @@
 #endif
 #include "../detail/config.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -44,6 +47,11 @@
 #include <boost/archive/iterators/ostream_iterator.hpp>
 #include <boost/lexical_cast.hpp>
 
+#include "../http/basic_request_parser.hpp"
+#include "../http/request_view.hpp"
+#include "permessage_deflate.hpp"
+#include "utf8_validator.hpp"
+
 namespace splice
 {
 
@@ -151,6 +159,15 @@ namespace splice
     public:
       /// Handle a request and produce a reply.
       static reply handle_request(const request& req)
+      {
+        deflate_params params;
+        return handle_request(req, deflate_options(), params);
+      }
+
+      /// Handle a request and produce a reply, negotiating
+      /// permessage-deflate when offered by the client and enabled.
+      static reply handle_request(const request& req,
+        const deflate_options& options, deflate_params& params)
       {
         auto it = find_if(req.headers.cbegin(), req.headers.cend(), [](const header& i) {return i.name == "Sec-WebSocket-Key"; });
 
@@ -161,13 +178,31 @@ namespace splice
 
         const std::string magic_guid("258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
 
-        reply rep(reply::switching_protocols, 3);
+        // Extension offers may be split over several header lines
+        std::string offers;
+        for (auto h = req.headers.cbegin(); h != req.headers.cend(); h++)
+        {
+          if (h->name != "Sec-WebSocket-Extensions")
+            continue;
+          if (!offers.empty())
+            offers += ',';
+          offers += h->value;
+        }
+
+        const bool deflate = !offers.empty() && params.negotiate(offers, options);
+
+        reply rep(reply::switching_protocols, deflate ? 4 : 3);
         rep.headers_[0].name = "Upgrade";
         rep.headers_[0].value = "websocket";
         rep.headers_[1].name = "Connection";
         rep.headers_[1].value = "Upgrade";
         rep.headers_[2].name = "Sec-WebSocket-Accept";
         rep.headers_[2].value = to_base64(to_sha1(key + magic_guid));
+        if (deflate)
+        {
+          rep.headers_[3].name = "Sec-WebSocket-Extensions";
+          rep.headers_[3].value = params.response_;
+        }
 
         return rep;
       }
@@ -222,367 +257,241 @@ namespace splice
 
     };
 
-    /// Parser for incoming requests.
-    class request_parser
+    /// The reply to an upgrade request, built straight from the received
+    /// bytes into a single fixed buffer. The accept key is hashed and
+    /// encoded on the stack and the reply itself is a session member, so
+    /// nothing is allocated unless permessage-deflate is enabled and
+    /// offered by the client.
+    class upgrade_reply
+      : private boost::noncopyable
     {
     public:
-      /// Construct ready to parse the request method.
-      request_parser()
-        : state_(method_start)
-      {
-      }
+      using status_type = reply::status_type;
 
+      /// Room for the status line, the three mandatory headers and
+      /// a permessage-deflate response.
+      static const std::size_t max_size = 512;
 
-      /// Reset to initial parser state.
-      void reset()
-      {
-        state_ = method_start;
-      }
+      status_type status_;
 
-      /// Parse some data. The tribool return value is true when a complete request
-      /// has been parsed, false if the data is invalid, indeterminate when more
-      /// data is required. The InputIterator return value indicates how much of the
-      /// input has been consumed.
-      template <typename InputIterator>
-      boost::tuple<boost::tribool, InputIterator> parse(request& req,
-        InputIterator begin, InputIterator end)
+      upgrade_reply()
+        : status_(reply::bad_request)
+        , size_(0)
       {
-        while (begin != end)
-        {
-          boost::tribool result = consume(req, *begin++);
-          if (result || !result)
-            return boost::make_tuple(result, begin);
-        }
-        boost::tribool result = boost::indeterminate;
-        return boost::make_tuple(result, begin);
       }
 
-    private:
-      /// Handle the next character of input.
-      boost::tribool consume(request& req, char input)
+      /// Build the reply to a complete upgrade request in [begin, end).
+      /// Returns false, with status_ bad_request, when the request is
+      /// incomplete, invalid, not a GET, or has no Sec-WebSocket-Key.
+      bool build(const char* begin, const char* end,
+        const deflate_options& options, deflate_params& params)
       {
-        switch (state_)
-        {
-        case method_start:
-        if (!is_char(input) || is_ctl(input) || is_tspecial(input))
-        {
-          return false;
-        }
-        else
-        {
-          state_ = method;
-          req.method.push_back(input);
-          return boost::indeterminate;
-        }
-        case method:
-        if (input == ' ')
-        {
-          state_ = uri;
-          return boost::indeterminate;
-        }
-        else if (!is_char(input) || is_ctl(input) || is_tspecial(input))
-        {
-          return false;
-        }
-        else
-        {
-          req.method.push_back(input);
-          return boost::indeterminate;
-        }
-        case uri:
-        if (input == ' ')
-        {
-          state_ = http_version_h;
-          return boost::indeterminate;
-        }
-        else if (is_ctl(input))
-        {
-          return false;
-        }
-        else
-        {
-          req.uri.push_back(input);
-          return boost::indeterminate;
-        }
-        case http_version_h:
-        if (input == 'H')
-        {
-          state_ = http_version_t_1;
-          return boost::indeterminate;
-        }
-        else
-        {
-          return false;
-        }
-        case http_version_t_1:
-        if (input == 'T')
-        {
-          state_ = http_version_t_2;
-          return boost::indeterminate;
-        }
-        else
-        {
-          return false;
-        }
-        case http_version_t_2:
-        if (input == 'T')
-        {
-          state_ = http_version_p;
-          return boost::indeterminate;
-        }
-        else
-        {
-          return false;
-        }
-        case http_version_p:
-        if (input == 'P')
-        {
-          state_ = http_version_slash;
-          return boost::indeterminate;
-        }
-        else
-        {
+        status_ = reply::bad_request;
+        size_ = 0;
+
+        // parsed in place, nothing is copied
+        ::http::server::request_view req;
+        boost::tribool parsed;
+        boost::tie(parsed, boost::tuples::ignore) =
+          ::http::server::request_view_parser().parse(req, begin, end);
+        if (!parsed || boost::logic::indeterminate(parsed) || req.method != "GET")
           return false;
-        }
-        case http_version_slash:
-        if (input == '/')
-        {
-          req.http_version_major = 0;
-          req.http_version_minor = 0;
-          state_ = http_version_major_start;
-          return boost::indeterminate;
-        }
-        else
-        {
-          return false;
-        }
-        case http_version_major_start:
-        if (is_digit(input))
-        {
-          req.http_version_major = req.http_version_major * 10 + input - '0';
-          state_ = http_version_major;
-          return boost::indeterminate;
-        }
-        else
-        {
-          return false;
-        }
-        case http_version_major:
-        if (input == '.')
-        {
-          state_ = http_version_minor_start;
-          return boost::indeterminate;
-        }
-        else if (is_digit(input))
-        {
-          req.http_version_major = req.http_version_major * 10 + input - '0';
-          return boost::indeterminate;
-        }
-        else
-        {
-          return false;
-        }
-        case http_version_minor_start:
-        if (is_digit(input))
-        {
-          req.http_version_minor = req.http_version_minor * 10 + input - '0';
-          state_ = http_version_minor;
-          return boost::indeterminate;
-        }
-        else
-        {
-          return false;
-        }
-        case http_version_minor:
-        if (input == '\r')
-        {
-          state_ = expecting_newline_1;
-          return boost::indeterminate;
-        }
-        else if (is_digit(input))
-        {
-          req.http_version_minor = req.http_version_minor * 10 + input - '0';
-          return boost::indeterminate;
-        }
-        else
-        {
-          return false;
-        }
-        case expecting_newline_1:
-        if (input == '\n')
-        {
-          state_ = header_line_start;
-          return boost::indeterminate;
-        }
-        else
-        {
-          return false;
-        }
-        case header_line_start:
-        if (input == '\r')
-        {
-          state_ = expecting_newline_3;
-          return boost::indeterminate;
-        }
-        else if (!req.headers.empty() && (input == ' ' || input == '\t'))
-        {
-          state_ = header_lws;
-          return boost::indeterminate;
-        }
-        else if (!is_char(input) || is_ctl(input) || is_tspecial(input))
-        {
-          return false;
-        }
-        else
-        {
-          req.headers.push_back(header());
-          req.headers.back().name.push_back(input);
-          state_ = header_name;
-          return boost::indeterminate;
-        }
-        case header_lws:
-        if (input == '\r')
-        {
-          state_ = expecting_newline_2;
-          return boost::indeterminate;
-        }
-        else if (input == ' ' || input == '\t')
-        {
-          return boost::indeterminate;
-        }
-        else if (is_ctl(input))
-        {
-          return false;
-        }
-        else
-        {
-          state_ = header_value;
-          req.headers.back().value.push_back(input);
-          return boost::indeterminate;
-        }
-        case header_name:
-        if (input == ':')
-        {
-          state_ = space_before_header_value;
-          return boost::indeterminate;
-        }
-        else if (!is_char(input) || is_ctl(input) || is_tspecial(input))
-        {
-          return false;
-        }
-        else
-        {
-          req.headers.back().name.push_back(input);
-          return boost::indeterminate;
-        }
-        case space_before_header_value:
-        if (input == ' ')
-        {
-          state_ = header_value;
-          return boost::indeterminate;
-        }
-        else
-        {
-          return false;
-        }
-        case header_value:
-        if (input == '\r')
-        {
-          state_ = expecting_newline_2;
-          return boost::indeterminate;
-        }
-        else if (is_ctl(input))
-        {
-          return false;
-        }
-        else
-        {
-          req.headers.back().value.push_back(input);
-          return boost::indeterminate;
-        }
-        case expecting_newline_2:
-        if (input == '\n')
-        {
-          state_ = header_line_start;
-          return boost::indeterminate;
-        }
-        else
-        {
+
+        const boost::string_ref key =
+          req.get(::http::server::request_view::sec_websocket_key);
+        if (key.empty())
           return false;
+
+        char accept[28];
+        accept_key(key.data(), key.size(), accept);
+
+        static const char head[] =
+          "HTTP/1.1 101 Switching Protocols\r\n"
+          "Upgrade: websocket\r\n"
+          "Connection: Upgrade\r\n"
+          "Sec-WebSocket-Accept: ";
+        append(head, sizeof(head) - 1);
+        append(accept, sizeof(accept));
+        append("\r\n", 2);
+
+        if (options.enabled_)
+        { // offers may be split over several header lines
+          std::string offers;
+          for (std::size_t i = 0; i < req.headers.size(); ++i)
+          {
+            const ::http::server::request_view::header& h = req.headers[i];
+            if (!::http::server::request_view::iequals(h.name,
+              "Sec-WebSocket-Extensions"))
+              continue;
+            if (!offers.empty())
+              offers += ',';
+            offers.append(h.value.data(), h.value.size());
+          }
+
+          static const char ext[] = "Sec-WebSocket-Extensions: ";
+          if (!offers.empty() && params.negotiate(offers, options))
+          {
+            if (size_ + sizeof(ext) - 1 + params.response_.size() + 4 <= max_size)
+            {
+              append(ext, sizeof(ext) - 1);
+              append(params.response_.data(), params.response_.size());
+              append("\r\n", 2);
+            }
+            else
+              params.accepted_ = false; // can't be answered, declined
+          }
         }
-        case expecting_newline_3:
-        return (input == '\n');
-        default:
-        return false;
-        }
+
+        append("\r\n", 2);
+        status_ = reply::switching_protocols;
+        return true;
+      }
+
+      boost::asio::const_buffer to_buffer() const
+      {
+        return boost::asio::buffer(data_.data(), size_);
       }
 
-      /// Check if a byte is an HTTP character.
-      static bool is_char(int c)
+      /// Sec-WebSocket-Accept value of a Sec-WebSocket-Key, RFC 6455 4.2.2,
+      /// base64 of the SHA1 of the key followed by the magic GUID.
+      static void accept_key(const char* key, std::size_t key_size,
+        char (&out)[28])
       {
-        return c >= 0 && c <= 127;
+        static const char magic_guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+        boost::uuids::detail::sha1 cipher;
+        cipher.process_bytes(key, key_size);
+        cipher.process_bytes(magic_guid, sizeof(magic_guid) - 1);
+        boost::uint32_t digest[5];
+        cipher.get_digest(digest);
+
+        boost::uint8_t hash[20];
+        for (std::size_t i = 0; i < 20; ++i)
+          hash[i] = static_cast<boost::uint8_t>(digest[i >> 2] >> 8 * (3 - (i & 0x03)));
+
+        encode_base64(hash, 20, out);
       }
 
-      /// Check if a byte is an HTTP control character.
-      static bool is_ctl(int c)
+      /// base64 of size bytes into out, which must hold 4 characters
+      /// per 3 bytes, rounded up. Returns the encoded size.
+      static std::size_t encode_base64(const boost::uint8_t* in,
+        std::size_t size, char* out)
       {
-        return (c >= 0 && c <= 31) || (c == 127);
+        static const char alphabet[] =
+          "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        char* o = out;
+        for (std::size_t i = 0; i < size; i += 3)
+        {
+          const std::size_t n = (std::min)(size - i, std::size_t(3));
+          const boost::uint32_t v = (in[i] << 16)
+            | (n > 1 ? in[i + 1] << 8 : 0) | (n > 2 ? in[i + 2] : 0);
+          *o++ = alphabet[(v >> 18) & 0x3F];
+          *o++ = alphabet[(v >> 12) & 0x3F];
+          *o++ = n > 1 ? alphabet[(v >> 6) & 0x3F] : '=';
+          *o++ = n > 2 ? alphabet[v & 0x3F] : '=';
+        }
+        return o - out;
       }
 
-      /// Check if a byte is defined as an HTTP tspecial character.
-      static bool is_tspecial(int c)
+      /// Find the value of the first header named name, case insensitive,
+      /// in [begin, end), surrounding spaces excluded.
+      static bool find_header(const char* begin, const char* end,
+        const char* name, const char*& value, std::size_t& value_size)
       {
-        switch (c)
+        const std::size_t name_size = std::strlen(name);
+        for (const char* line = begin; line < end;)
         {
-        case '(': case ')': case '<': case '>': case '@':
-        case ',': case ';': case ':': case '\\': case '"':
-        case '/': case '[': case ']': case '?': case '=':
-        case '{': case '}': case ' ': case '\t':
-        return true;
-        default:
+          const char* eol = line;
+          while (eol != end && *eol != '\n')
+            ++eol;
+
+          // a header line after the request line, "name:value"
+          if (line != begin && std::size_t(eol - line) > name_size
+            && line[name_size] == ':' && iequals(line, name, name_size))
+          {
+            const char* v = line + name_size + 1;
+            const char* e = eol;
+            while (v != e && (*v == ' ' || *v == '\t'))
+              ++v;
+            while (e != v && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\r'))
+              --e;
+            value = v;
+            value_size = e - v;
+            return true;
+          }
+
+          line = eol == end ? end : eol + 1;
+        }
         return false;
+      }
+
+      /// Whether the comma separated list [value, value + size) holds
+      /// token, case insensitive, i.e. "keep-alive, Upgrade".
+      static bool has_token(const char* value, std::size_t size,
+        const char* token)
+      {
+        const std::size_t token_size = std::strlen(token);
+        const char* end = value + size;
+        for (const char* item = value; item < end;)
+        {
+          const char* next = item;
+          while (next != end && *next != ',')
+            ++next;
+
+          const char* b = item;
+          const char* e = next;
+          while (b != e && (*b == ' ' || *b == '\t'))
+            ++b;
+          while (e != b && (e[-1] == ' ' || e[-1] == '\t'))
+            --e;
+          if (std::size_t(e - b) == token_size && iequals(b, token, token_size))
+            return true;
+
+          item = next == end ? end : next + 1;
         }
+        return false;
       }
 
-      /// Check if a byte is a digit.
-      static bool is_digit(int c)
+    private:
+      static bool iequals(const char* a, const char* b, std::size_t size)
       {
-        return c >= '0' && c <= '9';
+        for (std::size_t i = 0; i < size; ++i)
+        {
+          char ca = a[i], cb = b[i];
+          if (ca >= 'A' && ca <= 'Z') ca += 'a' - 'A';
+          if (cb >= 'A' && cb <= 'Z') cb += 'a' - 'A';
+          if (ca != cb)
+            return false;
+        }
+        return true;
       }
 
-      /// The current state of the parser.
-      enum state : boost::uint8_t
+      void append(const char* data, std::size_t size)
       {
-        method_start,
-        method,
-        uri,
-        http_version_h,
-        http_version_t_1,
-        http_version_t_2,
-        http_version_p,
-        http_version_slash,
-        http_version_major_start,
-        http_version_major,
-        http_version_minor_start,
-        http_version_minor,
-        expecting_newline_1,
-        header_line_start,
-        header_lws,
-        header_name,
-        space_before_header_value,
-        header_value,
-        expecting_newline_2,
-        expecting_newline_3
-      } state_;
+        BOOST_ASSERT(size_ + size <= max_size);
+        std::memcpy(data_.data() + size_, data, size);
+        size_ += size;
+      }
+
+      boost::array<char, max_size> data_;
+      std::size_t size_;
     };
 
+    /// Parser for incoming requests, shared with http::server.
+    typedef ::http::server::basic_request_parser<request> request_parser;
+
     // A structure to hold websocket frame data. 
     class data_frame
     {
     public:
-      using buffers_t=std::vector<boost::asio::const_buffer>;
+      /// Header then payload, see to_buffers.
+      using buffers_t=boost::array<boost::asio::const_buffer, 2>;
+
+      /// Longest header, masking key of a client frame included.
+      static const std::size_t max_header_size = 14;
 
       bool fin_;
+      bool rsv1_; // set on the first frame of a compressed message
       enum operation_code : boost::uint8_t
       {
         continuation_frame, // denotes a continuation frame
@@ -595,8 +504,8 @@ namespace splice
       } opcode_;
 
       bool mask_;
-      boost::int8_t fin_opcode_;
-      boost::int8_t mask_payload_len_;
+      boost::uint8_t header_size_;
+      boost::array<boost::uint8_t, max_header_size> header_;
       boost::int8_t payload_len_;
       boost::uint16_t extended_payload_len16_;
       boost::uint64_t extended_payload_len64_;
@@ -606,86 +515,259 @@ namespace splice
 
       data_frame()
         : fin_(true)
+        , rsv1_(false)
         , opcode_(text_frame)
         , mask_(false)
-        , fin_opcode_(0)
-        , mask_payload_len_(0)
+        , header_size_(0)
         , payload_len_(0)
         , extended_payload_len16_(0)
         , extended_payload_len64_(0)
       {
+        masking_key_.assign(0);
       }
 
       data_frame(const std::string& str)
         : fin_(true)
+        , rsv1_(false)
         , opcode_(text_frame)
         , mask_(false)
-        , fin_opcode_(0)
-        , mask_payload_len_(0)
+        , header_size_(0)
         , payload_len_(0)
         , extended_payload_len16_(0)
         , extended_payload_len64_(0)
         , payload_(str.begin(), str.end())
       {
+        masking_key_.assign(0);
       }
 
-      /// Convert the data_frame into a vector of buffers. 
-      std::vector<boost::asio::const_buffer> to_buffers()
+      /// Build a frame from raw bytes, binary_frame is the common case
+      /// but any operation code may be used (ping, pong, ...)
+      data_frame(const void* data, std::size_t size,
+        operation_code opcode = binary_frame)
+        : fin_(true)
+        , rsv1_(false)
+        , opcode_(opcode)
+        , mask_(false)
+        , header_size_(0)
+        , payload_len_(0)
+        , extended_payload_len16_(0)
+        , extended_payload_len64_(0)
+        , payload_(static_cast<const boost::uint8_t*>(data),
+            static_cast<const boost::uint8_t*>(data) + size)
       {
-        using namespace boost::asio;
+        masking_key_.assign(0);
+      }
 
-        std::vector<const_buffer> buffers;
+      /// Payload length announced by the frame header.
+      boost::uint64_t payload_size() const
+      {
+        if (payload_len_ == 127)
+          return extended_payload_len64_;
+        if (payload_len_ == 126)
+          return extended_payload_len16_;
+        return static_cast<boost::uint64_t>(payload_len_);
+      }
 
-        if (fin_)
-          fin_opcode_ |= 0x80;
+      /// Serialize the header of an unmasked frame into out, which must
+      /// hold max_header_size bytes. Returns the header length.
+      static std::size_t encode_header(bool fin, bool rsv1,
+        operation_code opcode, boost::uint64_t size, boost::uint8_t* out)
+      {
+        static const boost::uint8_t codes[] = { 0x0, 0x1, 0x2, 0x8, 0x9, 0xA, 0xF };
+        out[0] = static_cast<boost::uint8_t>((fin ? 0x80 : 0) | (rsv1 ? 0x40 : 0)
+          | codes[opcode < reserved ? opcode : reserved]);
 
-        switch (opcode_)
+        if (size < 126)
         {
-        case continuation_frame:    fin_opcode_ |= 0x0; break;
-        case text_frame:            fin_opcode_ |= 0x1; break;
-        case binary_frame:          fin_opcode_ |= 0x2; break;
-        case connection_close:      fin_opcode_ |= 0x8; break;
-        case ping:                  fin_opcode_ |= 0x9; break;
-        case pong:                  fin_opcode_ |= 0xA; break;
-        default:                    fin_opcode_ |= 0xF; break;
+          out[1] = static_cast<boost::uint8_t>(size);
+          return 2;
         }
-
-        buffers.push_back(buffer(static_cast<const void*>(&fin_opcode_), sizeof(fin_opcode_)));
-
-        if (payload_.size() < 126)
+        if (size < 65536)
         {
-          mask_payload_len_ = static_cast<boost::uint8_t>(payload_.size());
-          buffers.push_back(buffer(static_cast<const void*>
-            (&mask_payload_len_), sizeof(mask_payload_len_)));
-          buffers.push_back(buffer(payload_));
+          out[1] = 126;
+          out[2] = static_cast<boost::uint8_t>(size >> 8);
+          out[3] = static_cast<boost::uint8_t>(size);
+          return 4;
         }
-        else if (payload_.size() < 65537)
+        out[1] = 127;
+        for (int i = 0; i < 8; i++)
+          out[2 + i] = static_cast<boost::uint8_t>(size >> (8 * (7 - i)));
+        return 10;
+      }
+
+      /// Status codes of a connection_close frame, RFC 6455 7.4.1
+      enum close_code : boost::uint16_t
+      {
+        normal_closure = 1000,
+        going_away = 1001,
+        protocol_error = 1002,
+        unsupported_data = 1003,
+        no_status_received = 1005, // never sent, an empty close payload
+        abnormal_closure = 1006, // never sent, connection lost without close frame
+        invalid_payload = 1007,
+        policy_violation = 1008,
+        message_too_big = 1009,
+        mandatory_extension = 1010,
+        internal_error = 1011
+      };
+
+      /// Build a connection_close frame, the reason is truncated to fit
+      /// in a control frame payload of 125 bytes.
+      static data_frame close_frame(boost::uint16_t code,
+        const std::string& reason = std::string())
+      {
+        data_frame df(0, 0, connection_close);
+        if (code == no_status_received || code == abnormal_closure)
+          return df;
+
+        df.payload_.reserve(2 + reason.size());
+        df.payload_.push_back(static_cast<boost::uint8_t>(code >> 8));
+        df.payload_.push_back(static_cast<boost::uint8_t>(code));
+        df.payload_.insert(df.payload_.end(), reason.begin(),
+          reason.begin() + (std::min)(reason.size(), std::size_t(123)));
+        return df;
+      }
+
+      /// Check if a status code may be sent in a close frame.
+      static bool is_valid_close_code(boost::uint16_t code)
+      {
+        return (code >= 1000 && code <= 1003)
+          || (code >= 1007 && code <= 1014)
+          || (code >= 3000 && code <= 4999);
+      }
+
+      /// Extract status code and reason of a received connection_close frame,
+      /// no_status_received when the payload is empty. Returns false when the
+      /// payload is malformed.
+      bool close_status(boost::uint16_t& code, std::string& reason) const
+      {
+        reason.clear();
+        if (payload_.empty())
         {
-          mask_payload_len_ = 126;
-          extended_payload_len16_ = static_cast<boost::uint16_t>(payload_.size());
-          extended_payload_len16_ = data_frame_parser::hton16(extended_payload_len16_);
-
-          buffers.push_back(buffer(static_cast<const void*>
-            (&mask_payload_len_), sizeof(mask_payload_len_)));
-          buffers.push_back(buffer(static_cast<const void*>
-            (&extended_payload_len16_), sizeof(extended_payload_len16_)));
-          buffers.push_back(buffer(payload_));
+          code = no_status_received;
+          return true;
         }
-        else
+        if (payload_.size() < 2)
+          return false;
+
+        code = static_cast<boost::uint16_t>((payload_[0] << 8) | payload_[1]);
+        reason.assign(payload_.begin() + 2, payload_.end());
+        return is_valid_close_code(code);
+      }
+
+      /// Mask the payload in place with key, as a client must do,
+      /// the frame is then sent with its masking key, RFC 6455 5.3.
+      void mask(const boost::array<boost::uint8_t, 4>& key)
+      {
+        mask_ = true;
+        masking_key_ = key;
+        if (!payload_.empty())
+          unmask_validate(&payload_[0], &payload_[0], payload_.size(),
+            masking_key_, 0, 0);
+      }
+
+      /// Convert the data_frame into a header and a payload buffer, the
+      /// header is encoded inline, no allocation. The buffers do not own the
+      /// underlying memory blocks, the data_frame must remain valid and
+      /// not be changed until the write operation has completed.
+      buffers_t to_buffers()
+      {
+        header_size_ = static_cast<boost::uint8_t>(encode(header_.data()));
+
+        buffers_t buffers = { {
+          boost::asio::buffer(header_.data(), header_size_),
+          boost::asio::buffer(payload_) } };
+        return buffers;
+      }
+
+      /// Copy header and payload into out, contiguous, which must hold
+      /// max_header_size plus payload_ size bytes. Returns the frame size.
+      std::size_t copy_to(boost::uint8_t* out) const
+      {
+        const std::size_t n = encode(out);
+        if (!payload_.empty())
+          std::memcpy(out + n, &payload_[0], payload_.size());
+        return n + payload_.size();
+      }
+
+    private:
+      /// Header of this frame, with its masking key when masked.
+      std::size_t encode(boost::uint8_t* out) const
+      {
+        std::size_t n = encode_header(fin_, rsv1_, opcode_, payload_.size(), out);
+        if (mask_)
         {
-          mask_payload_len_ = 127;
-          extended_payload_len64_ = payload_.size();
-          extended_payload_len64_ = data_frame_parser::hton64(extended_payload_len64_);
-
-          buffers.push_back(buffer(static_cast<const void*>
-            (&mask_payload_len_), sizeof(mask_payload_len_)));
-          buffers.push_back(buffer(static_cast<const void*>
-            (&extended_payload_len64_), sizeof(extended_payload_len64_)));
-          buffers.push_back(buffer(payload_));
+          out[1] |= 0x80;
+          std::memcpy(out + n, masking_key_.data(), 4);
+          n += 4;
         }
+        return n;
+      }
+    };
 
-        return buffers;
+    /// A server frame serialized once, header and payload in a single
+    /// immutable buffer. Sent as is to many sessions, i.e. a broadcast,
+    /// every write pointing to the same bytes.
+    class encoded_frame
+      : private boost::noncopyable
+    {
+    public:
+      /// Encode a text frame.
+      explicit encoded_frame(const std::string& str)
+      {
+        encode(str.data(), str.size(), data_frame::text_frame);
+      }
+
+      encoded_frame(const void* data, std::size_t size,
+        data_frame::operation_code opcode = data_frame::binary_frame)
+      {
+        encode(data, size, opcode);
       }
+
+      boost::asio::const_buffer to_buffer() const
+      {
+        return boost::asio::buffer(bytes_);
+      }
+
+      /// Size on the wire, header included.
+      std::size_t size() const
+      {
+        return bytes_.size();
+      }
+
+      /// The opcode and the payload, a client copies them
+      /// into a frame of its own to mask it.
+      data_frame::operation_code opcode() const
+      {
+        return static_cast<data_frame::operation_code>(bytes_[0] & 0x0F);
+      }
+
+      const boost::uint8_t* payload() const
+      {
+        return bytes_.data() + header_size_;
+      }
+
+      std::size_t payload_size() const
+      {
+        return bytes_.size() - header_size_;
+      }
+
+    private:
+      void encode(const void* data, std::size_t size,
+        data_frame::operation_code opcode)
+      {
+        boost::uint8_t header[data_frame::max_header_size];
+        header_size_ =
+          data_frame::encode_header(true, false, opcode, size, header);
+
+        bytes_.reserve(header_size_ + size);
+        bytes_.assign(header, header + header_size_);
+        bytes_.insert(bytes_.end(), static_cast<const boost::uint8_t*>(data),
+          static_cast<const boost::uint8_t*>(data) + size);
+      }
+
+      std::vector<boost::uint8_t> bytes_;
+      std::size_t header_size_;
     };
 
     /*
@@ -713,7 +795,98 @@ namespace splice
       /// Construct ready to parse the data_frame.
       data_frame_parser()
         : state_(fin_opcode)
+        , validate_utf8_(false)
+        , text_message_(false)
+        , validating_(false)
+        , frame_started_(false)
+        , utf8_error_(false)
+        , max_payload_size_((std::numeric_limits<boost::uint64_t>::max)())
+        , too_big_(false)
+      {
+      }
+
+      /// Reset to initial parser state, ready for the next data_frame.
+      /// The UTF-8 validation of a fragmented text message goes on.
+      void reset()
+      {
+        state_ = fin_opcode;
+        frame_started_ = false;
+      }
+
+      /// Validate uncompressed text messages while parsing contiguous
+      /// data, parse then returns false on invalid UTF-8, see utf8_error.
+      /// Compressed messages must be validated once inflated.
+      void validate_utf8(bool enable)
+      {
+        validate_utf8_ = enable;
+      }
+
+      /// True when the last parse failed on invalid UTF-8.
+      bool utf8_error() const
+      {
+        return utf8_error_;
+      }
+
+      /// Frames announcing a larger payload are rejected as soon as their
+      /// header is parsed, parse then returns false, see too_big.
+      void max_payload_size(boost::uint64_t size)
+      {
+        max_payload_size_ = size;
+      }
+
+      /// True when the last parse failed on a payload larger than
+      /// max_payload_size.
+      bool too_big() const
+      {
+        return too_big_;
+      }
+
+      /// Parse contiguous data, the payload is unmasked in bulk and,
+      /// when enabled, validated as UTF-8 in the same pass.
+      /// Same return values as the generic parse.
+      boost::tuple<boost::tribool, const char*> parse(data_frame& frame,
+        const char* begin, const char* end)
+      {
+        while (begin != end)
+        {
+          if (state_ == payload)
+          {
+            if (!frame_started_)
+              start_frame(frame);
+
+            const std::size_t have = frame.payload_.size();
+            const std::size_t n = static_cast<std::size_t>((std::min)(
+              frame.payload_size() - have, static_cast<boost::uint64_t>(end - begin)));
+            frame.payload_.resize(have + n);
+            if (!unmask_validate(&frame.payload_[have],
+              reinterpret_cast<const boost::uint8_t*>(begin), n,
+              frame.masking_key_, have, validating_ ? &utf8_ : 0))
+            {
+              utf8_error_ = true;
+              return boost::make_tuple(boost::tribool(false), begin + n);
+            }
+            begin += n;
+
+            if (frame.payload_.size() == frame.payload_size())
+              return boost::make_tuple(end_frame(frame), begin);
+            continue;
+          }
+
+          boost::tribool result = consume(frame, *begin++);
+          if (result)
+            return boost::make_tuple(end_frame(frame), begin);
+          if (!result || !check_size(frame))
+            return boost::make_tuple(boost::tribool(false), begin);
+        }
+        boost::tribool result = boost::indeterminate;
+        return boost::make_tuple(result, begin);
+      }
+
+      boost::tuple<boost::tribool, const char*> parse(data_frame& frame,
+        char* begin, char* end)
       {
+        return parse(frame, const_cast<const char*>(begin),
+          const_cast<const char*>(end));
       }
 
       /// Parse some data. The tribool return value is true when a complete data_frame
@@ -729,6 +902,8 @@ namespace splice
           boost::tribool result = consume(frame, *begin++);
           if (result || !result)
             return boost::make_tuple(result, begin);
+          if (!check_size(frame))
+            return boost::make_tuple(boost::tribool(false), begin);
         }
         boost::tribool result = boost::indeterminate;
         return boost::make_tuple(result, begin);
@@ -825,6 +1000,59 @@ namespace splice
       }
 
     private:
+      /// Called once the header of a frame is parsed, a text message is
+      /// validated from its first frame to its last continuation frame.
+      void start_frame(const data_frame& frame)
+      {
+        frame_started_ = true;
+        switch (frame.opcode_)
+        {
+        case data_frame::text_frame:
+          text_message_ = validate_utf8_ && !frame.rsv1_;
+          utf8_.reset();
+          validating_ = text_message_;
+          break;
+        case data_frame::binary_frame:
+          text_message_ = false;
+          validating_ = false;
+          break;
+        case data_frame::continuation_frame:
+          validating_ = text_message_;
+          break;
+        default: // control frames don't interrupt the message
+          validating_ = false;
+        }
+      }
+
+      /// Once the header is parsed, nothing of a payload larger than
+      /// max_payload_size_ is read.
+      bool check_size(const data_frame& frame)
+      {
+        if (state_ != payload || frame_started_ || !frame.payload_.empty()
+          || frame.payload_size() <= max_payload_size_)
+          return true;
+        too_big_ = true;
+        return false;
+      }
+
+      /// A complete frame, the last one of a text message must not
+      /// end inside a character.
+      boost::tribool end_frame(const data_frame& frame)
+      {
+        if (!frame_started_)
+          start_frame(frame);
+        if (validating_ && frame.fin_)
+        {
+          text_message_ = false;
+          if (!utf8_.complete())
+          {
+            utf8_error_ = true;
+            return false;
+          }
+        }
+        return true;
+      }
+
       /// Handle the next character of input.
       boost::tribool consume(data_frame& frame, boost::uint8_t input)
       {
@@ -833,6 +1061,7 @@ namespace splice
         case fin_opcode:
         {
           frame.fin_ = get_bits(input, 7, 1) == 1;
+          frame.rsv1_ = get_bits(input, 6, 1) == 1;
 
           switch (get_bits(input, 0, 4))
           {
@@ -868,7 +1097,12 @@ namespace splice
           frame.payload_len_ = get_bits(input, 0, 7);
 
           if (frame.payload_len_ == 0)
-            return true;
+          {
+            // the masking key is still sent with an empty payload
+            if (!frame.mask_)
+              return true;
+            state_ = masking_key1;
+          }
           else if (frame.payload_len_ == 126 || frame.payload_len_ == 127)
             state_ = extended_payload_len1;
           else
@@ -903,6 +1137,8 @@ namespace splice
 
             if (frame.mask_)
               state_ = masking_key1;
+            else if (frame.extended_payload_len16_ == 0)
+              return true;
             else
               state_ = payload;
           }
@@ -978,6 +1214,8 @@ namespace splice
 
           if (frame.mask_)
             state_ = masking_key1;
+          else if (frame.extended_payload_len64_ == 0)
+            return true;
           else
             state_ = payload;
 
@@ -1009,6 +1247,9 @@ namespace splice
           frame.masking_key_[3] = input;
           state_ = payload;
 
+          if (frame.payload_size() == 0)
+            return true;
+
           return boost::indeterminate;
         }
         case payload:
@@ -1016,27 +1257,10 @@ namespace splice
           boost::uint8_t mask = frame.masking_key_[frame.payload_.size() % 4];
           frame.payload_.push_back(input ^ mask);
 
-          if (frame.payload_len_ == 127)
-          {
-            if (frame.payload_.size() == frame.extended_payload_len64_)
-              return true;
-            else
-              return boost::indeterminate;
-          }
-          else if (frame.payload_len_ == 126)
-          {
-            if (frame.payload_.size() == frame.extended_payload_len16_)
-              return true;
-            else
-              return boost::indeterminate;
-          }
+          if (frame.payload_.size() == frame.payload_size())
+            return true;
           else
-          {
-            if (frame.payload_.size() == static_cast<std::vector<char>::size_type>(frame.payload_len_))
-              return true;
-            else
-              return boost::indeterminate;
-          }
+            return boost::indeterminate;
         }
 
         default:
@@ -1069,6 +1293,15 @@ namespace splice
         masking_key4,
         payload
       } state_;
+
+      bool validate_utf8_;
+      bool text_message_; // a text message being validated
+      bool validating_; // the current frame is validated
+      bool frame_started_;
+      bool utf8_error_;
+      utf8_validator utf8_;
+      boost::uint64_t max_payload_size_;
+      bool too_big_;
     };
 
   };
@@ -1078,6 +1311,9 @@ namespace splice
   using http_reply_ptr=boost::shared_ptr<http_reply_t>;
   using c_http_reply_ptr=boost::shared_ptr<const http_reply_t>;
 
+  /// The reply to an upgrade request, in a single fixed buffer.
+  using upgrade_reply_t=rfc6455_engine::upgrade_reply;
+
   /// The parser for the incoming messages.
   using frame_parser_t= rfc6455_engine::data_frame_parser;
   using frame_parser_ptr= boost::shared_ptr<frame_parser_t>;
@@ -1093,6 +1329,9 @@ namespace splice
   using data_frame_ptr=boost::shared_ptr<data_frame>;
   using c_data_frame_ptr=boost::shared_ptr<const data_frame>;
 
+  using encoded_frame=rfc6455_engine::encoded_frame;
+  using encoded_frame_ptr=boost::shared_ptr<const encoded_frame>;
+
 } // namespace splice {
 
 template<> inline
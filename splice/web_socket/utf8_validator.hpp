@@ -0,0 +1,198 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef WEBSOCKET_UTF8_VALIDATOR_HPP
+#define WEBSOCKET_UTF8_VALIDATOR_HPP
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include <cstring>
+
+#include <boost/array.hpp>
+#include <boost/cstdint.hpp>
+
+#if defined(SPLICE_HAS_SSE2)
+# include <emmintrin.h>
+#endif
+
+namespace splice
+{
+
+  // Streaming UTF-8 validation of web socket text messages, RFC 6455 8.1.
+  // A message may be fed in pieces split anywhere, even inside a character.
+  // Runs of ASCII are skipped 16 bytes at a time with SSE2, 8 otherwise,
+  // other bytes go through the DFA of Bjoern Hoehrmann,
+  // http://bjoern.hoehrmann.de/utf-8/decoder/dfa/
+  class utf8_validator
+  {
+  public:
+    utf8_validator()
+      :state_(accept)
+    {
+    }
+
+    void reset()
+    {
+      state_=accept;
+    }
+
+    // Validate the next bytes, returns false as soon as the text is invalid
+    bool feed(const boost::uint8_t* p,std::size_t size)
+    {
+      const boost::uint8_t* const end=p+size;
+      while(p!=end)
+      {
+        if(state_==accept)
+        {
+          p=skip_ascii(p,end);
+          if(p==end)
+            break;
+        }
+        if(!step(*p++))
+          return false;
+      }
+      return true;
+    }
+
+    // Feed a block of 16 bytes known to be ASCII, or not
+    bool feed16(const boost::uint8_t* p,bool ascii)
+    {
+      if(ascii&&state_==accept)
+        return true;
+      for(unsigned i=0; i<16; i++)
+        if(!step(p[i]))
+          return false;
+      return true;
+    }
+
+    // True when the bytes fed so far end on a complete character
+    bool complete() const
+    {
+      return state_==accept;
+    }
+
+    // Validate a whole text
+    static bool validate(const boost::uint8_t* p,std::size_t size)
+    {
+      utf8_validator v;
+      return v.feed(p,size)&&v.complete();
+    }
+
+  private:
+    enum : boost::uint8_t
+    {
+      accept=0,
+      reject=12
+    };
+
+    bool step(boost::uint8_t byte)
+    {
+      state_=table()[256+state_+table()[byte]];
+      return state_!=reject;
+    }
+
+    static const boost::uint8_t* skip_ascii(const boost::uint8_t* p,
+      const boost::uint8_t* end)
+    {
+#if defined(SPLICE_HAS_SSE2)
+      while(end-p>=16&&!_mm_movemask_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p))))
+        p+=16;
+#endif
+      while(end-p>=8)
+      {
+        boost::uint64_t word;
+        std::memcpy(&word,p,8);
+        if(word&0x8080808080808080ULL)
+          break;
+        p+=8;
+      }
+      while(p!=end&&*p<0x80)
+        ++p;
+      return p;
+    }
+
+    // Byte classes then transitions, states are multiple of 12
+    static const boost::uint8_t* table()
+    {
+      static const boost::uint8_t utf8d[]=
+      {
+        0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+        0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+        0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+        0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+        1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,
+        7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,
+        8,8,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+        10,3,3,3,3,3,3,3,3,3,3,3,3,4,3,3,11,6,6,6,5,8,8,8,8,8,8,8,8,8,8,8,
+
+        0,12,24,36,60,96,84,12,12,12,48,72,12,12,12,12,12,12,12,12,12,12,12,12,
+        12,0,12,12,12,12,12,0,12,0,12,12,12,24,12,12,12,12,12,24,12,24,12,12,
+        12,12,12,12,12,12,12,24,12,12,12,12,12,24,12,12,12,12,12,12,12,24,12,12,
+        12,12,12,12,12,12,12,36,12,36,12,12,12,36,12,12,12,12,12,36,12,36,12,12,
+        12,36,12,12,12,12,12,12,12,12,12,12
+      };
+      return utf8d;
+    }
+
+    boost::uint8_t state_;
+  };
+
+  // Unmask len bytes of a frame payload from src to dst, offset being the
+  // position of src in the payload, validating them on the fly when
+  // validator is not null. Returns false on invalid UTF-8.
+  inline bool unmask_validate(boost::uint8_t* dst,const boost::uint8_t* src,
+    std::size_t len,const boost::array<boost::uint8_t,4>& key,
+    std::size_t offset,utf8_validator* validator)
+  {
+    // the key rotated to start at offset, repeated
+    boost::uint8_t mask[16];
+    for(unsigned i=0; i<16; i++)
+      mask[i]=key[(offset+i)&3];
+
+    std::size_t i=0;
+#if defined(SPLICE_HAS_SSE2)
+    const __m128i m=_mm_loadu_si128(reinterpret_cast<const __m128i*>(mask));
+    for(; i+16<=len; i+=16)
+    {
+      const __m128i x=_mm_xor_si128(m,
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src+i)));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst+i),x);
+      if(validator&&!validator->feed16(dst+i,!_mm_movemask_epi8(x)))
+        return false;
+    }
+#else
+    boost::uint64_t m;
+    std::memcpy(&m,mask,8);
+    for(; i+16<=len; i+=16)
+    {
+      boost::uint64_t a,b;
+      std::memcpy(&a,src+i,8);
+      std::memcpy(&b,src+i+8,8);
+      a^=m;
+      b^=m;
+      std::memcpy(dst+i,&a,8);
+      std::memcpy(dst+i+8,&b,8);
+      if(validator&&!validator->feed16(dst+i,
+        !((a|b)&0x8080808080808080ULL)))
+        return false;
+    }
+#endif
+    for(std::size_t j=i; j<len; j++)
+      dst[j]=src[j]^mask[j&15];
+
+    return !validator||validator->feed(dst+i,len-i);
+  }
+
+} // namespace splice {
+
+#endif // #ifndef WEBSOCKET_UTF8_VALIDATOR_HPP
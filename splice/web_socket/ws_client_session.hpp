@@ -0,0 +1,173 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef WEBSOCKET_CLIENT_SESSION_HPP
+#define WEBSOCKET_CLIENT_SESSION_HPP
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include "ws_session.hpp"
+
+#include <random>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/streambuf.hpp>
+
+namespace splice
+{
+
+  /// The client side of a web socket, connects to a server, i.e. a load
+  /// generator or a link between servers. The connection is established
+  /// again with a jittered exponential backoff each time it is lost,
+  /// until stop is called.
+  /// Messages are read and written as with a ws_session, on_read being
+  /// the only function to define. Outgoing frames are masked with keys
+  /// drawn from the system CSPRNG, permessage-deflate is not offered.
+  template < typename up_t,typename log_t=no_log >
+  class ws_client_session
+    : public ws_session<up_t,log_t>
+  {
+  public:
+    using base_t=ws_session<up_t,log_t>;
+    using my_t=ws_client_session<up_t,log_t>;
+
+    /// Construct a client with the given io_service, see async_connect.
+    ws_client_session(boost::asio::io_service& io_service);
+
+    ~ws_client_session();
+
+    // Connect to ws://host:port/target, from any thread
+    void async_connect(const std::string& host,const std::string& port,
+      const std::string& target="/");
+
+    // Start the closing handshake and stop reconnecting, from any thread
+    void stop(boost::uint16_t code=data_frame::going_away);
+
+    // Called by pubsub_hub from the publishing thread, the message
+    // is sent as a masked text frame.
+    void on_publish(const publication& pub);
+
+    // A frame encoded once for many sessions is not masked, its
+    // payload is copied into a masked frame instead, from any thread.
+    void async_broadcast(encoded_frame_ptr frame);
+
+  protected:
+    // CRTP virtual function, called after each successful upgrade, the
+    // place to send the first messages of a connection.
+    void on_open();
+
+    // CRTP virtual function, whether a lost connection is established
+    // again, default is true.
+    bool reconnect();
+
+    // CRTP virtual functions, the n-th consecutive reconnection waits a
+    // random delay up to min(reconnect_max_delay, reconnect_min_delay*2^n),
+    // clients losing the same server don't come back all at once.
+    boost::posix_time::time_duration reconnect_min_delay();
+
+    boost::posix_time::time_duration reconnect_max_delay();
+
+    // CRTP virtual function, how long the server may take to answer
+    // the upgrade request, the connection is dropped afterwards.
+    boost::posix_time::time_duration handshake_timeout();
+
+    // CRTP virtual function, headers added to the upgrade request,
+    // each one ending with "\r\n", i.e. "Origin: http://host\r\n".
+    std::string upgrade_headers();
+
+    bool ready_to_write();
+
+    // Masks every outgoing frame with a new random key
+    void mask_frame(data_frame& df);
+
+    // Frames sent by the server right after its upgrade response
+    // are handled before reading the socket again.
+    void async_read_dataframe(
+      incoming_data_ptr incoming_data,
+      frame_parser_ptr frame_parser);
+
+    void on_handshake_success();
+
+    void on_shutdown(
+      const boost::system::error_code& shut_down_ec,
+      const boost::system::error_code& close_ec);
+
+    void do_connect(std::string host,std::string port,std::string target);
+
+    // Resolve then connect to host_, the first step of every connection
+    void start_connect();
+
+    void on_resolve(const error_code& error,
+      boost::asio::ip::tcp::resolver::iterator endpoints);
+
+    void on_connect(const error_code& error);
+
+    void on_upgrade_write(
+      boost::shared_ptr<std::string> request,
+      const error_code& error);
+
+    void on_upgrade_read(const error_code& error,std::size_t bytes_transferred);
+
+    // Checks the 101 response, its Upgrade and Connection headers
+    // and its Sec-WebSocket-Accept
+    bool check_upgrade(const char* begin,const char* end);
+
+    void schedule_reconnect();
+
+    // Ends a handshake taking too long, or connects again
+    void on_reconnect_timer(const error_code& error);
+
+    void do_stop(boost::uint16_t code);
+
+    friend class base_t;
+    friend class base_t::base_t;
+    friend class base_t::base_t::base_t;
+
+  private:
+    std::string host_;
+    std::string port_;
+    std::string target_;
+
+    boost::asio::ip::tcp::resolver resolver_;
+
+    // Handshake deadline, then delay before reconnecting
+    boost::asio::deadline_timer reconnect_timer_;
+
+    // Upgrade response, then the first frames read along
+    boost::asio::streambuf response_;
+
+    // Sec-WebSocket-Key of the current upgrade request
+    char key_[24];
+
+    // Consecutive failed connections
+    unsigned attempts_;
+
+    // Upgraded, frames may be written
+    bool open_;
+
+    bool stopped_;
+
+    // Masking keys and Sec-WebSocket-Key, RFC 6455 10.3 requires them
+    // unpredictable, std::random_device is the OS CSPRNG on MSVC
+    std::random_device entropy_;
+
+    // Backoff delays
+    std::mt19937 random_;
+  };
+
+} // namespace splice {
+
+#if defined(SPLICE_HEADER_ONLY)
+# include "ws_client_session.hxx"
+#endif // defined(SPLICE_HEADER_ONLY)
+
+#endif // WEBSOCKET_CLIENT_SESSION_HPP
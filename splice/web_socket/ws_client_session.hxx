@@ -0,0 +1,424 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include "ws_client_session.hpp"
+#include <boost/asio/connect.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/asio/placeholders.hpp>
+
+namespace splice
+{
+
+  template <typename up_t,typename log_t>
+  ws_client_session<typename up_t,typename log_t>::ws_client_session(
+    boost::asio::io_service& io_service)
+    :base_t(io_service)
+    ,resolver_(io_service)
+    ,reconnect_timer_(io_service)
+    ,response_(sizeof(incoming_data_t))
+    ,attempts_(0)
+    ,open_(false)
+    ,stopped_(true)
+    ,random_(entropy_())
+  {
+  }
+
+  template <typename up_t,typename log_t>
+  ws_client_session<typename up_t,typename log_t>::~ws_client_session()
+  {
+    // no reconnection from the tcp_session destructor
+    error_code ec;
+    get_socket().close(ec);
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_client_session<typename up_t,typename log_t>::async_connect(
+    const std::string& host,const std::string& port,const std::string& target)
+  {
+    get_strand().dispatch(boost::bind(&up_t::do_connect,sp_cast_up(),
+      host,port,target));
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_client_session<typename up_t,typename log_t>::do_connect(
+    std::string host,std::string port,std::string target)
+  {
+    host_.swap(host);
+    port_.swap(port);
+    target_.swap(target);
+    attempts_=0;
+    stopped_=false;
+    start_connect();
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_client_session<typename up_t,typename log_t>::stop(
+    boost::uint16_t code)
+  {
+    get_strand().dispatch(boost::bind(&up_t::do_stop,sp_cast_up(),code));
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_client_session<typename up_t,typename log_t>::do_stop(
+    boost::uint16_t code)
+  {
+    log_trace(EZ_FLFT,"code="+boost::lexical_cast<std::string>(code));
+
+    stopped_=true;
+    error_code ec;
+    reconnect_timer_.cancel(ec);
+    resolver_.cancel();
+
+    if(open_)
+      cast_up()->async_close(code);
+    else
+      shutdown();
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_client_session<typename up_t,typename log_t>::on_publish(
+    const publication& pub)
+  {
+    async_write(pub.message());
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_client_session<typename up_t,typename log_t>::async_broadcast(
+    encoded_frame_ptr frame)
+  {
+    async_write_frame(boost::make_shared<data_frame>(
+      frame->payload(),frame->payload_size(),frame->opcode()),
+      &up_t::on_write_dataframe);
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_client_session<typename up_t,typename log_t>::on_open()
+  {
+    log_info(EZ_FLFT,host_+":"+port_+target_);
+  }
+
+  template <typename up_t,typename log_t>
+  bool ws_client_session<typename up_t,typename log_t>::reconnect()
+  {
+    return true;
+  }
+
+  template <typename up_t,typename log_t>
+  boost::posix_time::time_duration
+    ws_client_session<typename up_t,typename log_t>::reconnect_min_delay()
+  {
+    return boost::posix_time::milliseconds(100);
+  }
+
+  template <typename up_t,typename log_t>
+  boost::posix_time::time_duration
+    ws_client_session<typename up_t,typename log_t>::reconnect_max_delay()
+  {
+    return boost::posix_time::seconds(30);
+  }
+
+  template <typename up_t,typename log_t>
+  boost::posix_time::time_duration
+    ws_client_session<typename up_t,typename log_t>::handshake_timeout()
+  {
+    return boost::posix_time::seconds(10);
+  }
+
+  template <typename up_t,typename log_t>
+  std::string ws_client_session<typename up_t,typename log_t>::upgrade_headers()
+  {
+    return std::string();
+  }
+
+  template <typename up_t,typename log_t>
+  bool ws_client_session<typename up_t,typename log_t>::ready_to_write()
+  {
+    return open_;
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_client_session<typename up_t,typename log_t>::mask_frame(
+    data_frame& df)
+  {
+    const boost::uint32_t r=entropy_();
+    boost::array<boost::uint8_t,4> key;
+    std::memcpy(key.data(),&r,4);
+    df.mask(key);
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_client_session<typename up_t,typename log_t>::start_connect()
+  {
+    namespace ba=boost::asio;
+
+    log_trace(EZ_FLFT,host_+":"+port_);
+
+    ba::ip::tcp::resolver::query query(host_,port_);
+    resolver_.async_resolve(query,get_strand().wrap(
+      boost::bind(&up_t::on_resolve,sp_cast_up(),
+      ba::placeholders::error,
+      ba::placeholders::iterator)));
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_client_session<typename up_t,typename log_t>::on_resolve(
+    const error_code& error,
+    boost::asio::ip::tcp::resolver::iterator endpoints)
+  {
+    namespace ba=boost::asio;
+
+    if(stopped_)
+      return;
+    if(error)
+    {
+      log_warning(EZ_FLFT,host_+" "+error.message());
+      schedule_reconnect();
+      return;
+    }
+
+    ba::async_connect(get_socket(),endpoints,get_strand().wrap(
+      boost::bind(&up_t::on_connect,sp_cast_up(),
+      ba::placeholders::error)));
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_client_session<typename up_t,typename log_t>::on_connect(
+    const error_code& error)
+  {
+    namespace ba=boost::asio;
+
+    if(stopped_)
+    {
+      shutdown();
+      return;
+    }
+    if(error)
+    { // the socket is closed by async_connect
+      log_warning(EZ_FLFT,host_+":"+port_+" "+error.message());
+      schedule_reconnect();
+      return;
+    }
+
+    // a new key for each connection, RFC 6455 4.1
+    boost::uint8_t nonce[16];
+    for(unsigned i=0; i<sizeof(nonce); i+=4)
+    {
+      const boost::uint32_t r=entropy_();
+      std::memcpy(nonce+i,&r,4);
+    }
+    upgrade_reply_t::encode_base64(nonce,sizeof(nonce),key_);
+
+    boost::shared_ptr<std::string> request(boost::make_shared<std::string>(
+      "GET "+target_+" HTTP/1.1\r\n"
+      "Host: "+host_+":"+port_+"\r\n"
+      "Upgrade: websocket\r\n"
+      "Connection: Upgrade\r\n"
+      "Sec-WebSocket-Key: "+std::string(key_,sizeof(key_))+"\r\n"
+      "Sec-WebSocket-Version: 13\r\n"
+      +cast_up()->upgrade_headers()+"\r\n"));
+
+    reconnect_timer_.expires_from_now(cast_up()->handshake_timeout());
+    reconnect_timer_.async_wait(get_strand().wrap(
+      boost::bind(&up_t::on_reconnect_timer,sp_cast_up(),
+      ba::placeholders::error)));
+
+    ba::async_write(get_socket(),ba::buffer(*request),get_strand().wrap(
+      boost::bind(&up_t::on_upgrade_write,sp_cast_up(),
+      request,
+      ba::placeholders::error)));
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_client_session<typename up_t,typename log_t>::on_upgrade_write(
+    boost::shared_ptr<std::string> request,
+    const error_code& error)
+  {
+    namespace ba=boost::asio;
+
+    log_trace(EZ_FLFT,*request);
+
+    if(error)
+    {
+      cast_up()->on_error_code(EZ_FLF,error);
+      return;
+    }
+
+    ba::async_read_until(get_socket(),response_,"\r\n\r\n",get_strand().wrap(
+      boost::bind(&up_t::on_upgrade_read,sp_cast_up(),
+      ba::placeholders::error,
+      ba::placeholders::bytes_transferred)));
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_client_session<typename up_t,typename log_t>::on_upgrade_read(
+    const error_code& error,std::size_t bytes_transferred)
+  {
+    namespace ba=boost::asio;
+
+    if(error)
+    {
+      if(error!=ba::error::operation_aborted)
+        cast_up()->on_error_code(EZ_FLF,error);
+      return;
+    }
+
+    error_code ec;
+    reconnect_timer_.cancel(ec);
+
+    const char* response=ba::buffer_cast<const char*>(response_.data());
+    if(!check_upgrade(response,response+bytes_transferred))
+    {
+      log_error(EZ_FLFT,"upgrade refused: "
+        +std::string(response,bytes_transferred));
+      shutdown();
+      return;
+    }
+
+    // what follows the response is already the first frames
+    response_.consume(bytes_transferred);
+    cast_up()->on_handshake_success();
+  }
+
+  template <typename up_t,typename log_t>
+  bool ws_client_session<typename up_t,typename log_t>::check_upgrade(
+    const char* begin,const char* end)
+  {
+    static const char status[]="HTTP/1.1 101";
+    if(end-begin<12||std::memcmp(begin,status,12)!=0)
+      return false;
+
+    const char* value;
+    std::size_t size;
+
+    // RFC 6455 4.1, the client fails the connection without them
+    if(!upgrade_reply_t::find_header(begin,end,"Upgrade",value,size)
+      ||!upgrade_reply_t::has_token(value,size,"websocket"))
+      return false;
+    if(!upgrade_reply_t::find_header(begin,end,"Connection",value,size)
+      ||!upgrade_reply_t::has_token(value,size,"Upgrade"))
+      return false;
+
+    // no extension is offered, none may be accepted
+    if(upgrade_reply_t::find_header(begin,end,"Sec-WebSocket-Extensions",
+      value,size))
+      return false;
+
+    char accept[28];
+    upgrade_reply_t::accept_key(key_,sizeof(key_),accept);
+    return upgrade_reply_t::find_header(begin,end,"Sec-WebSocket-Accept",
+      value,size)&&size==sizeof(accept)
+      &&std::memcmp(value,accept,sizeof(accept))==0;
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_client_session<typename up_t,typename log_t>::on_handshake_success()
+  {
+    attempts_=0;
+    open_=true;
+    base_t::on_handshake_success();
+    cast_up()->on_open();
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_client_session<typename up_t,typename log_t>::async_read_dataframe(
+    incoming_data_ptr incoming_data,
+    frame_parser_ptr frame_parser)
+  {
+    namespace ba=boost::asio;
+
+    if(!response_.size())
+    {
+      base_t::async_read_dataframe(incoming_data,frame_parser);
+      return;
+    }
+
+    // posted, on_open is called first
+    const std::size_t size=ba::buffer_copy(ba::buffer(*incoming_data),
+      response_.data());
+    response_.consume(size);
+    get_strand().post(boost::bind(&up_t::on_read_dataframe,sp_cast_up(),
+      incoming_data,frame_parser,error_code(),size));
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_client_session<typename up_t,typename log_t>::on_shutdown(
+    const boost::system::error_code& shut_down_ec,
+    const boost::system::error_code& close_ec)
+  {
+    base_t::on_shutdown(shut_down_ec,close_ec);
+
+    open_=false;
+    if(!stopped_&&cast_up()->reconnect())
+      schedule_reconnect();
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_client_session<typename up_t,typename log_t>::schedule_reconnect()
+  {
+    namespace ba=boost::asio;
+
+    // equal jitter, between half and all of the exponential delay
+    const boost::int64_t min_delay=
+      cast_up()->reconnect_min_delay().total_milliseconds();
+    const boost::int64_t max_delay=
+      cast_up()->reconnect_max_delay().total_milliseconds();
+    const boost::int64_t ceiling=
+      (std::min)(min_delay<<(std::min)(attempts_,20u),max_delay);
+    const boost::int64_t delay=std::uniform_int_distribution<boost::int64_t>(
+      ceiling/2,ceiling)(random_);
+    attempts_++;
+
+    log_info(EZ_FLFT,"reconnect in "+boost::lexical_cast<std::string>(delay)
+      +" ms, attempt "+boost::lexical_cast<std::string>(attempts_));
+
+    reconnect_timer_.expires_from_now(boost::posix_time::milliseconds(delay));
+    reconnect_timer_.async_wait(get_strand().wrap(
+      boost::bind(&up_t::on_reconnect_timer,sp_cast_up(),
+      ba::placeholders::error)));
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_client_session<typename up_t,typename log_t>::on_reconnect_timer(
+    const error_code& error)
+  {
+    if(error||stopped_)
+      return;
+
+    if(get_socket().is_open())
+    {
+      if(!open_)
+      { // the server accepted the connection but doesn't answer
+        log_warning(EZ_FLFT,"upgrade timeout");
+        shutdown();
+      }
+      return;
+    }
+
+    // aborted writes of the lost connection must complete first
+    if(write_pending())
+    {
+      reconnect_timer_.expires_from_now(boost::posix_time::milliseconds(1));
+      reconnect_timer_.async_wait(get_strand().wrap(
+        boost::bind(&up_t::on_reconnect_timer,sp_cast_up(),
+        boost::asio::placeholders::error)));
+      return;
+    }
+
+    reset_connection();
+    response_.consume(response_.size());
+    start_connect();
+  }
+
+} // namespace splice {
@@ -51,7 +51,6 @@ namespace splice
     // mono protocol server
     // Second read operation will call on_handshake_success()
     void on_second_read(
-      http_reply_ptr reply,
       const error_code& error);
 
     // multi protocol server ---------------------------------------------------
@@ -79,7 +78,6 @@ namespace splice
     template< typename _t>
     void on_second_read(
       _t handshake_fail,
-      http_reply_ptr reply,
       const error_code& error);
 
     template< typename _t>
@@ -107,6 +105,15 @@ namespace splice
     // CRTP virtual function
     void on_bad_request(const char* file,unsigned line,const char* func);
 
+    // CRTP virtual function, permessage-deflate configuration,
+    // default is disabled.
+    deflate_options deflate_config();
+
+    // Build upgrade_reply_ from the raw upgrade request and, when
+    // negotiated, the permessage-deflate compressor.
+    // Returns false when the request is invalid.
+    bool handle_upgrade(const char* data,std::size_t size);
+
     template<typename _t>
     http_reply_ptr mk_http_reply(_t p);
 
@@ -114,6 +121,12 @@ namespace splice
 
     friend class base_t;
 
+    // Written by first_write, lives as long as the session
+    upgrade_reply_t upgrade_reply_;
+
+    // Built when permessage-deflate is negotiated, null otherwise
+    permessage_deflate_ptr deflate_;
+
   }; // class ws_handshake
 
 } // namespace splice {
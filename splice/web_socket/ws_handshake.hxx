@@ -56,26 +56,18 @@ namespace splice
       log_info_t(EZ_FLFT,
         "incoming=",incoming.data(),incoming.size());
 
-      boost::logic::tribool result;
-      http_request_t hs_req;
-      boost::tie(result,boost::tuples::ignore)=request_parser().parse(
-        hs_req,incoming.data(),incoming.data()+incoming.size());
-
-      if(result)
+      if(cast_up()->handle_upgrade(incoming.data(),incoming.size()))
       {
-        http_reply_ptr reply(mk_http_reply(request_handler::handle_request(hs_req)));
-
-        switch(reply->status_)
+        switch(upgrade_reply_.status_)
         {
         case http_reply_t::bad_request:
         default:
           cast_up()->on_error(EZ_FLF);
           return;
         case http_reply_t::switching_protocols:
-          ba::async_write(get_socket(),reply->to_buffers(),
+          ba::async_write(get_socket(),upgrade_reply_.to_buffer(),
             get_strand().wrap(
             bind(&up_t::on_second_read,sp_cast_up(),
-            reply,
             ba::placeholders::error)));
           break;
         }
@@ -89,7 +81,6 @@ namespace splice
 
     template <typename up_t,typename log_t>
     void ws_handshake<up_t,log_t>::on_second_read(
-      http_reply_ptr reply,
       const error_code& error)
     {
       using std::string;
@@ -103,9 +94,9 @@ namespace splice
         return;
       }
       log_trace(EZ_FLFT,
-        string(" http_reply_t::")+lexical_cast<string>(reply->status_));
+        string(" http_reply_t::")+lexical_cast<string>(upgrade_reply_.status_));
 
-      switch(reply->status_)
+      switch(upgrade_reply_.status_)
       {
       case http_reply_t::switching_protocols:
         cast_up()->on_handshake_success();
@@ -158,16 +149,10 @@ namespace splice
 
       log_info_t(EZ_FLFT,"",incoming.data(),incoming.size());
 
-      boost::logic::tribool result;
-      http_request_t hs_req;
-      boost::tie(result,boost::tuples::ignore)=request_parser().parse(
-        hs_req,incoming.data(),incoming.data()+incoming.size());
-
-      if(result)
+      if(cast_up()->handle_upgrade(incoming.data(),incoming.size()))
       {
-        http_reply_ptr reply(mk_http_reply(request_handler::handle_request(hs_req)));
 
-        switch(reply->status_)
+        switch(upgrade_reply_.status_)
         {
         case http_reply_t::bad_request:
         default:
@@ -177,11 +162,10 @@ namespace splice
         case http_reply_t::switching_protocols:
         {// ok read the GUID
           auto tt=boost::protect(handshake_fail);
-          ba::async_write(get_socket(),reply->to_buffers(),
+          ba::async_write(get_socket(),upgrade_reply_.to_buffer(),
             get_strand().wrap(
             bind(&up_t::on_second_read<decltype(tt)>,sp_cast_up(),
             tt,
-            reply,
             ba::placeholders::error)));
         }
         break;
@@ -198,7 +182,6 @@ namespace splice
     template< typename _t>
     void ws_handshake<up_t,log_t>::on_second_read(
       _t handshake_fail,
-      http_reply_ptr reply,
       const error_code& error)
     {
       namespace ba=boost::asio;
@@ -211,7 +194,7 @@ namespace splice
         return;
       }
 
-      switch(reply->status_)
+      switch(upgrade_reply_.status_)
       {
       case http_reply_t::switching_protocols:
         cast_up()->guid_read(handshake_fail);
@@ -384,6 +367,30 @@ namespace splice
       shutdown();
     }
 
+    template <typename up_t,typename log_t>
+    deflate_options ws_handshake<up_t,log_t>::deflate_config()
+    {
+      return deflate_options();
+    }
+
+    template <typename up_t,typename log_t>
+    bool ws_handshake<up_t,log_t>::handle_upgrade(
+      const char* data,std::size_t size)
+    {
+      const deflate_options options(cast_up()->deflate_config());
+      deflate_params params;
+      if(!upgrade_reply_.build(data,data+size,options,params))
+        return false;
+
+      if(params.accepted_)
+      {
+        log_info(EZ_FLFT,"Sec-WebSocket-Extensions: "+params.response_);
+        deflate_=boost::make_shared<permessage_deflate>(params,options);
+      }
+
+      return true;
+    }
+
     template <typename up_t,typename log_t>
     template<typename _t>
     http_reply_ptr ws_handshake<up_t,log_t>::mk_http_reply(_t p)
@@ -0,0 +1,152 @@
+
+//          Copyright Jean Davy 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef WEBSOCKET_HEARTBEAT_HPP
+#define WEBSOCKET_HEARTBEAT_HPP
+
+#ifndef BOOST_CONFIG_HPP
+# include <boost/config.hpp>
+#endif
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+#include "../detail/config.hpp"
+
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/basic_waitable_timer.hpp>
+#include <boost/asio/placeholders.hpp>
+#include <boost/bind.hpp>
+#include <boost/chrono/system_clocks.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+namespace splice
+{
+
+  // A single timer shared by many web socket sessions, at each interval
+  // every registered session sends a ping and closes itself when
+  // max_missed_pongs pings have not been answered.
+  // Sessions register from their ws_heartbeat* heartbeat() CRTP function,
+  // they are held by weak pointer and forgotten once destroyed.
+  // Intervals are measured with the steady clock, a change of the system
+  // time neither delays nor hastens the pings.
+  class ws_heartbeat
+    : private boost::noncopyable
+  {
+  public:
+    using error_code=boost::system::error_code;
+    using clock_t=boost::chrono::steady_clock;
+    using timer_t=boost::asio::basic_waitable_timer<clock_t>;
+
+    ws_heartbeat(boost::asio::io_service& io_service,
+      clock_t::duration interval=boost::chrono::seconds(30),
+      unsigned max_missed_pongs=2)
+      :timer_(io_service)
+      ,interval_(interval)
+      ,max_missed_pongs_(max_missed_pongs)
+      ,running_(false)
+    {
+    }
+
+    clock_t::duration interval() const
+    {
+      return interval_;
+    }
+
+    unsigned max_missed_pongs() const
+    {
+      return max_missed_pongs_;
+    }
+
+    // Register a session, starts the timer on first call
+    template<typename session_t>
+    void insert(const boost::shared_ptr<session_t>& session)
+    {
+      boost::lock_guard<boost::mutex> lock(mutex_);
+      sessions_.push_back(tick<session_t>(session));
+      if(!running_)
+      {
+        running_=true;
+        schedule();
+      }
+    }
+
+    void stop()
+    {
+      boost::lock_guard<boost::mutex> lock(mutex_);
+      running_=false;
+      error_code ec;
+      timer_.cancel(ec);
+    }
+
+  private:
+    // Calls heartbeat_tick on a living session, returns false
+    // once the session has been destroyed
+    template<typename session_t>
+    struct tick
+    {
+      tick(const boost::shared_ptr<session_t>& session)
+        :session_(session)
+      {
+      }
+
+      bool operator()(unsigned max_missed_pongs) const
+      {
+        boost::shared_ptr<session_t> session(session_.lock());
+        if(!session)
+          return false;
+        session->heartbeat_tick(max_missed_pongs);
+        return true;
+      }
+
+      boost::weak_ptr<session_t> session_;
+    };
+
+    void schedule()
+    {
+      timer_.expires_from_now(interval_);
+      timer_.async_wait(boost::bind(&ws_heartbeat::on_timer,this,
+        boost::asio::placeholders::error));
+    }
+
+    void on_timer(const error_code& error)
+    {
+      boost::lock_guard<boost::mutex> lock(mutex_);
+      if(error||!running_)
+        return;
+
+      for(std::size_t i=0; i<sessions_.size();)
+      {
+        if(sessions_[i](max_missed_pongs_))
+          i++;
+        else
+        { // session is gone
+          sessions_[i].swap(sessions_.back());
+          sessions_.pop_back();
+        }
+      }
+
+      schedule();
+    }
+
+    timer_t timer_;
+    const clock_t::duration interval_;
+    const unsigned max_missed_pongs_;
+
+    bool running_;
+    std::vector<boost::function<bool(unsigned)>> sessions_;
+    boost::mutex mutex_;
+  };
+
+} // namespace splice {
+
+#endif // #ifndef WEBSOCKET_HEARTBEAT_HPP
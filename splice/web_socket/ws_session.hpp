@@ -16,10 +16,31 @@
 #include "../detail/config.hpp"
 
 #include "ws_handshake.hpp"
+#include "ws_heartbeat.hpp"
+#include "../pubsub_hub.hpp"
+
+#include <deque>
+
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/asio/deadline_timer.hpp>
 
 namespace splice
 {
 
+  // Encoder of a publication as a web socket text frame, encoded once
+  // for every ws_session subscriber, see publication::encoded.
+  struct ws_text_frame
+  {
+    typedef encoded_frame_ptr type;
+
+    static type encode(const publication& pub)
+    {
+      return boost::make_shared<encoded_frame>(pub.message());
+    }
+  };
+
   /// Represents a single connection from a client.
   template < typename up_t,typename log_t=no_log >
   class ws_session
@@ -28,12 +49,29 @@ namespace splice
   public:
     using base_t=ws_handshake<up_t,log_t>;
     using my_t=ws_session<up_t,log_t>;
+    using close_code_t=data_frame::close_code;
 
     /// Construct a connection with the given io_service.
     ws_session(boost::asio::io_service& io_service);
 
     ws_session(socket_t& socket);
 
+    // Smoothed round trip time measured with ping/pong,
+    // not_a_date_time until the first pong is received.
+    boost::posix_time::time_duration rtt() const;
+
+    // Called by ws_heartbeat at each interval, from any thread
+    void heartbeat_tick(unsigned max_missed_pongs);
+
+    // Queue a frame encoded once for many sessions, from any thread.
+    // Sent uncompressed even when permessage-deflate is negotiated,
+    // and quietly, no log message is generated.
+    void async_broadcast(encoded_frame_ptr frame);
+
+    // Called by pubsub_hub from the publishing thread, the message is
+    // sent as a text frame encoded once for all web socket subscribers.
+    void on_publish(const publication& pub);
+
   protected:
     void on_handshake_success();
 
@@ -46,13 +84,116 @@ namespace splice
     template<typename func_t>
     void async_write(const std::string& msg,func_t on_write_func);
 
+    /// Deliver a binary message to the client, i.e. a serialized archive.
+    void async_write_binary(const std::string& bytes);
+
+    void async_write_binary(const void* data,std::size_t size);
+
+    template<typename func_t>
+    void async_write_binary(const void* data,std::size_t size,
+      func_t on_write_func);
+
     // All these functions below are equivalent of pure virtual functions,
     // so must be defined in a derived class.
     void on_read(std::string&  df);
 
-    void on_read_data_frame(
-      incoming_data_ptr& incoming_data,
-      data_frame& read_frame);
+    // CRTP virtual function, called with the payload of a complete
+    // binary message. Default rejects binary messages.
+    void on_read_binary(std::vector<boost::uint8_t>& payload);
+
+    void async_read_dataframe(
+      incoming_data_ptr incoming_data,
+      frame_parser_ptr frame_parser);
+
+    // Handles a complete data frame, returns false when reading
+    // must stop (error, socket closed).
+    bool on_read_data_frame(data_frame& read_frame);
+
+    // Dispatches a complete, possibly reassembled, message
+    // to on_read or on_read_binary, decompressing it when
+    // sent with permessage-deflate.
+    bool on_read_message(
+      data_frame::operation_code opcode,
+      std::vector<boost::uint8_t>& payload,
+      bool compressed);
+
+    // CRTP virtual function, the heartbeat this session registers to
+    // on handshake success, default is none.
+    ws_heartbeat* heartbeat();
+
+    // Sends a ping, or closes the session when too many pings
+    // are not answered
+    void on_heartbeat(unsigned max_missed_pongs);
+
+    // Answers a ping with a pong carrying the same payload
+    void on_ping(std::vector<boost::uint8_t>& payload);
+
+    // Updates the smoothed round trip time
+    void on_pong(const std::vector<boost::uint8_t>& payload);
+
+    // The steady clock, unaffected by changes of the system time, that
+    // pings are stamped with
+    static boost::int64_t steady_microseconds();
+
+    // Send a ping or pong frame
+    void async_write_control(data_frame::operation_code opcode,
+      const void* data,std::size_t size);
+
+    // Start the closing handshake, frames already queued are sent first,
+    // the socket is closed when the client answers or on close_timeout.
+    void async_close(boost::uint16_t code=data_frame::normal_closure,
+      const std::string& reason=std::string());
+
+    // CRTP virtual function, called once when the client starts the closing
+    // handshake or the connection is lost without close frame
+    // (abnormal_closure).
+    void on_close(boost::uint16_t code,const std::string& reason);
+
+    // CRTP virtual function, how long the closing handshake may last.
+    boost::posix_time::time_duration close_timeout();
+
+    // CRTP virtual function, text messages are checked to be valid UTF-8,
+    // the session is closed with invalid_payload otherwise. Default is
+    // enabled, handlers may then rely on valid UTF-8.
+    bool validate_utf8();
+
+    // CRTP virtual function, the largest message accepted, once reassembled
+    // and decompressed, the session is closed with message_too_big beyond.
+    std::size_t max_message_size();
+
+    // CRTP virtual function, frames with a smaller payload are copied
+    // with their header in a single buffer before being written,
+    // 0 writes header and payload as two buffers.
+    std::size_t small_frame_size();
+
+    // Closes the session on a protocol violation, a close frame carrying
+    // code is sent, without waiting for the client answer.
+    void fail(boost::uint16_t code,const std::string& msg);
+
+    // Queue a frame, on_write_func is called once it is written,
+    // see async_write for its signature, or with operation_aborted
+    // when the frame is dropped by a closing session.
+    template<typename func_t>
+    void async_write_frame(data_frame_ptr df,func_t on_write_func);
+
+    // Compress an outgoing data frame when permessage-deflate is
+    // negotiated and the payload is larger than the threshold.
+    void deflate_frame(data_frame& df);
+
+    // CRTP virtual function, frames queued while false are dropped,
+    // a client waits for the end of its upgrade handshake.
+    bool ready_to_write();
+
+    // CRTP virtual function, called on every outgoing frame once
+    // compressed, a client masks it. Default sends it as is.
+    void mask_frame(data_frame& df);
+
+    // True until every queued frame is written or aborted
+    bool write_pending() const;
+
+    // Forget the state of a previous connection before the socket is
+    // connected again, the outbound queue must be empty.
+    void reset_connection();
 
     void on_read_dataframe(
       incoming_data_ptr incoming_data,
@@ -66,6 +207,75 @@ namespace splice
 
     friend class base_t;
     friend class base_t::base_t;
+
+  private:
+    using write_handler_t=boost::function<void(const error_code&)>;
+
+    // A frame waiting in the outbound queue, either owned by this
+    // session or shared by a broadcast
+    struct outbound_frame
+    {
+      data_frame_ptr frame_;
+      encoded_frame_ptr shared_;
+      write_handler_t on_write_;
+    };
+
+    // Outbound queue operations, all run on the strand
+    void enqueue_frame(data_frame_ptr df,write_handler_t on_write);
+
+    void enqueue_shared(encoded_frame_ptr frame);
+
+    void push_frame(const outbound_frame& frame);
+
+    void write_next();
+
+    void on_write_queue(const error_code& error);
+
+    // Tells the writer of a dropped frame, with operation_aborted,
+    // posted so that it never runs within the caller
+    void abort_write(const write_handler_t& on_write);
+
+    void on_close_timeout(const error_code& error);
+
+    // Ends the closing handshake
+    void close_socket();
+
+    // Calls on_close, once per connection
+    void notify_close(boost::uint16_t code,const std::string& reason);
+
+    // Frames are written one at a time, in order, from the front of
+    // the queue, the front frame being the one currently written.
+    std::deque<outbound_frame> write_queue_;
+
+    // Contiguous copy of the small frame being written, reused
+    std::vector<boost::uint8_t> write_buffer_;
+
+    // Closing handshake state, once a close frame is queued no other
+    // frame is accepted.
+    bool close_sent_;
+    bool close_written_;
+    bool close_received_;
+    bool failing_;
+    bool close_notified_;
+    boost::asio::deadline_timer close_timer_;
+
+    // The frame being parsed, may span several reads.
+    data_frame read_frame_;
+
+    // Payload of a fragmented message, and its operation code,
+    // continuation_frame when no fragmented message is pending.
+    std::vector<boost::uint8_t> fragments_;
+    data_frame::operation_code fragments_opcode_;
+    bool fragments_compressed_;
+
+    // Pings sent since the last pong
+    unsigned missed_pongs_;
+
+    // Registered to heartbeat(), once for all connections
+    bool heartbeat_inserted_;
+
+    // Smoothed round trip time in microseconds, -1 when unknown
+    boost::atomic<boost::int64_t> srtt_;
   };
 
 } // namespace splice {
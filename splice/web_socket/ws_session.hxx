@@ -22,30 +22,147 @@ namespace splice
   template <typename up_t,typename log_t>
   ws_session<typename up_t,typename log_t>::ws_session(boost::asio::io_service& io_service)
     : base_t(io_service)
+    ,close_sent_(false)
+    ,close_written_(false)
+    ,close_received_(false)
+    ,failing_(false)
+    ,close_notified_(false)
+    ,close_timer_(get_io_service())
+    ,fragments_opcode_(data_frame::continuation_frame)
+    ,fragments_compressed_(false)
+    ,missed_pongs_(0)
+    ,heartbeat_inserted_(false)
+    ,srtt_(-1)
   {
   }
 
   template <typename up_t,typename log_t>
   ws_session<typename up_t,typename log_t>::ws_session(socket_t& socket)
     :base_t(socket)
+    ,close_sent_(false)
+    ,close_written_(false)
+    ,close_received_(false)
+    ,failing_(false)
+    ,close_notified_(false)
+    ,close_timer_(get_io_service())
+    ,fragments_opcode_(data_frame::continuation_frame)
+    ,fragments_compressed_(false)
+    ,missed_pongs_(0)
+    ,heartbeat_inserted_(false)
+    ,srtt_(-1)
   {
   }
 
   template <typename up_t,typename log_t>
   void ws_session<typename up_t,typename log_t>::on_handshake_success()
   {
-    namespace ba=boost::asio;
-
     log_trace(EZ_FLFT,"");
 
-    incoming_data_ptr incoming_data(mk_incoming_data());
-    get_socket().async_read_some(ba::buffer(*incoming_data),
-      get_strand().wrap(
-      bind(&up_t::on_read_dataframe,sp_cast_up(),
-      incoming_data,
-      mk_frame_parser(),
-      ba::placeholders::error,
-      ba::placeholders::bytes_transferred)));
+    if(!heartbeat_inserted_)
+      if(ws_heartbeat* hb=cast_up()->heartbeat())
+      {
+        hb->insert(sp_cast_up());
+        heartbeat_inserted_=true;
+      }
+
+    frame_parser_ptr frame_parser(mk_frame_parser());
+    frame_parser->validate_utf8(cast_up()->validate_utf8());
+    frame_parser->max_payload_size(cast_up()->max_message_size());
+    cast_up()->async_read_dataframe(mk_incoming_data(),frame_parser);
+  }
+
+  template <typename up_t,typename log_t>
+  boost::posix_time::time_duration ws_session<typename up_t,typename log_t>::rtt() const
+  {
+    const boost::int64_t srtt=srtt_.load(boost::memory_order_relaxed);
+    if(srtt<0)
+      return boost::posix_time::time_duration(boost::posix_time::not_a_date_time);
+    return boost::posix_time::microseconds(srtt);
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::heartbeat_tick(unsigned max_missed_pongs)
+  {
+    get_strand().post(boost::bind(&up_t::on_heartbeat,sp_cast_up(),
+      max_missed_pongs));
+  }
+
+  template <typename up_t,typename log_t>
+  ws_heartbeat* ws_session<typename up_t,typename log_t>::heartbeat()
+  {
+    return 0;
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::on_heartbeat(unsigned max_missed_pongs)
+  {
+    if(!get_socket().is_open()||close_sent_)
+      return;
+
+    if(missed_pongs_>=max_missed_pongs)
+    { // no close handshake with a dead peer
+      log_warning(EZ_FLFT,"peer is dead, "
+        +boost::lexical_cast<std::string>(missed_pongs_)+" pongs missed");
+      notify_close(data_frame::abnormal_closure,"pong timeout");
+      close_socket();
+      return;
+    }
+    missed_pongs_++;
+
+    // the payload is the sending time, echoed back by the pong
+    const boost::int64_t now=steady_microseconds();
+    boost::uint8_t payload[8];
+    for(unsigned i=0; i<sizeof(payload); i++)
+      payload[i]=static_cast<boost::uint8_t>(now>>(8*(7-i)));
+
+    cast_up()->async_write_control(data_frame::ping,payload,sizeof(payload));
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::on_ping(
+    std::vector<boost::uint8_t>& payload)
+  {
+    cast_up()->async_write_control(data_frame::pong,
+      payload.empty()?0:&payload[0],payload.size());
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::on_pong(
+    const std::vector<boost::uint8_t>& payload)
+  {
+    // any pong proves the peer is alive, only our own pings
+    // carrying the sending time give a round trip time
+    missed_pongs_=0;
+    if(payload.size()!=8)
+      return;
+
+    boost::int64_t sent=0;
+    for(unsigned i=0; i<8; i++)
+      sent=(sent<<8)|payload[i];
+    const boost::int64_t sample=steady_microseconds()-sent;
+    if(sample<0||sample>(boost::int64_t(3600)*1000000))
+      return; // unrelated payload
+
+    // RFC 6298 smoothing, srtt=7/8 srtt+1/8 sample
+    const boost::int64_t srtt=srtt_.load(boost::memory_order_relaxed);
+    srtt_.store(srtt<0?sample:srtt+(sample-srtt)/8,boost::memory_order_relaxed);
+  }
+
+  template <typename up_t,typename log_t>
+  boost::int64_t ws_session<typename up_t,typename log_t>::steady_microseconds()
+  {
+    using namespace boost::chrono;
+    return duration_cast<microseconds>(
+      steady_clock::now().time_since_epoch()).count();
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::async_write_control(
+    data_frame::operation_code opcode,
+    const void* data,std::size_t size)
+  {
+    async_write_frame(boost::make_shared<data_frame>(data,size,opcode),
+      &up_t::on_write_dataframe);
   }
 
   template <typename up_t,typename log_t>
@@ -64,16 +181,275 @@ namespace splice
   template <typename up_t,typename log_t>
   template<typename func_t>
   void ws_session<typename up_t,typename log_t>::async_write(const std::string& msg,func_t on_write_func)
+  {
+    log_trace(EZ_FLFT,msg);
+
+    async_write_frame(mk_data_frame(msg),on_write_func);
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::async_write_binary(const std::string& bytes)
+  {
+    async_write_binary(bytes.data(),bytes.size(),&up_t::on_write_dataframe);
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::async_write_binary(
+    const void* data,std::size_t size)
+  {
+    async_write_binary(data,size,&up_t::on_write_dataframe);
+  }
+
+  template <typename up_t,typename log_t>
+  template<typename func_t>
+  void ws_session<typename up_t,typename log_t>::async_write_binary(
+    const void* data,std::size_t size,func_t on_write_func)
+  {
+    log_trace(EZ_FLFT,"size="+boost::lexical_cast<std::string>(size));
+
+    async_write_frame(boost::make_shared<data_frame>(
+      data,size,data_frame::binary_frame),on_write_func);
+  }
+
+  template <typename up_t,typename log_t>
+  template<typename func_t>
+  void ws_session<typename up_t,typename log_t>::async_write_frame(
+    data_frame_ptr df,func_t on_write_func)
+  {
+    // built apart, a bind expression given to bind would be
+    // evaluated instead of being stored
+    write_handler_t on_write(boost::bind(on_write_func,sp_cast_up(),
+      df,boost::asio::placeholders::error));
+
+    // may be called from any thread, the queue belongs to the strand
+    get_strand().dispatch(boost::bind(&up_t::enqueue_frame,sp_cast_up(),
+      df,on_write));
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::enqueue_frame(
+    data_frame_ptr df,write_handler_t on_write)
   {
     namespace ba=boost::asio;
 
-    log_trace(EZ_FLFT,msg);
+    if(close_sent_||!get_socket().is_open()||!cast_up()->ready_to_write())
+    { // session is closing, or not yet open
+      abort_write(on_write);
+      return;
+    }
+
+    // compressed here, on the strand and in queue order, as the
+    // compression context is shared by consecutive messages
+    if(df->opcode_==data_frame::text_frame
+      ||df->opcode_==data_frame::binary_frame)
+      cast_up()->deflate_frame(*df);
+    else if(df->opcode_==data_frame::connection_close)
+    {
+      close_sent_=true;
+      close_timer_.expires_from_now(cast_up()->close_timeout());
+      close_timer_.async_wait(get_strand().wrap(
+        boost::bind(&up_t::on_close_timeout,sp_cast_up(),
+        ba::placeholders::error)));
+    }
+
+    cast_up()->mask_frame(*df);
+
+    outbound_frame frame={df,encoded_frame_ptr(),on_write};
+    push_frame(frame);
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::async_broadcast(
+    encoded_frame_ptr frame)
+  {
+    get_strand().dispatch(boost::bind(&up_t::enqueue_shared,sp_cast_up(),
+      frame));
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::on_publish(
+    const publication& pub)
+  {
+    async_broadcast(pub.encoded<ws_text_frame>());
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::enqueue_shared(
+    encoded_frame_ptr frame)
+  {
+    if(close_sent_||!get_socket().is_open()||!cast_up()->ready_to_write())
+      return; // session is closing, or not yet open
+
+    outbound_frame shared={data_frame_ptr(),frame,write_handler_t()};
+    push_frame(shared);
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::push_frame(
+    const outbound_frame& frame)
+  {
+    write_queue_.push_back(frame);
+    if(write_queue_.size()==1)
+      write_next();
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::write_next()
+  {
+    namespace ba=boost::asio;
+
+    const outbound_frame& front=write_queue_.front();
+    if(front.shared_)
+      ba::async_write(get_socket(),front.shared_->to_buffer(),
+        get_strand().wrap(bind(&up_t::on_write_queue,sp_cast_up(),
+        ba::placeholders::error)));
+    else if(front.frame_->payload_.size()<cast_up()->small_frame_size())
+    { // one buffer, the capacity is kept from a frame to the other
+      write_buffer_.resize(data_frame::max_header_size
+        +front.frame_->payload_.size());
+      const std::size_t size=front.frame_->copy_to(&write_buffer_[0]);
+      ba::async_write(get_socket(),ba::buffer(&write_buffer_[0],size),
+        get_strand().wrap(bind(&up_t::on_write_queue,sp_cast_up(),
+        ba::placeholders::error)));
+    }
+    else
+      ba::async_write(get_socket(),front.frame_->to_buffers(),
+        get_strand().wrap(bind(&up_t::on_write_queue,sp_cast_up(),
+        ba::placeholders::error)));
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::on_write_queue(
+    const error_code& error)
+  {
+    outbound_frame done(write_queue_.front());
+    write_queue_.pop_front();
+
+    if(error)
+    { // the frames behind are dropped, their writers told so
+      for(std::size_t i=0; i<write_queue_.size(); i++)
+        abort_write(write_queue_[i].on_write_);
+      write_queue_.clear();
+      if(close_sent_||close_received_)
+      { // socket closed while draining, nothing to report
+        close_socket();
+        abort_write(done.on_write_);
+      }
+      else if(done.on_write_)
+        done.on_write_(error);
+      else
+        close_socket(); // broadcast frames are written quietly
+      return;
+    }
+
+    if(done.frame_&&done.frame_->opcode_==data_frame::connection_close)
+    { // last frame, wait for the client close frame unless already there
+      close_written_=true;
+      if(close_received_||failing_)
+        close_socket();
+    }
+    else if(!write_queue_.empty())
+      write_next();
+
+    // last, the handler may queue another frame
+    if(done.on_write_)
+      done.on_write_(error);
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::abort_write(
+    const write_handler_t& on_write)
+  {
+    if(on_write)
+      get_strand().post(boost::bind(on_write,
+        error_code(boost::asio::error::operation_aborted)));
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::async_close(
+    boost::uint16_t code,const std::string& reason)
+  {
+    log_trace(EZ_FLFT,"code="+boost::lexical_cast<std::string>(code)
+      +" reason="+reason);
+
+    async_write_frame(boost::make_shared<data_frame>(
+      data_frame::close_frame(code,reason)),&up_t::on_write_dataframe);
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::on_close(
+    boost::uint16_t code,const std::string& reason)
+  {
+    log_info(EZ_FLFT,"code="+boost::lexical_cast<std::string>(code)
+      +" reason="+reason);
+  }
+
+  template <typename up_t,typename log_t>
+  boost::posix_time::time_duration ws_session<typename up_t,typename log_t>::close_timeout()
+  {
+    return boost::posix_time::seconds(5);
+  }
+
+  template <typename up_t,typename log_t>
+  bool ws_session<typename up_t,typename log_t>::validate_utf8()
+  {
+    return true;
+  }
+
+  template <typename up_t,typename log_t>
+  std::size_t ws_session<typename up_t,typename log_t>::max_message_size()
+  {
+    return 16*1024*1024;
+  }
+
+  template <typename up_t,typename log_t>
+  std::size_t ws_session<typename up_t,typename log_t>::small_frame_size()
+  {
+    return 1024;
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::fail(
+    boost::uint16_t code,const std::string& msg)
+  {
+    log_error(EZ_FLFT,msg);
+
+    if(close_sent_)
+    { // closing handshake already started
+      close_socket();
+      return;
+    }
+    failing_=true;
+    async_close(code);
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::on_close_timeout(
+    const error_code& error)
+  {
+    if(error||!close_sent_||!get_socket().is_open())
+      return; // canceled, the closing handshake is over
+
+    log_warning(EZ_FLFT,"closing handshake timeout");
+    close_socket();
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::close_socket()
+  {
+    error_code ec;
+    close_timer_.cancel(ec);
+    shutdown();
+  }
 
-    data_frame_ptr df(mk_data_frame(msg));
-    ba::async_write(get_socket(),df->to_buffers(),
-      get_strand().wrap(bind(on_write_func,sp_cast_up(),
-      df,
-      ba::placeholders::error)));
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::notify_close(
+    boost::uint16_t code,const std::string& reason)
+  {
+    if(close_notified_)
+      return;
+    close_notified_=true;
+    cast_up()->on_close(code,reason);
   }
 
   template <typename up_t,typename log_t>
@@ -84,49 +460,225 @@ namespace splice
   }
 
   template <typename up_t,typename log_t>
-  void ws_session<typename up_t,typename log_t>::on_read_data_frame(
-    incoming_data_ptr& incoming_data,
-    data_frame& read_frame)
+  void ws_session<typename up_t,typename log_t>::on_read_binary(
+    std::vector<boost::uint8_t>& payload)
+  {
+    cast_up()->fail(data_frame::unsupported_data,
+      "binary frame not handled, size="
+      +boost::lexical_cast<std::string>(payload.size()));
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::async_read_dataframe(
+    incoming_data_ptr incoming_data,
+    frame_parser_ptr frame_parser)
   {
     namespace ba=boost::asio;
+
+    get_socket().async_read_some(ba::buffer(*incoming_data),
+      get_strand().wrap(
+      bind(&up_t::on_read_dataframe,sp_cast_up(),
+      incoming_data,
+      frame_parser,
+      ba::placeholders::error,
+      ba::placeholders::bytes_transferred)));
+  }
+
+  template <typename up_t,typename log_t>
+  bool ws_session<typename up_t,typename log_t>::on_read_data_frame(
+    data_frame& read_frame)
+  {
     using std::string;
     using boost::lexical_cast;
 
     log_trace(EZ_FLFT,
       string("operation code=")+lexical_cast<string>(read_frame.opcode_));
 
+    // RSV1 is only valid on the first frame of a compressed message
+    if(read_frame.rsv1_&&(!deflate_
+      ||(read_frame.opcode_!=data_frame::text_frame
+      &&read_frame.opcode_!=data_frame::binary_frame)))
+    {
+      cast_up()->fail(data_frame::protocol_error,"unexpected RSV1 bit");
+      return false;
+    }
+
+    // after our close frame, only the client close frame matters
+    if(close_sent_&&read_frame.opcode_!=data_frame::connection_close)
+      return true;
+
     switch(read_frame.opcode_)
     {
     case data_frame::text_frame:
-      cast_up()->on_read(
-        std::string(read_frame.payload_.begin(),read_frame.payload_.end()));
-
-      get_socket().async_read_some(ba::buffer(*incoming_data),
-        get_strand().wrap(
-        bind(&up_t::on_read_dataframe,sp_cast_up(),
-        incoming_data,
-        mk_frame_parser(),
-        ba::placeholders::error,
-        ba::placeholders::bytes_transferred)));
-      break;
+    case data_frame::binary_frame:
+      if(fragments_opcode_!=data_frame::continuation_frame)
+      {
+        cast_up()->fail(data_frame::protocol_error,
+          "data frame inside a fragmented message");
+        return false;
+      }
+      if(!read_frame.fin_)
+      { // first fragment, wait for continuation frames
+        fragments_opcode_=read_frame.opcode_;
+        fragments_compressed_=read_frame.rsv1_;
+        fragments_.swap(read_frame.payload_);
+        return true;
+      }
+      return on_read_message(read_frame.opcode_,read_frame.payload_,
+        read_frame.rsv1_);
+    case data_frame::continuation_frame:
+    {
+      if(fragments_opcode_==data_frame::continuation_frame)
+      {
+        cast_up()->fail(data_frame::protocol_error,
+          "continuation frame without first fragment");
+        return false;
+      }
+      if(read_frame.payload_.size()>cast_up()->max_message_size()-fragments_.size())
+      {
+        cast_up()->fail(data_frame::message_too_big,"fragmented message too big");
+        return false;
+      }
+      fragments_.insert(fragments_.end(),
+        read_frame.payload_.begin(),read_frame.payload_.end());
+      if(!read_frame.fin_)
+        return true;
+
+      const data_frame::operation_code opcode=fragments_opcode_;
+      fragments_opcode_=data_frame::continuation_frame;
+      std::vector<boost::uint8_t> payload;
+      payload.swap(fragments_);
+      return on_read_message(opcode,payload,fragments_compressed_);
+    }
     case data_frame::pong:
     case data_frame::ping:
-      get_socket().async_read_some(ba::buffer(*incoming_data),
-        get_strand().wrap(
-        bind(&up_t::on_read_dataframe,sp_cast_up(),
-        incoming_data,
-        mk_frame_parser(),
-        ba::placeholders::error,
-        ba::placeholders::bytes_transferred)));
-      break;
-    case data_frame::continuation_frame:
-    case data_frame::binary_frame:
+      // control frames can't be fragmented, RFC 6455 5.5
+      if(!read_frame.fin_||read_frame.payload_.size()>125)
+      {
+        cast_up()->fail(data_frame::protocol_error,"invalid control frame");
+        return false;
+      }
+      if(read_frame.opcode_==data_frame::ping)
+        cast_up()->on_ping(read_frame.payload_);
+      else
+        cast_up()->on_pong(read_frame.payload_);
+      return true;
     case data_frame::connection_close:
+    {
+      boost::uint16_t code;
+      string reason;
+      if(!read_frame.fin_||read_frame.payload_.size()>125
+        ||!read_frame.close_status(code,reason))
+      {
+        cast_up()->fail(data_frame::protocol_error,"invalid close frame");
+        return false;
+      }
+      if(!utf8_validator::validate(
+        reinterpret_cast<const boost::uint8_t*>(reason.data()),reason.size()))
+      {
+        cast_up()->fail(data_frame::invalid_payload,"invalid close reason");
+        return false;
+      }
+      close_received_=true;
+
+      if(close_sent_)
+      { // answer to our own close frame
+        if(close_written_)
+          close_socket();
+        return false;
+      }
+
+      // echo the status code, the socket is closed once written
+      notify_close(code,reason);
+      cast_up()->async_close(code);
+      return false;
+    }
     case data_frame::reserved:
     default:
-      cast_up()->on_error(EZ_FLF
+      cast_up()->fail(data_frame::protocol_error
         ,"invalid opcode:"+lexical_cast<string>(read_frame.opcode_));
+      return false;
+    }
+  }
+
+  template <typename up_t,typename log_t>
+  bool ws_session<typename up_t,typename log_t>::on_read_message(
+    data_frame::operation_code opcode,
+    std::vector<boost::uint8_t>& payload,
+    bool compressed)
+  {
+    if(compressed&&!deflate_->inflate(payload,cast_up()->max_message_size()))
+    {
+      if(deflate_->too_big())
+        cast_up()->fail(data_frame::message_too_big,"inflated message too big");
+      else
+        cast_up()->fail(data_frame::invalid_payload,"invalid compressed message");
+      return false;
     }
+
+    // uncompressed text is validated by the frame parser
+    if(compressed&&opcode==data_frame::text_frame&&cast_up()->validate_utf8()
+      &&!utf8_validator::validate(payload.empty()?0:&payload[0],payload.size()))
+    {
+      cast_up()->fail(data_frame::invalid_payload,"invalid UTF-8 text");
+      return false;
+    }
+
+    if(opcode==data_frame::text_frame)
+    {
+      std::string msg(payload.begin(),payload.end());
+      cast_up()->on_read(msg);
+    }
+    else
+      cast_up()->on_read_binary(payload);
+
+    // handler may have closed the session
+    return get_socket().is_open();
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::deflate_frame(data_frame& df)
+  {
+    if(deflate_&&deflate_->deflate(df.payload_))
+      df.rsv1_=true;
+  }
+
+  template <typename up_t,typename log_t>
+  bool ws_session<typename up_t,typename log_t>::ready_to_write()
+  {
+    return true;
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::mask_frame(data_frame& df)
+  {
+  }
+
+  template <typename up_t,typename log_t>
+  bool ws_session<typename up_t,typename log_t>::write_pending() const
+  {
+    return !write_queue_.empty();
+  }
+
+  template <typename up_t,typename log_t>
+  void ws_session<typename up_t,typename log_t>::reset_connection()
+  {
+    BOOST_ASSERT(write_queue_.empty());
+
+    error_code ec;
+    close_timer_.cancel(ec);
+    close_sent_=false;
+    close_written_=false;
+    close_received_=false;
+    failing_=false;
+    close_notified_=false;
+    read_frame_=data_frame();
+    fragments_.clear();
+    fragments_opcode_=data_frame::continuation_frame;
+    fragments_compressed_=false;
+    missed_pongs_=0;
+    srtt_.store(-1,boost::memory_order_relaxed);
+    deflate_.reset();
   }
 
   template <typename up_t,typename log_t>
@@ -136,46 +688,58 @@ namespace splice
     const error_code& error,
     std::size_t bytes_transferred)
   {
-    namespace ba=boost::asio;
     using std::string;
     using boost::lexical_cast;
 
-    log_trace(EZ_FLFT,"");
+    log_trace(EZ_FLFT,
+      lexical_cast<string>(bytes_transferred)+string(" bytes transferred"));
 
     if(error)
     {
+      if(close_sent_||close_received_||error==boost::asio::error::operation_aborted)
+        return; // socket closed by the closing handshake
+      if(error==boost::asio::error::eof)
+      { // client gone without close frame
+        notify_close(data_frame::abnormal_closure,"");
+        close_socket();
+        return;
+      }
       cast_up()->on_error_code(EZ_FLF,error);
       return;
     }
 
-    boost::tribool result;
-    data_frame read_frame;
-    boost::tie(result,boost::tuples::ignore)=frame_parser->parse(
-      read_frame,incoming_data->data(),incoming_data->data()+bytes_transferred);
+    // A read may hold the end of a frame and several other ones,
+    // the frame being parsed is kept in read_frame_ between reads.
+    const char* begin=incoming_data->data();
+    const char* const end=begin+bytes_transferred;
+    while(begin!=end)
+    {
+      boost::tribool result;
+      boost::tie(result,begin)=frame_parser->parse(read_frame_,begin,end);
 
-    log_trace(EZ_FLFT,
-      string("result=")+lexical_cast<string>(result.value)
-      +string(" ")+lexical_cast<string>(bytes_transferred)
-      +string(" bytes transferred"));
+      if(!result) // data is invalid
+      {
+        if(frame_parser->utf8_error())
+          cast_up()->fail(data_frame::invalid_payload,"invalid UTF-8 text");
+        else if(frame_parser->too_big())
+          cast_up()->fail(data_frame::message_too_big,"data frame too big");
+        else
+          cast_up()->fail(data_frame::protocol_error,"invalid data frame");
+        return;
+      }
 
-    switch(result.value)
-    {
-    case false: // data is invalid
-      cast_up()->on_error(EZ_FLF);
-      break;
-    case boost::tribool::indeterminate_value: // is 2
-      // more data is required
-      get_socket().async_read_some(ba::buffer(*incoming_data),
-        get_strand().wrap(
-        bind(&up_t::on_read_dataframe,sp_cast_up(),
-        incoming_data,
-        frame_parser,
-        ba::placeholders::error,
-        ba::placeholders::bytes_transferred)));
-      break;
-    case true: // a complete data_frame has been parsed
-      cast_up()->on_read_data_frame(incoming_data,read_frame);
+      if(result) // a complete data_frame has been parsed
+      {
+        frame_parser->reset();
+        const bool keep_reading=cast_up()->on_read_data_frame(read_frame_);
+        read_frame_=data_frame();
+        if(!keep_reading)
+          return;
+      }
+      // else more data is required, all bytes have been consumed
     }
+
+    cast_up()->async_read_dataframe(incoming_data,frame_parser);
   }
 
   template <typename up_t,typename log_t>
@@ -185,7 +749,8 @@ namespace splice
   {
     log_trace(EZ_FLFT,"");
 
-    if(error)
+    // aborted frames were dropped by a closing session
+    if(error&&error!=boost::asio::error::operation_aborted)
       cast_up()->on_error(EZ_FLF);
   }
 